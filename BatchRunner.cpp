@@ -0,0 +1,74 @@
+#include "BatchRunner.h"
+#include "FileManager.h"
+#include "MappedFile.h"
+#include <iostream>
+#include <cstring>
+
+namespace {
+    // Failures listed by name in the summary; the rest are only counted.
+    const size_t MAX_LISTED = 20;
+}
+
+BatchRunner::BatchRunner(FileManager& manager, ErrorPolicy policy) : manager(manager), policy(policy) {}
+
+int BatchRunner::runScript(const std::string& path) {
+    if (path == "-") return runStream(std::cin);
+
+    MappedFile script;
+    if (!script.open(path)) {
+        std::cerr << "Error: Could not read script '" << path << "'.\n";
+        return 2;
+    }
+    const char* p = script.data();
+    const char* end = p + script.size();
+    while (p < end) {
+        const char* newline = (const char*)std::memchr(p, '\n', (size_t)(end - p));
+        const char* lineEnd = newline != nullptr ? newline : end;
+        if (!runLine(std::string_view(p, (size_t)(lineEnd - p)))) break;
+        p = newline != nullptr ? newline + 1 : end;
+    }
+    return finish();
+}
+
+int BatchRunner::runStream(std::istream& in) {
+    // One line buffer for the whole batch; it only grows.
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!runLine(line)) break;
+    }
+    return finish();
+}
+
+bool BatchRunner::runLine(std::string_view line) {
+    ++lineNumber;
+    size_t start = line.find_first_not_of(" \t\r\v\f");
+    if (start == std::string_view::npos || line[start] == '#') return true;
+
+    ++commandCount;
+    if (!manager.handleCommand(line)) {
+        ++failureCount;
+        if (failures.size() < MAX_LISTED) {
+            size_t last = line.find_last_not_of(" \t\r\v\f");
+            failures.push_back({ lineNumber, std::string(line.substr(start, last + 1 - start)) });
+        }
+        if (policy == ErrorPolicy::Stop) {
+            stopped = true;
+            return false;
+        }
+    }
+    return !manager.exitRequested();
+}
+
+int BatchRunner::finish() {
+    std::cerr << "Batch finished: " << commandCount << (commandCount == 1 ? " command, " : " commands, ")
+              << commandCount - failureCount << " succeeded, " << failureCount << " failed";
+    if (stopped) std::cerr << " (stopped at line " << lineNumber << ", --stop-on-error)";
+    std::cerr << ".\n";
+    for (const Failure& failure : failures) {
+        std::cerr << "  FAILED  line " << failure.line << ": " << failure.command << "\n";
+    }
+    if (failureCount > failures.size()) {
+        std::cerr << "  ... and " << failureCount - failures.size() << " more\n";
+    }
+    return failureCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <istream>
+#include <cstddef>
+
+class FileManager;
+
+// Runs commands from a script file or from stdin without prompting, one per line, and
+// reports at the end which of them failed. Blank lines and lines starting with '#'
+// are skipped; "exit" ends the batch early. A script file is mapped and its lines
+// are handed to FileManager as views, so a batch costs little beyond the commands.
+class BatchRunner {
+public:
+    enum class ErrorPolicy {
+        Continue,   // run every command, report the failures at the end (the default)
+        Stop,       // stop at the first command that fails
+    };
+
+    BatchRunner(FileManager& manager, ErrorPolicy policy);
+
+    // Both return the process exit status: 0 if every command succeeded, 1 if any
+    // failed, 2 if the script could not be read. `path` "-" reads stdin.
+    int runScript(const std::string& path);
+    int runStream(std::istream& in);
+
+private:
+    // Runs one script line; returns false once the batch has to stop.
+    bool runLine(std::string_view line);
+
+    // Prints the summary on std::cerr and works out the exit status.
+    int finish();
+
+    struct Failure {
+        size_t line;
+        std::string command;
+    };
+
+    FileManager& manager;
+    ErrorPolicy policy;
+    size_t lineNumber = 0;
+    size_t commandCount = 0;
+    size_t failureCount = 0;
+    std::vector<Failure> failures; // the first MAX_LISTED of them
+    bool stopped = false;
+};
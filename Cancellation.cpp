@@ -0,0 +1,21 @@
+#include "Cancellation.h"
+
+namespace {
+    thread_local const std::atomic<bool>* current = nullptr;
+}
+
+Cancellation::Scope::Scope(const std::atomic<bool>* flag) : saved(current) {
+    current = flag;
+}
+
+Cancellation::Scope::~Scope() {
+    current = saved;
+}
+
+bool Cancellation::requested() {
+    return current != nullptr && current->load(std::memory_order_relaxed);
+}
+
+const std::atomic<bool>* Cancellation::flag() {
+    return current;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <atomic>
+
+// Cooperative cancellation for background jobs. ProcessManager runs each job with the
+// job's flag installed on its worker thread; the long loops of the engines check
+// requested() once per batch and stop with EngineStatus::Cancelled when it is set.
+// Work outside a job is never cancelled.
+class Cancellation {
+public:
+    // Installs `flag` for the calling thread until the scope ends.
+    class Scope {
+    public:
+        explicit Scope(const std::atomic<bool>* flag);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const std::atomic<bool>* saved;
+    };
+
+    // True if the job running on this thread has been asked to stop.
+    static bool requested();
+
+    // The flag installed for this thread (nullptr outside a job), for passing on to
+    // threads that work for the job.
+    static const std::atomic<bool>* flag();
+};
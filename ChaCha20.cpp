@@ -0,0 +1,431 @@
+#include "ChaCha20.h"
+#include "CpuFeatures.h"
+#include <cstring>
+#include <algorithm>
+
+#if defined(FMS_X86)
+#include <immintrin.h>
+#endif
+
+// Every version computes the same 16-word state per block: the constant, the key, the
+// block counter and the nonce, run through 20 rounds and added back to the input. The
+// vector versions keep one state word of 4, 8 or 16 consecutive blocks per register,
+// so each vector operation advances that many blocks, then transpose the words back
+// into byte order before XORing them into the data.
+namespace {
+    typedef void (*XorBlocksFn)(const uint32_t state[16], uint32_t counter, unsigned char* data, size_t blocks);
+
+    struct Kernels {
+        XorBlocksFn xorBlocks;
+        const char* name;
+    };
+
+    inline uint32_t load32(const unsigned char* p) {
+        return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    inline void store32(unsigned char* p, uint32_t value) {
+        p[0] = (unsigned char)value;
+        p[1] = (unsigned char)(value >> 8);
+        p[2] = (unsigned char)(value >> 16);
+        p[3] = (unsigned char)(value >> 24);
+    }
+
+    void initState(uint32_t state[16], const unsigned char* key, const unsigned char* nonce) {
+        state[0] = 0x61707865; // "expand 32-byte k"
+        state[1] = 0x3320646e;
+        state[2] = 0x79622d32;
+        state[3] = 0x6b206574;
+        for (int i = 0; i < 8; ++i) state[4 + i] = load32(key + 4 * i);
+        state[12] = 0;
+        for (int i = 0; i < 3; ++i) state[13 + i] = load32(nonce + 4 * i);
+    }
+
+    // --- Scalar reference ---
+    inline uint32_t rotl(uint32_t value, int count) {
+        return (value << count) | (value >> (32 - count));
+    }
+
+    inline void quarterRound(uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d) {
+        a += b; d = rotl(d ^ a, 16);
+        c += d; b = rotl(b ^ c, 12);
+        a += b; d = rotl(d ^ a, 8);
+        c += d; b = rotl(b ^ c, 7);
+    }
+
+    // Serialized keystream block `counter` of the state.
+    void keystreamBlock(const uint32_t state[16], uint32_t counter, unsigned char out[ChaCha20::BLOCK_SIZE]) {
+        uint32_t input[16];
+        std::memcpy(input, state, sizeof(input));
+        input[12] = counter;
+        uint32_t x[16];
+        std::memcpy(x, input, sizeof(x));
+        for (int round = 0; round < 10; ++round) {
+            quarterRound(x[0], x[4], x[8], x[12]);
+            quarterRound(x[1], x[5], x[9], x[13]);
+            quarterRound(x[2], x[6], x[10], x[14]);
+            quarterRound(x[3], x[7], x[11], x[15]);
+            quarterRound(x[0], x[5], x[10], x[15]);
+            quarterRound(x[1], x[6], x[11], x[12]);
+            quarterRound(x[2], x[7], x[8], x[13]);
+            quarterRound(x[3], x[4], x[9], x[14]);
+        }
+        for (int i = 0; i < 16; ++i) store32(out + 4 * i, x[i] + input[i]);
+    }
+
+    void xorBlocksScalar(const uint32_t state[16], uint32_t counter, unsigned char* data, size_t blocks) {
+        unsigned char keystream[ChaCha20::BLOCK_SIZE];
+        for (size_t b = 0; b < blocks; ++b, data += ChaCha20::BLOCK_SIZE) {
+            keystreamBlock(state, counter + (uint32_t)b, keystream);
+            for (size_t i = 0; i < ChaCha20::BLOCK_SIZE; i += 8) {
+                uint64_t word, pad;
+                std::memcpy(&word, data + i, 8);
+                std::memcpy(&pad, keystream + i, 8);
+                word ^= pad;
+                std::memcpy(data + i, &word, 8);
+            }
+        }
+    }
+
+#if defined(FMS_X86)
+    // --- SSE2: 4 blocks per step ---
+    template <int Count>
+    FMS_TARGET_SSE2 inline __m128i rotl128(__m128i v) {
+        return _mm_or_si128(_mm_slli_epi32(v, Count), _mm_srli_epi32(v, 32 - Count));
+    }
+
+    template <>
+    FMS_TARGET_SSE2 inline __m128i rotl128<16>(__m128i v) {
+        return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);
+    }
+
+    FMS_TARGET_SSE2 inline void quarterRound128(__m128i& a, __m128i& b, __m128i& c, __m128i& d) {
+        a = _mm_add_epi32(a, b); d = rotl128<16>(_mm_xor_si128(d, a));
+        c = _mm_add_epi32(c, d); b = rotl128<12>(_mm_xor_si128(b, c));
+        a = _mm_add_epi32(a, b); d = rotl128<8>(_mm_xor_si128(d, a));
+        c = _mm_add_epi32(c, d); b = rotl128<7>(_mm_xor_si128(b, c));
+    }
+
+    // Turns words w..w+3 of four blocks (one block per lane) into four vectors each
+    // holding one block's words w..w+3.
+    FMS_TARGET_SSE2 inline void transpose128(__m128i& a, __m128i& b, __m128i& c, __m128i& d) {
+        __m128i ab0 = _mm_unpacklo_epi32(a, b);
+        __m128i cd0 = _mm_unpacklo_epi32(c, d);
+        __m128i ab1 = _mm_unpackhi_epi32(a, b);
+        __m128i cd1 = _mm_unpackhi_epi32(c, d);
+        a = _mm_unpacklo_epi64(ab0, cd0);
+        b = _mm_unpackhi_epi64(ab0, cd0);
+        c = _mm_unpacklo_epi64(ab1, cd1);
+        d = _mm_unpackhi_epi64(ab1, cd1);
+    }
+
+    FMS_TARGET_SSE2 inline void xorStore128(unsigned char* p, __m128i v) {
+        _mm_storeu_si128((__m128i*)p, _mm_xor_si128(_mm_loadu_si128((const __m128i*)p), v));
+    }
+
+    FMS_TARGET_SSE2 void xorBlocksSse2(const uint32_t state[16], uint32_t counter, unsigned char* data, size_t blocks) {
+        size_t b = 0;
+        for (; b + 4 <= blocks; b += 4, data += 4 * ChaCha20::BLOCK_SIZE) {
+            // Only the counters differ between blocks; the other input words are
+            // broadcast again for the final addition rather than kept in registers.
+            const __m128i counters = _mm_add_epi32(_mm_set1_epi32((int)(counter + (uint32_t)b)), _mm_setr_epi32(0, 1, 2, 3));
+            __m128i x[16];
+            for (int i = 0; i < 16; ++i) x[i] = _mm_set1_epi32((int)state[i]);
+            x[12] = counters;
+            for (int round = 0; round < 10; ++round) {
+                quarterRound128(x[0], x[4], x[8], x[12]);
+                quarterRound128(x[1], x[5], x[9], x[13]);
+                quarterRound128(x[2], x[6], x[10], x[14]);
+                quarterRound128(x[3], x[7], x[11], x[15]);
+                quarterRound128(x[0], x[5], x[10], x[15]);
+                quarterRound128(x[1], x[6], x[11], x[12]);
+                quarterRound128(x[2], x[7], x[8], x[13]);
+                quarterRound128(x[3], x[4], x[9], x[14]);
+            }
+            for (int i = 0; i < 16; ++i) x[i] = _mm_add_epi32(x[i], i == 12 ? counters : _mm_set1_epi32((int)state[i]));
+
+            for (int w = 0; w < 16; w += 4) {
+                transpose128(x[w], x[w + 1], x[w + 2], x[w + 3]);
+                for (int j = 0; j < 4; ++j) xorStore128(data + j * ChaCha20::BLOCK_SIZE + w * 4, x[w + j]);
+            }
+        }
+        xorBlocksScalar(state, counter + (uint32_t)b, data, blocks - b);
+    }
+
+    // --- AVX2: 8 blocks per step ---
+    template <int Count>
+    FMS_TARGET_AVX2 inline __m256i rotl256(__m256i v) {
+        return _mm256_or_si256(_mm256_slli_epi32(v, Count), _mm256_srli_epi32(v, 32 - Count));
+    }
+
+    // Rotations by whole bytes are one byte shuffle.
+    template <>
+    FMS_TARGET_AVX2 inline __m256i rotl256<16>(__m256i v) {
+        const __m256i rotate16 = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                                  2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+        return _mm256_shuffle_epi8(v, rotate16);
+    }
+
+    template <>
+    FMS_TARGET_AVX2 inline __m256i rotl256<8>(__m256i v) {
+        const __m256i rotate8 = _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+                                                 3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+        return _mm256_shuffle_epi8(v, rotate8);
+    }
+
+    FMS_TARGET_AVX2 inline void quarterRound256(__m256i& a, __m256i& b, __m256i& c, __m256i& d) {
+        a = _mm256_add_epi32(a, b); d = rotl256<16>(_mm256_xor_si256(d, a));
+        c = _mm256_add_epi32(c, d); b = rotl256<12>(_mm256_xor_si256(b, c));
+        a = _mm256_add_epi32(a, b); d = rotl256<8>(_mm256_xor_si256(d, a));
+        c = _mm256_add_epi32(c, d); b = rotl256<7>(_mm256_xor_si256(b, c));
+    }
+
+    // As transpose128, within each 128-bit lane: lane L of the results belongs to
+    // block j + 4 * L.
+    FMS_TARGET_AVX2 inline void transpose256(__m256i& a, __m256i& b, __m256i& c, __m256i& d) {
+        __m256i ab0 = _mm256_unpacklo_epi32(a, b);
+        __m256i cd0 = _mm256_unpacklo_epi32(c, d);
+        __m256i ab1 = _mm256_unpackhi_epi32(a, b);
+        __m256i cd1 = _mm256_unpackhi_epi32(c, d);
+        a = _mm256_unpacklo_epi64(ab0, cd0);
+        b = _mm256_unpackhi_epi64(ab0, cd0);
+        c = _mm256_unpacklo_epi64(ab1, cd1);
+        d = _mm256_unpackhi_epi64(ab1, cd1);
+    }
+
+    FMS_TARGET_AVX2 inline void xorStore256(unsigned char* p, __m256i v) {
+        _mm256_storeu_si256((__m256i*)p, _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)p), v));
+    }
+
+    FMS_TARGET_AVX2 void xorBlocksAvx2(const uint32_t state[16], uint32_t counter, unsigned char* data, size_t blocks) {
+        size_t b = 0;
+        for (; b + 8 <= blocks; b += 8, data += 8 * ChaCha20::BLOCK_SIZE) {
+            const __m256i counters = _mm256_add_epi32(_mm256_set1_epi32((int)(counter + (uint32_t)b)),
+                                         _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+            __m256i x[16];
+            for (int i = 0; i < 16; ++i) x[i] = _mm256_set1_epi32((int)state[i]);
+            x[12] = counters;
+            for (int round = 0; round < 10; ++round) {
+                quarterRound256(x[0], x[4], x[8], x[12]);
+                quarterRound256(x[1], x[5], x[9], x[13]);
+                quarterRound256(x[2], x[6], x[10], x[14]);
+                quarterRound256(x[3], x[7], x[11], x[15]);
+                quarterRound256(x[0], x[5], x[10], x[15]);
+                quarterRound256(x[1], x[6], x[11], x[12]);
+                quarterRound256(x[2], x[7], x[8], x[13]);
+                quarterRound256(x[3], x[4], x[9], x[14]);
+            }
+            for (int i = 0; i < 16; ++i) x[i] = _mm256_add_epi32(x[i], i == 12 ? counters : _mm256_set1_epi32((int)state[i]));
+            for (int w = 0; w < 16; w += 4) transpose256(x[w], x[w + 1], x[w + 2], x[w + 3]);
+
+            // x[w + j] now holds words w..w+3 of block j (low lane) and block j + 4
+            // (high lane); pairing groups 0/4 and 8/12 gives 32 contiguous bytes.
+            for (int j = 0; j < 4; ++j) {
+                unsigned char* low = data + j * ChaCha20::BLOCK_SIZE;
+                unsigned char* high = low + 4 * ChaCha20::BLOCK_SIZE;
+                xorStore256(low, _mm256_permute2x128_si256(x[j], x[4 + j], 0x20));
+                xorStore256(low + 32, _mm256_permute2x128_si256(x[8 + j], x[12 + j], 0x20));
+                xorStore256(high, _mm256_permute2x128_si256(x[j], x[4 + j], 0x31));
+                xorStore256(high + 32, _mm256_permute2x128_si256(x[8 + j], x[12 + j], 0x31));
+            }
+        }
+        xorBlocksSse2(state, counter + (uint32_t)b, data, blocks - b);
+    }
+
+    // --- AVX-512: 16 blocks per step ---
+#if defined(__GNUC__) && !defined(__clang__)
+    // GCC 12 reports the deliberately undefined pass-through operand inside several
+    // AVX-512 intrinsics as possibly uninitialized.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+    template <int Count>
+    FMS_TARGET_AVX512BW inline __m512i rotl512(__m512i v) {
+        return _mm512_rol_epi32(v, Count);
+    }
+
+    FMS_TARGET_AVX512BW inline void quarterRound512(__m512i& a, __m512i& b, __m512i& c, __m512i& d) {
+        a = _mm512_add_epi32(a, b); d = rotl512<16>(_mm512_xor_si512(d, a));
+        c = _mm512_add_epi32(c, d); b = rotl512<12>(_mm512_xor_si512(b, c));
+        a = _mm512_add_epi32(a, b); d = rotl512<8>(_mm512_xor_si512(d, a));
+        c = _mm512_add_epi32(c, d); b = rotl512<7>(_mm512_xor_si512(b, c));
+    }
+
+    FMS_TARGET_AVX512BW inline void transpose512(__m512i& a, __m512i& b, __m512i& c, __m512i& d) {
+        __m512i ab0 = _mm512_unpacklo_epi32(a, b);
+        __m512i cd0 = _mm512_unpacklo_epi32(c, d);
+        __m512i ab1 = _mm512_unpackhi_epi32(a, b);
+        __m512i cd1 = _mm512_unpackhi_epi32(c, d);
+        a = _mm512_unpacklo_epi64(ab0, cd0);
+        b = _mm512_unpackhi_epi64(ab0, cd0);
+        c = _mm512_unpacklo_epi64(ab1, cd1);
+        d = _mm512_unpackhi_epi64(ab1, cd1);
+    }
+
+    FMS_TARGET_AVX512BW inline void xorStore512(unsigned char* p, __m512i v) {
+        _mm512_storeu_si512((void*)p, _mm512_xor_si512(_mm512_loadu_si512((const void*)p), v));
+    }
+
+    FMS_TARGET_AVX512BW void xorBlocksAvx512(const uint32_t state[16], uint32_t counter, unsigned char* data, size_t blocks) {
+        size_t b = 0;
+        for (; b + 16 <= blocks; b += 16, data += 16 * ChaCha20::BLOCK_SIZE) {
+            const __m512i counters = _mm512_add_epi32(_mm512_set1_epi32((int)(counter + (uint32_t)b)),
+                                         _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+            __m512i x[16];
+            for (int i = 0; i < 16; ++i) x[i] = _mm512_set1_epi32((int)state[i]);
+            x[12] = counters;
+            for (int round = 0; round < 10; ++round) {
+                quarterRound512(x[0], x[4], x[8], x[12]);
+                quarterRound512(x[1], x[5], x[9], x[13]);
+                quarterRound512(x[2], x[6], x[10], x[14]);
+                quarterRound512(x[3], x[7], x[11], x[15]);
+                quarterRound512(x[0], x[5], x[10], x[15]);
+                quarterRound512(x[1], x[6], x[11], x[12]);
+                quarterRound512(x[2], x[7], x[8], x[13]);
+                quarterRound512(x[3], x[4], x[9], x[14]);
+            }
+            for (int i = 0; i < 16; ++i) x[i] = _mm512_add_epi32(x[i], i == 12 ? counters : _mm512_set1_epi32((int)state[i]));
+            for (int w = 0; w < 16; w += 4) transpose512(x[w], x[w + 1], x[w + 2], x[w + 3]);
+
+            // x[w + j] lane L holds words w..w+3 of block j + 4 * L. Two rounds of lane
+            // shuffles gather lane L of groups 0, 4, 8 and 12 into one whole block.
+            for (int j = 0; j < 4; ++j) {
+                __m512i g01lo = _mm512_shuffle_i32x4(x[j], x[4 + j], 0x44);      // x0.0 x0.1 x4.0 x4.1
+                __m512i g23lo = _mm512_shuffle_i32x4(x[8 + j], x[12 + j], 0x44); // x8.0 x8.1 x12.0 x12.1
+                __m512i g01hi = _mm512_shuffle_i32x4(x[j], x[4 + j], 0xEE);      // lanes 2 and 3
+                __m512i g23hi = _mm512_shuffle_i32x4(x[8 + j], x[12 + j], 0xEE);
+                unsigned char* block = data + j * ChaCha20::BLOCK_SIZE;
+                xorStore512(block, _mm512_shuffle_i32x4(g01lo, g23lo, 0x88));
+                xorStore512(block + 4 * ChaCha20::BLOCK_SIZE, _mm512_shuffle_i32x4(g01lo, g23lo, 0xDD));
+                xorStore512(block + 8 * ChaCha20::BLOCK_SIZE, _mm512_shuffle_i32x4(g01hi, g23hi, 0x88));
+                xorStore512(block + 12 * ChaCha20::BLOCK_SIZE, _mm512_shuffle_i32x4(g01hi, g23hi, 0xDD));
+            }
+        }
+        xorBlocksAvx2(state, counter + (uint32_t)b, data, blocks - b);
+    }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+    Kernels select() {
+#if defined(FMS_X86)
+        const CpuFeatures& cpu = CpuFeatures::get();
+        if (cpu.avx512bw) return { xorBlocksAvx512, "avx512bw" };
+        if (cpu.avx2) return { xorBlocksAvx2, "avx2" };
+        if (cpu.sse2) return { xorBlocksSse2, "sse2" };
+#endif
+        return { xorBlocksScalar, "scalar" };
+    }
+
+    const Kernels& kernels() {
+        static const Kernels chosen = select();
+        return chosen;
+    }
+
+    void applyWith(XorBlocksFn xorBlocks, char* data, size_t n, const unsigned char* key, const unsigned char* nonce,
+                   uint64_t position) {
+        uint32_t state[16];
+        initState(state, key, nonce);
+        uint32_t counter = (uint32_t)(position / ChaCha20::BLOCK_SIZE);
+        size_t skip = (size_t)(position % ChaCha20::BLOCK_SIZE);
+        unsigned char* p = (unsigned char*)data;
+        unsigned char keystream[ChaCha20::BLOCK_SIZE];
+
+        // A start inside a block and a partial last block go through one keystream
+        // block each; everything between is whole blocks.
+        if (skip > 0 && n > 0) {
+            keystreamBlock(state, counter++, keystream);
+            size_t take = std::min(n, ChaCha20::BLOCK_SIZE - skip);
+            for (size_t i = 0; i < take; ++i) p[i] ^= keystream[skip + i];
+            p += take;
+            n -= take;
+        }
+        size_t blocks = n / ChaCha20::BLOCK_SIZE;
+        xorBlocks(state, counter, p, blocks);
+        counter += (uint32_t)blocks;
+        p += blocks * ChaCha20::BLOCK_SIZE;
+        n -= blocks * ChaCha20::BLOCK_SIZE;
+        if (n > 0) {
+            keystreamBlock(state, counter, keystream);
+            for (size_t i = 0; i < n; ++i) p[i] ^= keystream[i];
+        }
+    }
+
+    // RFC 8439 section 2.4.2: key 00..1f, nonce 00 00 00 00 00 00 00 4a 00 00 00 00,
+    // block counter 1.
+    const char SUNSCREEN[] = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip "
+                             "for the future, sunscreen would be it.";
+    const unsigned char SUNSCREEN_CIPHERTEXT[114] = {
+        0x6e, 0x2e, 0x35, 0x9a, 0x25, 0x68, 0xf9, 0x80, 0x41, 0xba, 0x07, 0x28, 0xdd, 0x0d, 0x69, 0x81,
+        0xe9, 0x7e, 0x7a, 0xec, 0x1d, 0x43, 0x60, 0xc2, 0x0a, 0x27, 0xaf, 0xcc, 0xfd, 0x9f, 0xae, 0x0b,
+        0xf9, 0x1b, 0x65, 0xc5, 0x52, 0x47, 0x33, 0xab, 0x8f, 0x59, 0x3d, 0xab, 0xcd, 0x62, 0xb3, 0x57,
+        0x16, 0x39, 0xd6, 0x24, 0xe6, 0x51, 0x52, 0xab, 0x8f, 0x53, 0x0c, 0x35, 0x9f, 0x08, 0x61, 0xd8,
+        0x07, 0xca, 0x0d, 0xbf, 0x50, 0x0d, 0x6a, 0x61, 0x56, 0xa3, 0x8e, 0x08, 0x8a, 0x22, 0xb6, 0x5e,
+        0x52, 0xbc, 0x51, 0x4d, 0x16, 0xcc, 0xf8, 0x06, 0x81, 0x8c, 0xe9, 0x1a, 0xb7, 0x79, 0x37, 0x36,
+        0x5a, 0xf9, 0x0b, 0xbf, 0x74, 0xa3, 0x5b, 0xe6, 0xb4, 0x0b, 0x8e, 0xed, 0xf2, 0x78, 0x5e, 0x42,
+        0x87, 0x4d
+    };
+
+    // RFC 8439 section 2.3.2: the serialized block for the same key, nonce
+    // 00 00 00 09 00 00 00 4a 00 00 00 00 and block counter 1.
+    const unsigned char BLOCK_KEYSTREAM[64] = {
+        0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15, 0x50, 0x0f, 0xdd, 0x1f, 0xa3, 0x20, 0x71, 0xc4,
+        0xc7, 0xd1, 0xf4, 0xc7, 0x33, 0xc0, 0x68, 0x03, 0x04, 0x22, 0xaa, 0x9a, 0xc3, 0xd4, 0x6c, 0x4e,
+        0xd2, 0x82, 0x64, 0x46, 0x07, 0x9f, 0xaa, 0x09, 0x14, 0xc2, 0xd7, 0x05, 0xd9, 0x8b, 0x02, 0xa2,
+        0xb5, 0x12, 0x9c, 0xd1, 0xde, 0x16, 0x4e, 0xb9, 0xcb, 0xd0, 0x83, 0xe8, 0xa2, 0x50, 0x3c, 0x4e
+    };
+
+    bool passesKnownAnswers(XorBlocksFn xorBlocks) {
+        unsigned char key[ChaCha20::KEY_SIZE];
+        for (size_t i = 0; i < sizeof(key); ++i) key[i] = (unsigned char)i;
+        const unsigned char blockNonce[ChaCha20::NONCE_SIZE] = { 0, 0, 0, 0x09, 0, 0, 0, 0x4a, 0, 0, 0, 0 };
+        const unsigned char sunscreenNonce[ChaCha20::NONCE_SIZE] = { 0, 0, 0, 0, 0, 0, 0, 0x4a, 0, 0, 0, 0 };
+
+        char block[ChaCha20::BLOCK_SIZE] = {};
+        applyWith(xorBlocks, block, sizeof(block), key, blockNonce, ChaCha20::BLOCK_SIZE);
+        if (std::memcmp(block, BLOCK_KEYSTREAM, sizeof(block)) != 0) return false;
+
+        char text[sizeof(SUNSCREEN_CIPHERTEXT)];
+        std::memcpy(text, SUNSCREEN, sizeof(text));
+        applyWith(xorBlocks, text, sizeof(text), key, sunscreenNonce, ChaCha20::BLOCK_SIZE);
+        if (std::memcmp(text, SUNSCREEN_CIPHERTEXT, sizeof(text)) != 0) return false;
+
+        // The vectors above are shorter than one vector step, so also check a longer
+        // run against the scalar blocks, starting mid-block and crossing a counter wrap.
+        unsigned char expected[40 * ChaCha20::BLOCK_SIZE];
+        unsigned char actual[sizeof(expected)];
+        uint32_t state[16];
+        initState(state, key, sunscreenNonce);
+        const uint32_t counter = 0xFFFFFFF0u;
+        for (size_t b = 0; b < 40; ++b) keystreamBlock(state, counter + (uint32_t)b, expected + b * ChaCha20::BLOCK_SIZE);
+        std::memset(actual, 0, sizeof(actual));
+        const size_t skip = 5;
+        applyWith(xorBlocks, (char*)actual + skip, sizeof(actual) - skip, key, sunscreenNonce,
+                  (uint64_t)counter * ChaCha20::BLOCK_SIZE + skip);
+        return std::memcmp(actual + skip, expected + skip, sizeof(actual) - skip) == 0;
+    }
+}
+
+void ChaCha20::apply(char* data, size_t n, const unsigned char key[KEY_SIZE], const unsigned char nonce[NONCE_SIZE],
+                     uint64_t position) {
+    applyWith(kernels().xorBlocks, data, n, key, nonce, position);
+}
+
+bool ChaCha20::selfTest() {
+    static const bool passed = [] {
+        if (!passesKnownAnswers(xorBlocksScalar)) return false;
+#if defined(FMS_X86)
+        const CpuFeatures& cpu = CpuFeatures::get();
+        if (cpu.sse2 && !passesKnownAnswers(xorBlocksSse2)) return false;
+        if (cpu.avx2 && !passesKnownAnswers(xorBlocksAvx2)) return false;
+        if (cpu.avx512bw && !passesKnownAnswers(xorBlocksAvx512)) return false;
+#endif
+        return true;
+    }();
+    return passed;
+}
+
+const char* ChaCha20::activeVariant() {
+    return kernels().name;
+}
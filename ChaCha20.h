@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// ChaCha20 stream cipher (RFC 8439): 256-bit key, 96-bit nonce, 32-bit block counter.
+// Besides the scalar reference there are SSE2, AVX2 and AVX-512 versions that work
+// on 4, 8 and 16 blocks at once; the widest one the CPU supports is picked the first
+// time the cipher is used. All versions produce identical output.
+class ChaCha20 {
+public:
+    static const size_t KEY_SIZE = 32;
+    static const size_t NONCE_SIZE = 12;
+    static const size_t BLOCK_SIZE = 64;
+
+    // Length of the keystream of one key and nonce: 2^32 blocks.
+    static const uint64_t MAX_STREAM = (uint64_t)BLOCK_SIZE << 32;
+
+    // XORs data[0, n) with the keystream starting at byte `position` (block counter
+    // position / 64). Encryption and decryption are the same operation; any range of
+    // the stream can be processed on its own. position + n must not exceed MAX_STREAM.
+    static void apply(char* data, size_t n, const unsigned char key[KEY_SIZE],
+                      const unsigned char nonce[NONCE_SIZE], uint64_t position);
+
+    // RFC 8439 known-answer checks, run against every version this CPU can execute.
+    // Run once; the result is cached.
+    static bool selfTest();
+
+    // Name of the version in use ("avx512bw", "avx2", "sse2" or "scalar").
+    static const char* activeVariant();
+};
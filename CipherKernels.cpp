@@ -0,0 +1,236 @@
+#include "CipherKernels.h"
+#include "CpuFeatures.h"
+#include <cstring>
+#include <cstdint>
+
+#if defined(FMS_X86)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+    typedef size_t (*XorRepeatingFn)(char*, size_t, const unsigned char*, size_t, size_t);
+    typedef void (*TranslateLettersFn)(char*, size_t, const unsigned char*);
+    typedef size_t (*CountLettersFn)(const char*, size_t);
+
+    struct Kernels {
+        XorRepeatingFn xorRepeating;
+        TranslateLettersFn translateLetters;
+        CountLettersFn countLetters;
+        const char* name;
+    };
+
+    // --- Scalar: 8 bytes per step ---
+
+    size_t xorRepeatingScalar(char* data, size_t n, const unsigned char* pattern, size_t period, size_t pos) {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            uint64_t block, key;
+            std::memcpy(&block, data + i, 8);
+            std::memcpy(&key, pattern + pos, 8);
+            block ^= key;
+            std::memcpy(data + i, &block, 8);
+            pos += 8;
+            if (pos >= period) pos -= period;
+        }
+        for (; i < n; ++i) {
+            data[i] ^= (char)pattern[pos];
+            if (++pos == period) pos = 0;
+        }
+        return pos;
+    }
+
+    void translateLettersScalar(char* data, size_t n, const unsigned char* table) {
+        // Always look up (with the index masked into range) and select, so letters and
+        // other bytes mixed at random cost no branch mispredictions.
+        for (size_t i = 0; i < n; ++i) {
+            unsigned char c = (unsigned char)data[i];
+            unsigned char offset = (unsigned char)(c - 0x40);
+            unsigned char mapped = table[offset & 0x3F];
+            data[i] = (char)(offset < 0x40 ? mapped : c);
+        }
+    }
+
+    // Folding case with | 0x20 puts both alphabets at 'a'-'z', so a byte is a letter
+    // exactly when (c | 0x20) - 'a' is below 26 as an unsigned byte.
+    size_t countLettersScalar(const char* data, size_t n) {
+        size_t count = 0;
+        for (size_t i = 0; i < n; ++i) {
+            count += (unsigned char)(((unsigned char)data[i] | 0x20) - 'a') < 26;
+        }
+        return count;
+    }
+
+#if defined(FMS_X86)
+    inline unsigned popCount32(unsigned value) {
+#if defined(_MSC_VER)
+        return (unsigned)__popcnt(value);
+#else
+        return (unsigned)__builtin_popcount(value);
+#endif
+    }
+
+    // --- SSE2: 16 bytes per step ---
+
+    FMS_TARGET_SSE2 size_t xorRepeatingSse2(char* data, size_t n, const unsigned char* pattern, size_t period, size_t pos) {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m128i block = _mm_loadu_si128((const __m128i*)(data + i));
+            __m128i key = _mm_loadu_si128((const __m128i*)(pattern + pos));
+            _mm_storeu_si128((__m128i*)(data + i), _mm_xor_si128(block, key));
+            pos += 16;
+            if (pos >= period) pos -= period;
+        }
+        return xorRepeatingScalar(data + i, n - i, pattern, period, pos);
+    }
+
+    FMS_TARGET_SSE2 size_t countLettersSse2(const char* data, size_t n) {
+        const __m128i fold = _mm_set1_epi8(0x20);
+        const __m128i base = _mm_set1_epi8('a');
+        const __m128i last = _mm_set1_epi8(25);
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m128i offset = _mm_sub_epi8(_mm_or_si128(_mm_loadu_si128((const __m128i*)(data + i)), fold), base);
+            __m128i isLetter = _mm_cmpeq_epi8(_mm_min_epu8(offset, last), offset);
+            count += popCount32((unsigned)_mm_movemask_epi8(isLetter));
+        }
+        return count + countLettersScalar(data + i, n - i);
+    }
+
+    // --- AVX2: 32 bytes per step ---
+
+    FMS_TARGET_AVX2 size_t xorRepeatingAvx2(char* data, size_t n, const unsigned char* pattern, size_t period, size_t pos) {
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i block = _mm256_loadu_si256((const __m256i*)(data + i));
+            __m256i key = _mm256_loadu_si256((const __m256i*)(pattern + pos));
+            _mm256_storeu_si256((__m256i*)(data + i), _mm256_xor_si256(block, key));
+            pos += 32;
+            if (pos >= period) pos -= period;
+        }
+        return xorRepeatingSse2(data + i, n - i, pattern, period, pos);
+    }
+
+    // The letter range 0x40-0x7F is four rows of 16 table entries. Each row is looked up
+    // with one byte shuffle on the low nibble, and the row matching the byte's high
+    // nibble is kept; bytes outside the range match no row and pass through.
+
+    FMS_TARGET_AVX2 void translateLettersAvx2(char* data, size_t n, const unsigned char* table) {
+        __m256i rows[4];
+        for (int r = 0; r < 4; ++r) {
+            rows[r] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(table + 16 * r)));
+        }
+        const __m256i highMask = _mm256_set1_epi8((char)0xF0);
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i c = _mm256_loadu_si256((const __m256i*)(data + i));
+            __m256i high = _mm256_and_si256(c, highMask);
+            __m256i out = c;
+            for (int r = 0; r < 4; ++r) {
+                __m256i inRow = _mm256_cmpeq_epi8(high, _mm256_set1_epi8((char)(0x40 + 16 * r)));
+                out = _mm256_blendv_epi8(out, _mm256_shuffle_epi8(rows[r], c), inRow);
+            }
+            _mm256_storeu_si256((__m256i*)(data + i), out);
+        }
+        translateLettersScalar(data + i, n - i, table);
+    }
+
+    FMS_TARGET_AVX2 size_t countLettersAvx2(const char* data, size_t n) {
+        const __m256i fold = _mm256_set1_epi8(0x20);
+        const __m256i base = _mm256_set1_epi8('a');
+        const __m256i last = _mm256_set1_epi8(25);
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i offset = _mm256_sub_epi8(_mm256_or_si256(_mm256_loadu_si256((const __m256i*)(data + i)), fold), base);
+            __m256i isLetter = _mm256_cmpeq_epi8(_mm256_min_epu8(offset, last), offset);
+            count += popCount32((unsigned)_mm256_movemask_epi8(isLetter));
+        }
+        return count + countLettersScalar(data + i, n - i);
+    }
+
+    // --- AVX-512BW: 64 bytes per step ---
+
+    FMS_TARGET_AVX512BW size_t xorRepeatingAvx512(char* data, size_t n, const unsigned char* pattern, size_t period, size_t pos) {
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64) {
+            __m512i block = _mm512_loadu_si512((const void*)(data + i));
+            __m512i key = _mm512_loadu_si512((const void*)(pattern + pos));
+            _mm512_storeu_si512((void*)(data + i), _mm512_xor_si512(block, key));
+            pos += 64;
+            if (pos >= period) pos -= period;
+        }
+        return xorRepeatingSse2(data + i, n - i, pattern, period, pos);
+    }
+
+    FMS_TARGET_AVX512BW void translateLettersAvx512(char* data, size_t n, const unsigned char* table) {
+        __m512i rows[4];
+        for (int r = 0; r < 4; ++r) {
+            unsigned char lanes[64];
+            for (int lane = 0; lane < 4; ++lane) std::memcpy(lanes + 16 * lane, table + 16 * r, 16);
+            rows[r] = _mm512_loadu_si512((const void*)lanes);
+        }
+        const __m512i highMask = _mm512_set1_epi8((char)0xF0);
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64) {
+            __m512i c = _mm512_loadu_si512((const void*)(data + i));
+            __m512i high = _mm512_and_si512(c, highMask);
+            __m512i out = c;
+            for (int r = 0; r < 4; ++r) {
+                __mmask64 inRow = _mm512_cmpeq_epi8_mask(high, _mm512_set1_epi8((char)(0x40 + 16 * r)));
+                out = _mm512_mask_shuffle_epi8(out, inRow, rows[r], c);
+            }
+            _mm512_storeu_si512((void*)(data + i), out);
+        }
+        translateLettersScalar(data + i, n - i, table);
+    }
+
+    FMS_TARGET_AVX512BW size_t countLettersAvx512(const char* data, size_t n) {
+        const __m512i fold = _mm512_set1_epi8(0x20);
+        const __m512i base = _mm512_set1_epi8('a');
+        const __m512i letters = _mm512_set1_epi8(26);
+        size_t count = 0;
+        size_t i = 0;
+        for (; i + 64 <= n; i += 64) {
+            __m512i offset = _mm512_sub_epi8(_mm512_or_si512(_mm512_loadu_si512((const void*)(data + i)), fold), base);
+            unsigned long long isLetter = (unsigned long long)_mm512_cmplt_epu8_mask(offset, letters);
+            count += popCount32((unsigned)isLetter) + popCount32((unsigned)(isLetter >> 32));
+        }
+        return count + countLettersScalar(data + i, n - i);
+    }
+#endif
+
+    Kernels select() {
+#if defined(FMS_X86)
+        const CpuFeatures& cpu = CpuFeatures::get();
+        if (cpu.avx512bw) return { xorRepeatingAvx512, translateLettersAvx512, countLettersAvx512, "avx512bw" };
+        if (cpu.avx2) return { xorRepeatingAvx2, translateLettersAvx2, countLettersAvx2, "avx2" };
+        if (cpu.sse2) return { xorRepeatingSse2, translateLettersScalar, countLettersSse2, "sse2" };
+#endif
+        return { xorRepeatingScalar, translateLettersScalar, countLettersScalar, "scalar" };
+    }
+
+    const Kernels& kernels() {
+        static const Kernels active = select();
+        return active;
+    }
+}
+
+size_t CipherKernels::xorRepeating(char* data, size_t n, const unsigned char* pattern, size_t period, size_t start) {
+    return kernels().xorRepeating(data, n, pattern, period, start);
+}
+
+void CipherKernels::translateLetters(char* data, size_t n, const unsigned char table[64]) {
+    kernels().translateLetters(data, n, table);
+}
+
+size_t CipherKernels::countLetters(const char* data, size_t n) {
+    return kernels().countLetters(data, n);
+}
+
+const char* CipherKernels::activeVariant() {
+    return kernels().name;
+}
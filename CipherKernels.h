@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+
+// Bulk byte transforms used by the ciphers. Each function has a scalar version and
+// SSE2/AVX2/AVX-512BW versions; the widest one the CPU supports is picked the first
+// time one is called. All versions produce identical output.
+class CipherKernels {
+public:
+    // Widest vector the kernels use. Repeating patterns must have a period of at least
+    // this many bytes and carry this many extra bytes past the period (see below).
+    static const size_t MAX_VECTOR = 64;
+
+    // XORs data[0, n) in place with a repeating pattern: data[i] ^= pattern[(start + i) % period].
+    // `pattern` must hold period + MAX_VECTOR bytes of the repeating sequence, and
+    // period must be at least MAX_VECTOR, so every vector load stays inside it and the
+    // position wraps with one subtraction. Returns the position after data[n - 1].
+    static size_t xorRepeating(char* data, size_t n, const unsigned char* pattern, size_t period, size_t start);
+
+    // Replaces every byte c in 0x40-0x7F (the range holding the ASCII letters) with
+    // table[c - 0x40]; all other bytes are left as they are. The vector versions look
+    // the range up with four 16-byte shuffles per vector. SSE2 has no byte shuffle, so
+    // that tier uses the scalar loop.
+    static void translateLetters(char* data, size_t n, const unsigned char table[64]);
+
+    // Number of ASCII letters (A-Z, a-z) in data[0, n).
+    static size_t countLetters(const char* data, size_t n);
+
+    // Name of the variant in use ("avx512bw", "avx2", "sse2" or "scalar").
+    static const char* activeVariant();
+};
@@ -0,0 +1,151 @@
+#include "Codec.h"
+#include "RleCodec.h"
+#include "LzCodec.h"
+#include "HuffmanCodec.h"
+#include "Varint.h"
+#include <cstring>
+#include <cstdint>
+
+namespace {
+    // Keeps the data as it is; chosen when nothing else makes the file smaller.
+    class StoreCodec : public Codec {
+    public:
+        unsigned char id() const override { return 0; }
+        const char* name() const override { return "store"; }
+
+        void compress(const char* data, size_t n, std::vector<char>& out) const override {
+            out.assign(data, data + n);
+        }
+
+        bool decompress(const char* in, size_t n, char* out, size_t rawSize) const override {
+            if (n != rawSize) return false;
+            std::memcpy(out, in, n);
+            return true;
+        }
+
+        size_t maxCompressedSize(size_t n) const override { return n; }
+        size_t maxDecompressedSize(size_t n) const override { return n; }
+    };
+
+    // Runs one codec's output through a second one. The payload starts with the size
+    // of the intermediate stream, which the second codec needs to decode into.
+    class PipelineCodec : public Codec {
+    public:
+        PipelineCodec(unsigned char id, const char* name, const Codec& first, const Codec& second)
+            : id_(id), name_(name), first_(first), second_(second) {}
+
+        unsigned char id() const override { return id_; }
+        const char* name() const override { return name_; }
+
+        void compress(const char* data, size_t n, std::vector<char>& out) const override {
+            thread_local std::vector<char> stage;
+            thread_local std::vector<char> packed;
+            first_.compress(data, n, stage);
+            second_.compress(stage.data(), stage.size(), packed);
+            out.clear();
+            appendVarint(out, stage.size());
+            out.insert(out.end(), packed.begin(), packed.end());
+        }
+
+        bool decompress(const char* in, size_t n, char* out, size_t rawSize) const override {
+            const char* p = in;
+            const char* end = in + n;
+            uint64_t stageSize;
+            if (!parseVarint(p, end, stageSize)) return false;
+            // Anything larger than the first codec can produce is a corrupt header and
+            // must not turn into a huge allocation.
+            if (stageSize > first_.maxCompressedSize(rawSize)) return false;
+
+            thread_local std::vector<char> stage;
+            stage.resize((size_t)stageSize);
+            return second_.decompress(p, (size_t)(end - p), stage.data(), stage.size()) &&
+                   first_.decompress(stage.data(), stage.size(), out, rawSize);
+        }
+
+        size_t maxCompressedSize(size_t n) const override {
+            return 10 + second_.maxCompressedSize(first_.maxCompressedSize(n)); // stage size varint
+        }
+
+        size_t maxDecompressedSize(size_t n) const override {
+            size_t stage = second_.maxDecompressedSize(n);
+            return stage == SIZE_MAX ? SIZE_MAX : first_.maxDecompressedSize(stage);
+        }
+
+    private:
+        unsigned char id_;
+        const char* name_;
+        const Codec& first_;
+        const Codec& second_;
+    };
+
+    // A codec must shrink the sample below this fraction of its size to be worth
+    // the decode cost over storing the data raw.
+    const double MIN_GAIN_RATIO = 0.97;
+
+    // chooseFor() compresses this many evenly spaced slices of the data.
+    const size_t SAMPLE_SLICES = 8;
+    const size_t SAMPLE_SLICE_SIZE = 64 * 1024;
+}
+
+const std::vector<const Codec*>& CodecRegistry::all() {
+    static const StoreCodec store;
+    static const RleCodec rle;
+    static const LzCodec lz;
+    static const HuffmanCodec huff;
+    static const PipelineCodec rleHuff(4, "rle+huff", rle, huff);
+    static const std::vector<const Codec*> codecs = { &store, &rle, &lz, &huff, &rleHuff };
+    return codecs;
+}
+
+const Codec* CodecRegistry::find(const std::string& name) {
+    for (const Codec* codec : all()) {
+        if (name == codec->name()) return codec;
+    }
+    return nullptr;
+}
+
+const Codec* CodecRegistry::find(unsigned char id) {
+    for (const Codec* codec : all()) {
+        if (codec->id() == id) return codec;
+    }
+    return nullptr;
+}
+
+const Codec* CodecRegistry::choose(const char* sample, size_t n) {
+    const Codec* store = all().front();
+    if (n == 0) return store;
+
+    const Codec* best = store;
+    size_t bestSize = n;
+    std::vector<char> out;
+    for (const Codec* codec : all()) {
+        if (codec == store) continue;
+        codec->compress(sample, n, out);
+        if (out.size() < bestSize) {
+            bestSize = out.size();
+            best = codec;
+        }
+    }
+    return (double)bestSize < (double)n * MIN_GAIN_RATIO ? best : store;
+}
+
+const Codec* CodecRegistry::chooseFor(const char* data, size_t size) {
+    if (size <= SAMPLE_SLICES * SAMPLE_SLICE_SIZE) return choose(data, size);
+
+    std::vector<char> sample;
+    sample.reserve(SAMPLE_SLICES * SAMPLE_SLICE_SIZE);
+    for (size_t i = 0; i < SAMPLE_SLICES; ++i) {
+        size_t offset = (size_t)((uint64_t)(size - SAMPLE_SLICE_SIZE) * i / (SAMPLE_SLICES - 1));
+        sample.insert(sample.end(), data + offset, data + offset + SAMPLE_SLICE_SIZE);
+    }
+    return choose(sample.data(), sample.size());
+}
+
+std::string CodecRegistry::names() {
+    std::string result;
+    for (const Codec* codec : all()) {
+        if (!result.empty()) result += ", ";
+        result += codec->name();
+    }
+    return result;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// One block-compression algorithm. Blocks are compressed independently, so a codec
+// keeps no state between calls and every method may run on several threads at once.
+class Codec {
+public:
+    virtual ~Codec() = default;
+
+    // Identifier stored in the compressed file header; never reuse a retired value.
+    virtual unsigned char id() const = 0;
+    virtual const char* name() const = 0;
+
+    // Replaces `out` with the compressed form of data[0, n).
+    virtual void compress(const char* data, size_t n, std::vector<char>& out) const = 0;
+
+    // Decodes a block produced by compress() into exactly `rawSize` bytes at `out`.
+    // Returns false if the input is malformed or does not decode to `rawSize` bytes.
+    virtual bool decompress(const char* in, size_t n, char* out, size_t rawSize) const = 0;
+
+    // Largest output compress() can produce for n bytes of any content, so callers can
+    // size buffers up front and decoders can reject impossible payload sizes.
+    virtual size_t maxCompressedSize(size_t n) const = 0;
+
+    // Largest block decompress() can produce from n bytes of payload (SIZE_MAX if the
+    // format sets no limit), so a block table claiming more is rejected before anything
+    // is allocated for it.
+    virtual size_t maxDecompressedSize(size_t n) const = 0;
+};
+
+class CodecRegistry {
+public:
+    // Every available codec, "store" first.
+    static const std::vector<const Codec*>& all();
+
+    // nullptr if there is no codec with that name/id.
+    static const Codec* find(const std::string& name);
+    static const Codec* find(unsigned char id);
+
+    // Compresses `sample` with every codec and returns the one with the smallest
+    // output, or "store" if no codec makes the sample noticeably smaller.
+    static const Codec* choose(const char* sample, size_t n);
+
+    // choose() on a sample of data[0, size): a few slices spread evenly over it, or all
+    // of it if it is small.
+    static const Codec* chooseFor(const char* data, size_t size);
+
+    // "store, rle, lz, huff, rle+huff" - for usage and error messages.
+    static std::string names();
+};
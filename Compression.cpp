@@ -1,143 +1,647 @@
 #include "Compression.h"
+#include "ThreadPool.h"
+#include "Codec.h"
+#include "RleCodec.h"
+#include "Varint.h"
+#include "MappedFile.h"
+#include "Cancellation.h"
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <filesystem>
 #include <cctype>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
 
 namespace fs = std::filesystem;
 
-bool Compression::compressFile(const std::string& inputFile) {
-    std::ifstream in(inputFile);
-    if (!in) {
+// --- Binary container formats ---
+//
+// Every binary file starts with
+//
+//   magic         4 bytes   0x89 'F' 'M' 'Z'
+//   version       1 byte    1 = single stream, 2 = framed
+//   codec         1 byte    codec id from CodecRegistry (0 = store, 1 = RLE, 2 = LZ, 3 = Huffman, 4 = RLE+Huffman)
+//
+// Version 1 (single stream, RLE only, no longer written) continues with the original
+// size as a varint and then one token stream covering the whole file.
+//
+// Version 2 (framed) splits the input into independent blocks so they can be
+// compressed and decompressed on several threads:
+//
+//   block size    varint    uncompressed size of every block but the last
+//   payloads...             one compressed block per block, back to back
+//   block table   varint count, then (raw size, compressed size) varints per block
+//   table offset  8 bytes   little-endian file offset of the block table
+//   footer        4 bytes   'F' 'M' 'Z' 'T'
+//
+// The payload layout of each codec is described next to its class (RleCodec, LzCodec).
+// The block table doubles as a seek index: prefix sums of the two sizes give every
+// block's offset in the original and in the compressed file, so a byte range can be
+// served by decoding only the blocks that overlap it.
+//
+// The first magic byte is not printable and the second is not a digit, so no file in
+// the legacy text format ("<char><count>...") can be mistaken for a binary one.
+
+namespace {
+    // Block size of framed files and of every write issued by the decoders. Input is
+    // mapped and released block by block, so memory use stays at a few of these per
+    // thread no matter how large the file is.
+    const size_t BLOCK_SIZE = 1 << 20; // 1 MiB
+
+    // A larger block size in a header is damage, not something to allocate for.
+    const uint64_t MAX_BLOCK_SIZE = 64 << 20;
+
+    const unsigned char MAGIC[4] = { 0x89, 'F', 'M', 'Z' };
+    const unsigned char FOOTER_MAGIC[4] = { 'F', 'M', 'Z', 'T' };
+    const unsigned char FORMAT_STREAM = 1;
+    const unsigned char FORMAT_FRAMED = 2;
+    const size_t PREFIX_SIZE = sizeof(MAGIC) + 1; // magic and version byte
+    const size_t FOOTER_SIZE = 8 + sizeof(FOOTER_MAGIC);
+
+    const std::string COMPRESSED_SUFFIX = "_compressed.bin";
+    const std::string LEGACY_COMPRESSED_SUFFIX = "_compressed.txt";
+
+    bool endsWith(const std::string& s, const std::string& suffix) {
+        return s.length() >= suffix.length() && s.compare(s.length() - suffix.length(), suffix.length(), suffix) == 0;
+    }
+
+    bool hasBinaryMagic(const char* data, size_t size) {
+        return size >= PREFIX_SIZE && std::memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+    }
+
+    // Binary data is recognised by its magic; anything else is taken to be the legacy
+    // text format, which has no version to check.
+    EngineStatus checkVersion(const char* data, size_t size) {
+        if (!hasBinaryMagic(data, size)) return EngineStatus::Ok;
+        unsigned char version = (unsigned char)data[sizeof(MAGIC)];
+        return version == FORMAT_STREAM || version == FORMAT_FRAMED ? EngineStatus::Ok : EngineStatus::UnsupportedVersion;
+    }
+
+    // "auto" samples the data; any other name must be a registered codec.
+    EngineStatus pickCodec(const std::string& codecName, const char* data, size_t size, const Codec*& codec) {
+        codec = codecName == "auto" ? CodecRegistry::chooseFor(data, size) : CodecRegistry::find(codecName);
+        return codec != nullptr ? EngineStatus::Ok : EngineStatus::UnknownCodec;
+    }
+
+    // What the encoders and decoders read: a caller's buffer, or a mapped file whose
+    // pages are handed back once consumed, so memory use stays bounded.
+    struct Source {
+        const char* data;
+        size_t size;
+        MappedFile* mapping;
+
+        void release(size_t offset, size_t n) const {
+            if (mapping != nullptr) mapping->release(offset, n);
+        }
+    };
+
+    // Where they write: a caller's buffer, a file, or nowhere (bytes are only counted).
+    // File output is collected into one large block and handed to the stream with a
+    // single write call, instead of going through formatted operator<< for every run;
+    // anything a block or larger goes straight out.
+    class Sink {
+    public:
+        Sink() = default;
+        Sink(char* data, size_t capacity) : data(data), capacity(capacity) {}
+        explicit Sink(std::ofstream& file) : file(&file), buffer(BLOCK_SIZE) {}
+
+        // put() and fill() write nothing and return false if the bytes do not fit.
+        bool put(const char* bytes, size_t n) {
+            if (n > room()) return false;
+            if (data != nullptr) {
+                std::memcpy(data + total, bytes, n);
+            }
+            else if (file != nullptr) {
+                if (n > buffer.size() - used) flush();
+                if (n >= buffer.size()) {
+                    file->write(bytes, (std::streamsize)n);
+                }
+                else {
+                    std::memcpy(buffer.data() + used, bytes, n);
+                    used += n;
+                }
+            }
+            total += n;
+            return true;
+        }
+
+        // Appends `count` copies of `ch`; file output fills the buffer a block at a time.
+        bool fill(char ch, uint64_t count) {
+            if (count > room()) return false;
+            if (data != nullptr) {
+                std::memset(data + total, ch, (size_t)count);
+            }
+            else if (file != nullptr) {
+                for (uint64_t left = count; left > 0;) {
+                    size_t chunk = (size_t)std::min<uint64_t>(left, buffer.size() - used);
+                    std::memset(buffer.data() + used, ch, chunk);
+                    used += chunk;
+                    left -= chunk;
+                    if (used == buffer.size()) flush();
+                }
+            }
+            total += count;
+            return true;
+        }
+
+        // The caller's buffer at the current position, for decoders that write into it
+        // directly and then commit() what they wrote; nullptr for the other sinks.
+        char* next() const { return data != nullptr ? data + total : nullptr; }
+        void commit(size_t n) { total += n; }
+
+        void flush() {
+            if (file != nullptr && used > 0) file->write(buffer.data(), (std::streamsize)used);
+            used = 0;
+        }
+
+        uint64_t room() const { return capacity - total; }
+        uint64_t written() const { return total; }
+
+    private:
+        char* data = nullptr;
+        std::ofstream* file = nullptr;
+        std::vector<char> buffer;
+        size_t used = 0;
+        uint64_t capacity = UINT64_MAX;
+        uint64_t total = 0;
+    };
+
+    // Where every block of a framed file lives, built from its block table. Both offset
+    // lists have one entry more than there are blocks; the last is the end of the data.
+    struct BlockIndex {
+        const Codec* codec = nullptr;
+        std::vector<uint64_t> rawOffsets;    // position in the original file
+        std::vector<uint64_t> packedOffsets; // position in the compressed file
+
+        size_t blockCount() const { return rawOffsets.size() - 1; }
+        size_t rawSize(size_t block) const { return (size_t)(rawOffsets[block + 1] - rawOffsets[block]); }
+        size_t packedSize(size_t block) const { return (size_t)(packedOffsets[block + 1] - packedOffsets[block]); }
+    };
+
+    // Parses the codec byte and block size from the header of a framed file, then the
+    // block table through the footer.
+    EngineStatus readBlockIndex(const char* file, size_t fileSize, BlockIndex& index) {
+        if (fileSize <= PREFIX_SIZE) return EngineStatus::Truncated;
+        index.codec = CodecRegistry::find((unsigned char)file[PREFIX_SIZE]);
+        if (index.codec == nullptr) return EngineStatus::UnknownCodec;
+
+        const char* p = file + PREFIX_SIZE + 1;
+        uint64_t blockSize;
+        if (!parseVarint(p, file + fileSize, blockSize)) return EngineStatus::Truncated;
+        if (blockSize == 0 || blockSize > MAX_BLOCK_SIZE) return EngineStatus::Corrupted;
+        uint64_t payloadStart = (uint64_t)(p - file);
+
+        // Locate the block table through the fixed-size footer.
+        if (fileSize < payloadStart + FOOTER_SIZE) return EngineStatus::Truncated;
+        const unsigned char* footer = (const unsigned char*)file + fileSize - FOOTER_SIZE;
+        uint64_t tableOffset = 0;
+        for (int i = 0; i < 8; ++i) tableOffset |= (uint64_t)footer[i] << (8 * i);
+        if (std::memcmp(footer + 8, FOOTER_MAGIC, sizeof(FOOTER_MAGIC)) != 0 ||
+            tableOffset < payloadStart || tableOffset > fileSize - FOOTER_SIZE) {
+            return EngineStatus::Corrupted;
+        }
+
+        const char* tp = file + tableOffset;
+        const char* tableEnd = file + fileSize - FOOTER_SIZE;
+        uint64_t blockCount;
+        bool tableOk = parseVarint(tp, tableEnd, blockCount) && blockCount <= (uint64_t)(tableEnd - tp);
+        index.rawOffsets.assign(1, 0);
+        index.packedOffsets.assign(1, payloadStart);
+        // Every size is checked before the decoders allocate for it: a block holds no more
+        // than the block size, nor more than its codec can make of its payload.
+        for (uint64_t i = 0; tableOk && i < blockCount; ++i) {
+            uint64_t rawSize = 0, packedSize = 0;
+            tableOk = parseVarint(tp, tableEnd, rawSize) && parseVarint(tp, tableEnd, packedSize) &&
+                      rawSize <= blockSize && packedSize <= tableOffset - index.packedOffsets.back() &&
+                      rawSize <= index.codec->maxDecompressedSize((size_t)packedSize);
+            index.rawOffsets.push_back(index.rawOffsets.back() + rawSize);
+            index.packedOffsets.push_back(index.packedOffsets.back() + packedSize);
+        }
+        if (!tableOk || tp != tableEnd || index.packedOffsets.back() != tableOffset) return EngineStatus::Corrupted;
+        return EngineStatus::Ok;
+    }
+
+    // Largest framed output for n bytes with `codec`: header, payloads, a block table
+    // of at most two 10-byte varints per block and the footer.
+    size_t framedBound(const Codec* codec, size_t n) {
+        size_t blockCount = (n + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        size_t bound = PREFIX_SIZE + 1 + 10 + 10 + blockCount * 20 + FOOTER_SIZE;
+        if (blockCount > 0) {
+            bound += (blockCount - 1) * codec->maxCompressedSize(BLOCK_SIZE);
+            bound += codec->maxCompressedSize(n - (blockCount - 1) * BLOCK_SIZE);
+        }
+        return bound;
+    }
+
+    EngineStatus encodeFramed(const Source& input, const Codec* codec, unsigned threads, Sink& out, size_t& blockCount) {
+        if (threads == 0) threads = 1;
+        ThreadPool pool(threads - 1);
+
+        std::vector<char> header(MAGIC, MAGIC + sizeof(MAGIC));
+        header.push_back((char)FORMAT_FRAMED);
+        header.push_back((char)codec->id());
+        appendVarint(header, BLOCK_SIZE);
+        if (!out.put(header.data(), header.size())) return EngineStatus::OutputTooSmall;
+        uint64_t written = header.size();
+
+        // Blocks are compressed straight out of the input in batches of two per thread,
+        // so every thread has work queued; each batch's input pages are released once
+        // its output is written.
+        const char* data = input.data;
+        size_t inputSize = input.size;
+        blockCount = (inputSize + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        size_t batchSize = (size_t)threads * 2;
+        std::vector<std::vector<char>> packed(batchSize);
+        std::vector<char> table;
+
+        for (size_t first = 0; first < blockCount; first += batchSize) {
+            if (Cancellation::requested()) return EngineStatus::Cancelled;
+            size_t count = std::min(batchSize, blockCount - first);
+            size_t batchStart = first * BLOCK_SIZE;
+            size_t batchEnd = std::min(inputSize, (first + count) * BLOCK_SIZE);
+
+            pool.parallelFor(count, [&](size_t i) {
+                size_t offset = batchStart + i * BLOCK_SIZE;
+                codec->compress(data + offset, std::min(BLOCK_SIZE, inputSize - offset), packed[i]);
+            });
+
+            for (size_t i = 0; i < count; ++i) {
+                size_t offset = batchStart + i * BLOCK_SIZE;
+                if (!out.put(packed[i].data(), packed[i].size())) return EngineStatus::OutputTooSmall;
+                appendVarint(table, std::min(BLOCK_SIZE, inputSize - offset));
+                appendVarint(table, packed[i].size());
+                written += packed[i].size();
+            }
+            input.release(batchStart, batchEnd - batchStart);
+        }
+
+        std::vector<char> trailer;
+        appendVarint(trailer, blockCount);
+        trailer.insert(trailer.end(), table.begin(), table.end());
+        for (int i = 0; i < 8; ++i) trailer.push_back((char)(written >> (8 * i)));
+        trailer.insert(trailer.end(), FOOTER_MAGIC, FOOTER_MAGIC + sizeof(FOOTER_MAGIC));
+        if (!out.put(trailer.data(), trailer.size())) return EngineStatus::OutputTooSmall;
+        return EngineStatus::Ok;
+    }
+
+    EngineStatus decodeFramed(const Source& input, Sink& out, unsigned threads) {
+        BlockIndex index;
+        EngineStatus status = readBlockIndex(input.data, input.size, index);
+        if (status != EngineStatus::Ok) return status;
+        if (index.rawOffsets.back() > out.room()) return EngineStatus::OutputTooSmall;
+        const Codec* codec = index.codec;
+        size_t blockCount = index.blockCount();
+
+        if (threads == 0) threads = 1;
+        ThreadPool pool(threads - 1);
+        size_t batchSize = (size_t)threads * 2;
+        std::vector<std::vector<char>> raw(batchSize);
+        std::vector<char> ok(batchSize);
+
+        // A caller's buffer is decoded into directly; file output goes through one
+        // buffer per block of the batch.
+        char* direct = out.next();
+        for (size_t first = 0; first < blockCount; first += batchSize) {
+            if (Cancellation::requested()) return EngineStatus::Cancelled;
+            size_t count = std::min(batchSize, blockCount - first);
+            if (direct == nullptr) {
+                for (size_t i = 0; i < count; ++i) raw[i].resize(index.rawSize(first + i));
+            }
+
+            pool.parallelFor(count, [&](size_t i) {
+                size_t block = first + i;
+                char* target = direct != nullptr ? direct + index.rawOffsets[block] : raw[i].data();
+                ok[i] = codec->decompress(input.data + index.packedOffsets[block], index.packedSize(block), target,
+                                          index.rawSize(block));
+            });
+
+            for (size_t i = 0; i < count; ++i) {
+                if (!ok[i]) return EngineStatus::Corrupted;
+                if (direct != nullptr) out.commit(index.rawSize(first + i));
+                else out.put(raw[i].data(), raw[i].size());
+            }
+            uint64_t batchStart = index.packedOffsets[first];
+            input.release((size_t)batchStart, (size_t)(index.packedOffsets[first + count] - batchStart));
+        }
+        return EngineStatus::Ok;
+    }
+
+    EngineStatus decodeStream(const Source& input, Sink& out) {
+        const char* p = input.data + PREFIX_SIZE;
+        const char* end = input.data + input.size;
+
+        uint64_t originalSize;
+        if (p == end) return EngineStatus::Truncated;
+        unsigned char codec = (unsigned char)*p++;
+        if (!parseVarint(p, end, originalSize)) return EngineStatus::Truncated;
+        if (codec != RleCodec::ID) return EngineStatus::UnknownCodec;
+        if (originalSize > out.room()) return EngineStatus::OutputTooSmall;
+
+        uint64_t produced = 0;
+        const char* released = input.data;
+        while (p < end) {
+            if ((size_t)(p - released) >= BLOCK_SIZE) {
+                input.release((size_t)(released - input.data), (size_t)(p - released));
+                released = p;
+            }
+
+            uint64_t header;
+            if (!parseVarint(p, end, header)) return EngineStatus::Truncated;
+            uint64_t length = header >> 1;
+            // Never more than the recorded original size
+            if (length == 0 || length > originalSize - produced) return EngineStatus::Corrupted;
+
+            if (header & 1) {
+                if (p == end) return EngineStatus::Truncated;
+                out.fill(*p++, length);
+            }
+            else {
+                if ((uint64_t)(end - p) < length) return EngineStatus::Truncated;
+                out.put(p, (size_t)length);
+                p += length;
+            }
+            produced += length;
+        }
+        return produced == originalSize ? EngineStatus::Ok : EngineStatus::Truncated;
+    }
+
+    EngineStatus decodeLegacyText(const Source& input, Sink& out) {
+        // Parser state carries from one run to the next: each run is a character followed
+        // by the digits of its count.
+        bool haveChar = false;
+        char ch = 0;
+        uint64_t count = 0;
+        size_t digitCount = 0;
+
+        const char* data = input.data;
+        for (size_t i = 0; i < input.size; ++i) {
+            if (i % BLOCK_SIZE == 0 && i > 0) input.release(i - BLOCK_SIZE, BLOCK_SIZE);
+            char c = data[i];
+            bool isDigit = c >= '0' && c <= '9';
+
+            if (!haveChar) {
+                if (isDigit) return EngineStatus::Corrupted; // a count without its character
+                ch = c;
+                haveChar = true;
+            }
+            else if (isDigit) {
+                if (count > (UINT64_MAX - 9) / 10) return EngineStatus::Corrupted;
+                count = count * 10 + (uint64_t)(c - '0');
+                digitCount++;
+            }
+            else {
+                if (digitCount == 0) return EngineStatus::Corrupted; // a character without its count
+                if (!out.fill(ch, count)) return EngineStatus::OutputTooSmall;
+                ch = c;
+                count = 0;
+                digitCount = 0;
+            }
+        }
+
+        if (haveChar) {
+            if (digitCount == 0) return EngineStatus::Corrupted;
+            if (!out.fill(ch, count)) return EngineStatus::OutputTooSmall;
+        }
+        return EngineStatus::Ok;
+    }
+
+    EngineStatus decode(const Source& input, Sink& out, unsigned threads) {
+        EngineStatus status = checkVersion(input.data, input.size);
+        if (status != EngineStatus::Ok) return status;
+        if (!hasBinaryMagic(input.data, input.size)) return decodeLegacyText(input, out);
+        if ((unsigned char)input.data[sizeof(MAGIC)] == FORMAT_STREAM) return decodeStream(input, out);
+        return decodeFramed(input, out, threads);
+    }
+}
+
+bool Compression::compressFile(const std::string& inputFile, unsigned threads, const std::string& codecName) {
+    MappedFile input;
+    if (!input.open(inputFile)) {
         std::cerr << "Error opening file for compression: " << inputFile << "\n";
         return false;
     }
 
     // Prevent double compression
-    if (inputFile.length() >= 15 && inputFile.substr(inputFile.length() - 15) == "_compressed.txt") {
+    if (endsWith(inputFile, COMPRESSED_SUFFIX) || endsWith(inputFile, LEGACY_COMPRESSED_SUFFIX)) {
         std::cerr << "Error: File '" << inputFile << "' is already compressed.\n";
-        in.close();
+        return false;
+    }
+
+    const Codec* codec = nullptr;
+    if (pickCodec(codecName, input.data(), input.size(), codec) != EngineStatus::Ok) {
+        std::cerr << "Error: Unknown codec '" << codecName << "'. Available: " << CodecRegistry::names() << ", auto.\n";
         return false;
     }
 
     size_t last_dot_pos = inputFile.find_last_of('.');
     std::string base_name = (last_dot_pos == std::string::npos) ? inputFile : inputFile.substr(0, last_dot_pos);
-    std::string outputFile = base_name + "_compressed.txt";
+    std::string outputFile = base_name + COMPRESSED_SUFFIX;
 
-    std::ofstream out(outputFile);
+    std::ofstream out(outputFile, std::ios::binary);
     if (!out) {
         std::cerr << "Error creating compressed file: " << outputFile << "\n";
-        in.close();
         return false;
     }
 
-    char currentChar;
-    if (!in.get(currentChar)) {
-        std::cout << "Input file is empty. Created empty compressed file: " << outputFile << "\n";
-        in.close();
-        out.close();
-        return true;
-    }
-
-    int count = 1;
-    char nextChar;
+    if (threads == 0) threads = 1;
+    Sink sink(out);
+    size_t blockCount = 0;
+    EngineStatus status = encodeFramed({ input.data(), input.size(), &input }, codec, threads, sink, blockCount);
+    sink.flush();
+    out.close();
 
-    while (in.get(nextChar)) {
-        if (nextChar == currentChar) {
-            count++;
-        }
-        else {
-            out << currentChar << count;
-            currentChar = nextChar;
-            count = 1;
-        }
+    // Only a cancelled job stops a file sink early, but a failed write also leaves a
+    // partial file; either way what was written is of no use.
+    std::error_code ec;
+    if (status != EngineStatus::Ok) {
+        fs::remove(outputFile, ec);
+        std::cerr << "Compression of '" << inputFile << "' " << describe(status) << ".\n";
+        return false;
+    }
+    if (!out) {
+        std::cerr << "Error writing compressed file: " << outputFile << "\n";
+        fs::remove(outputFile, ec);
+        return false;
     }
 
-    out << currentChar << count;
-
-    in.close();
-    out.close();
-
-    std::cout << "File compressed to: " << outputFile << "\n";
+    if (input.size() == 0) {
+        std::cout << "Input file is empty. Created empty compressed file: " << outputFile << "\n";
+    }
+    else {
+        std::cout << "File compressed to: " << outputFile << " (codec " << codec->name() << ", " << blockCount << " blocks, "
+                  << threads << (threads == 1 ? " thread)\n" : " threads)\n");
+    }
     return true;
 }
 
-bool Compression::decompressFile(const std::string& inputFile) {
-    size_t compressed_suffix_pos = inputFile.find("_compressed.txt");
-    if (compressed_suffix_pos == std::string::npos || compressed_suffix_pos != inputFile.length() - 15) {
-        std::cerr << "Error: Only files with a '_compressed.txt' suffix can be decompressed.\n";
-        return false;
+bool Compression::decompressFile(const std::string& inputFile, unsigned threads) {
+    std::string suffix;
+    if (endsWith(inputFile, COMPRESSED_SUFFIX)) {
+        suffix = COMPRESSED_SUFFIX;
     }
-
-    // Check if file is already decompressed
-    if (inputFile.length() >= 15 && inputFile.substr(inputFile.length() - 15) == "_decompressed.txt") {
-        std::cerr << "Error: File '" << inputFile << "' is already decompressed.\n";
+    else if (endsWith(inputFile, LEGACY_COMPRESSED_SUFFIX)) {
+        suffix = LEGACY_COMPRESSED_SUFFIX;
+    }
+    else {
+        std::cerr << "Error: Only files with a '" << COMPRESSED_SUFFIX << "' or '" << LEGACY_COMPRESSED_SUFFIX
+                  << "' suffix can be decompressed.\n";
         return false;
     }
 
-    std::ifstream in(inputFile);
-    if (!in) {
+    MappedFile input;
+    if (!input.open(inputFile)) {
         std::cerr << "Error opening file for decompression: " << inputFile << "\n";
         return false;
     }
 
-    std::string baseName = inputFile.substr(0, compressed_suffix_pos);
+    std::string baseName = inputFile.substr(0, inputFile.length() - suffix.length());
     std::string outputFile = baseName + "_decompressed.txt";
 
-    std::ofstream out(outputFile);
+    // Checked before the output file is created, so an unreadable file leaves nothing behind
+    if (checkVersion(input.data(), input.size()) != EngineStatus::Ok) {
+        std::cerr << "Error: Unsupported compressed format version " << (int)(unsigned char)input.data()[sizeof(MAGIC)] << ".\n";
+        return false;
+    }
+
+    std::ofstream out(outputFile, std::ios::binary);
     if (!out) {
         std::cerr << "Error creating decompressed file: " << outputFile << "\n";
-        in.close();
         return false;
     }
 
-    char ch;
-    while (in.get(ch)) {
-        if (std::isdigit(ch)) {
-            std::cerr << "Error: Unexpected digit '" << ch << "'  file may be corrupted.\n";
-            out.close();
-            in.close();
-            return false;
-        }
+    Sink sink(out);
+    EngineStatus status = decode({ input.data(), input.size(), &input }, sink, threads);
+    sink.flush();
+    out.close();
+    // Whatever the failure (a corrupt block, a cancelled job, a full disk), what was
+    // written is incomplete and is removed.
+    std::error_code ec;
+    if (status != EngineStatus::Ok) {
+        std::cerr << "Error: Could not decompress '" << inputFile << "': " << describe(status) << ".\n";
+        fs::remove(outputFile, ec);
+        return false;
+    }
+    if (!out) {
+        std::cerr << "Error writing decompressed file: " << outputFile << "\n";
+        fs::remove(outputFile, ec);
+        return false;
+    }
+    std::cout << "File decompressed to: " << outputFile << "\n";
+    return true;
+}
 
-        std::string countStr;
-        char digit;
-        while (in.get(digit) && std::isdigit(digit)) {
-            countStr += digit;
-        }
+bool Compression::readRange(const std::string& inputFile, uint64_t offset, uint64_t length, std::ostream& out) {
+    MappedFile input;
+    if (!input.open(inputFile, MappedFile::Access::Random)) {
+        std::cerr << "Error opening file for reading: " << inputFile << "\n";
+        return false;
+    }
+    const char* data = input.data();
 
-        if (in.good() && !std::isdigit(digit)) {
-            in.unget();
+    if (!hasBinaryMagic(data, input.size())) {
+        if (endsWith(inputFile, LEGACY_COMPRESSED_SUFFIX)) {
+            std::cerr << "Error: Legacy compressed files have no block index. Decompress the file instead.\n";
+            return false;
         }
-        else if (in.fail() && !in.eof()) {
-            std::cerr << "Error reading count after '" << ch << "'. File might be corrupted.\n";
-            out.close(); in.close(); return false;
+        // Not compressed: the range maps straight onto the file.
+        if (offset > input.size()) {
+            std::cerr << "Error: Offset " << offset << " is past the end of the file (" << input.size() << " bytes).\n";
+            return false;
         }
+        length = std::min<uint64_t>(length, input.size() - offset);
+        out.write(data + offset, (std::streamsize)length);
+        return true;
+    }
 
-        if (countStr.empty()) {
-            std::cerr << "Error: Missing count for character '" << ch << "'.\n";
-            out.close(); in.close(); return false;
-        }
+    if ((unsigned char)data[sizeof(MAGIC)] != FORMAT_FRAMED) {
+        std::cerr << "Error: This compressed file has no block index. Decompress it, or compress the original again.\n";
+        return false;
+    }
 
-        int count;
-        try {
-            count = std::stoi(countStr);
-        }
-        catch (...) {
-            std::cerr << "Error: Invalid count '" << countStr << "'.\n";
-            out.close(); in.close(); return false;
+    BlockIndex index;
+    EngineStatus status = readBlockIndex(data, input.size(), index);
+    if (status != EngineStatus::Ok) {
+        std::cerr << "Error: Could not read the block index of '" << inputFile << "': " << describe(status) << ".\n";
+        return false;
+    }
+    uint64_t totalSize = index.rawOffsets.back();
+    if (offset > totalSize) {
+        std::cerr << "Error: Offset " << offset << " is past the end of the file (" << totalSize << " bytes).\n";
+        return false;
+    }
+    length = std::min(length, totalSize - offset);
+
+    // Only the blocks overlapping [offset, offset + length) are decoded: the first is
+    // the last block starting at or before `offset`.
+    size_t block = (size_t)(std::upper_bound(index.rawOffsets.begin(), index.rawOffsets.end(), offset) -
+                            index.rawOffsets.begin()) - 1;
+    std::vector<char> buffer;
+    while (length > 0) {
+        buffer.resize(index.rawSize(block));
+        if (!index.codec->decompress(data + index.packedOffsets[block], index.packedSize(block), buffer.data(), buffer.size())) {
+            std::cerr << "Error: Block " << block << " is corrupted.\n";
+            return false;
         }
 
-        for (int i = 0; i < count; ++i) out << ch;
+        size_t skip = (size_t)(offset - index.rawOffsets[block]);
+        size_t chunk = (size_t)std::min<uint64_t>(length, buffer.size() - skip);
+        out.write(buffer.data() + skip, (std::streamsize)chunk);
+        offset += chunk;
+        length -= chunk;
+        block++;
     }
+    return true;
+}
+
+// --- In-memory API ---
+size_t Compression::compressBound(size_t n) {
+    size_t bound = 0;
+    for (const Codec* codec : CodecRegistry::all()) bound = std::max(bound, framedBound(codec, n));
+    return bound;
+}
 
-    if (in.fail() && !in.eof()) {
-        std::cerr << "Error reading compressed data. File might be corrupted.\n";
-        out.close(); in.close(); return false;
+EngineStatus Compression::compressBuffer(const char* in, size_t n, char* out, size_t capacity, size_t& written,
+                                         const std::string& codecName, unsigned threads) {
+    const Codec* codec = nullptr;
+    EngineStatus status = pickCodec(codecName, in, n, codec);
+    if (status != EngineStatus::Ok) return status;
+
+    Sink sink(out, capacity);
+    size_t blockCount = 0;
+    status = encodeFramed({ in, n, nullptr }, codec, threads, sink, blockCount);
+    written = (size_t)sink.written();
+    return status;
+}
+
+EngineStatus Compression::decompressedSize(const char* in, size_t n, uint64_t& size) {
+    EngineStatus status = checkVersion(in, n);
+    if (status != EngineStatus::Ok) return status;
+
+    if (hasBinaryMagic(in, n) && (unsigned char)in[sizeof(MAGIC)] == FORMAT_FRAMED) {
+        BlockIndex index;
+        status = readBlockIndex(in, n, index);
+        if (status == EngineStatus::Ok) size = index.rawOffsets.back();
+        return status;
     }
+    if (hasBinaryMagic(in, n)) {
+        // The stream format records the size after its codec byte
+        if (n <= PREFIX_SIZE) return EngineStatus::Truncated;
+        const char* p = in + PREFIX_SIZE + 1;
+        return parseVarint(p, in + n, size) ? EngineStatus::Ok : EngineStatus::Truncated;
+    }
+    Sink counter;
+    status = decodeLegacyText({ in, n, nullptr }, counter);
+    size = counter.written();
+    return status;
+}
 
-    in.close(); out.close();
-    std::cout << "File decompressed to: " << outputFile << "\n";
-    return true;
+EngineStatus Compression::decompressBuffer(const char* in, size_t n, char* out, size_t capacity, size_t& written,
+                                           unsigned threads) {
+    Sink sink(out, capacity);
+    EngineStatus status = decode({ in, n, nullptr }, sink, threads);
+    written = (size_t)sink.written();
+    return status;
 }
@@ -1,10 +1,35 @@
 #pragma once
+#include "EngineStatus.h"
 #include <string>
-#include <vector>
+#include <ostream>
+#include <cstddef>
+#include <cstdint>
 
 class Compression {
 public:
-    static bool compressFile(const std::string& inputFile);
-    static bool decompressFile(const std::string& inputFile);
+    // `threads` blocks are compressed/decompressed concurrently (framed format only).
+    // `codecName` is a CodecRegistry name, or "auto" to pick one from a sample of the file.
+    static bool compressFile(const std::string& inputFile, unsigned threads = 1, const std::string& codecName = "auto");
+    static bool decompressFile(const std::string& inputFile, unsigned threads = 1);
 
+    // Writes `length` bytes of the original content starting at `offset` (clamped to the
+    // end of the data) to `out`. Framed compressed files decode only the blocks covering
+    // the range; files that are not compressed are read directly.
+    static bool readRange(const std::string& inputFile, uint64_t offset, uint64_t length, std::ostream& out);
+
+    // --- In-memory API ---
+    // The same formats on buffers the caller owns: no files, nothing printed. Output
+    // goes to out[0, capacity) and `written` is set to its size on success; the input
+    // and output must not overlap. compressFile and decompressFile run the same code.
+
+    // Largest compressBuffer() result for n bytes, whatever the codec.
+    static size_t compressBound(size_t n);
+    static EngineStatus compressBuffer(const char* in, size_t n, char* out, size_t capacity, size_t& written,
+                                       const std::string& codecName = "auto", unsigned threads = 1);
+
+    // Size of the data compressed in in[0, n), read from the header of the binary
+    // formats (legacy text files are scanned for it).
+    static EngineStatus decompressedSize(const char* in, size_t n, uint64_t& size);
+    static EngineStatus decompressBuffer(const char* in, size_t n, char* out, size_t capacity, size_t& written,
+                                         unsigned threads = 1);
 };
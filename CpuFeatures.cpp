@@ -0,0 +1,94 @@
+#include "CpuFeatures.h"
+#include <cstdlib>
+#include <cstring>
+
+#if defined(FMS_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+    bool scalarForced() {
+        const char* name = "FMS_FORCE_SCALAR";
+#if defined(_MSC_VER)
+        // getenv is deprecated on MSVC (an error with SDL checks on)
+        char* value = nullptr;
+        size_t length = 0;
+        bool forced = _dupenv_s(&value, &length, name) == 0 && value != nullptr && *value != '\0' &&
+                      std::strcmp(value, "0") != 0;
+        std::free(value);
+        return forced;
+#else
+        const char* value = std::getenv(name);
+        return value != nullptr && *value != '\0' && std::strcmp(value, "0") != 0;
+#endif
+    }
+
+#if defined(FMS_X86)
+    void cpuid(unsigned leaf, unsigned subleaf, unsigned regs[4]) {
+#if defined(_MSC_VER)
+        int out[4];
+        __cpuidex(out, (int)leaf, (int)subleaf);
+        for (int i = 0; i < 4; ++i) regs[i] = (unsigned)out[i];
+#else
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    // Register state the OS saves on context switch (XCR0).
+    unsigned long long xgetbv0() {
+#if defined(_MSC_VER)
+        return _xgetbv(0);
+#else
+        unsigned eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return ((unsigned long long)edx << 32) | eax;
+#endif
+    }
+
+    CpuFeatures detect() {
+        CpuFeatures features;
+        unsigned regs[4];
+        cpuid(0, 0, regs);
+        unsigned maxLeaf = regs[0];
+        if (maxLeaf < 1) return features;
+
+        cpuid(1, 0, regs);
+        features.sse2 = (regs[3] & (1u << 26)) != 0;
+        features.sse42 = (regs[2] & (1u << 20)) != 0;
+        bool osxsave = (regs[2] & (1u << 27)) != 0;
+        bool avx = (regs[2] & (1u << 28)) != 0;
+        if (!osxsave || !avx || maxLeaf < 7) return features;
+
+        unsigned long long xcr0 = xgetbv0();
+        bool ymmState = (xcr0 & 0x6) == 0x6;   // XMM + YMM
+        bool zmmState = (xcr0 & 0xE6) == 0xE6; // plus opmask and both ZMM halves
+
+        cpuid(7, 0, regs);
+        features.avx2 = ymmState && (regs[1] & (1u << 5)) != 0;
+        bool avx512f = (regs[1] & (1u << 16)) != 0;
+        bool avx512bw = (regs[1] & (1u << 30)) != 0;
+        features.avx512bw = zmmState && avx512f && avx512bw;
+        return features;
+    }
+#else
+    CpuFeatures detect() {
+        return CpuFeatures();
+    }
+#endif
+}
+
+const CpuFeatures& CpuFeatures::get() {
+    static const CpuFeatures features = [] {
+        if (scalarForced()) {
+            CpuFeatures scalar;
+            scalar.forcedScalar = true;
+            return scalar;
+        }
+        return detect();
+    }();
+    return features;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+// x86 builds get SIMD kernels picked at runtime; everything else uses the scalar code.
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define FMS_X86 1
+#endif
+
+// GCC and Clang only emit AVX2/AVX-512 instructions inside functions marked for that
+// ISA; MSVC accepts the intrinsics anywhere, so the markers expand to nothing there.
+#if defined(FMS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define FMS_TARGET_SSE2 __attribute__((target("sse2")))
+#define FMS_TARGET_SSE42 __attribute__((target("sse4.2")))
+#define FMS_TARGET_AVX2 __attribute__((target("avx2")))
+#define FMS_TARGET_AVX512BW __attribute__((target("avx512f,avx512bw")))
+#else
+#define FMS_TARGET_SSE2
+#define FMS_TARGET_SSE42
+#define FMS_TARGET_AVX2
+#define FMS_TARGET_AVX512BW
+#endif
+
+// Instruction set extensions usable on this machine (CPU support plus OS support
+// for the wider register state). Detected once, on first use; every kernel family
+// (RunScan, CipherKernels, ChaCha20, Crc32c) binds its variants from these flags.
+struct CpuFeatures {
+    bool sse2 = false;
+    bool sse42 = false;
+    bool avx2 = false;
+    bool avx512bw = false;
+
+    // Set when the FMS_FORCE_SCALAR environment variable is set to anything but "0".
+    // All the flags above are then false, so every kernel runs its scalar version.
+    bool forcedScalar = false;
+
+    static const CpuFeatures& get();
+};
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// CRC-32C (Castagnoli polynomial, as used by iSCSI and ext4). The SSE4.2 crc32
+// instruction computes exactly this checksum; without it a slicing-by-8 table version
+// is used. Picked the first time it is called; both give identical results.
+class Crc32c {
+public:
+    // Checksum of data[0, n) continuing from `crc`, the checksum of everything before
+    // it (0 to start a new one).
+    static uint32_t update(uint32_t crc, const void* data, size_t n);
+
+    // Name of the variant in use ("sse4.2" or "scalar").
+    static const char* activeVariant();
+};
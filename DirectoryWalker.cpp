@@ -0,0 +1,207 @@
+#include "DirectoryWalker.h"
+#include "WorkStealingPool.h"
+#include "ThreadPool.h"
+#include "Cancellation.h"
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <system_error>
+
+#if defined(__linux__)
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#else
+#include <filesystem>
+#endif
+
+namespace {
+    std::string childPath(const std::string& parent, const std::string& name) {
+        if (parent == ".") return name;
+        if (!parent.empty() && (parent.back() == '/' || parent.back() == '\\')) return parent + name;
+        return parent + "/" + name;
+    }
+
+#if defined(__linux__)
+    // The record getdents64 fills the buffer with (see getdents(2)).
+    struct LinuxDirent64 {
+        uint64_t d_ino;
+        int64_t d_off;
+        unsigned short d_reclen;
+        unsigned char d_type;
+        char d_name[1];
+    };
+
+    // Directories of a few thousand entries come in with one system call.
+    const size_t DIRENT_BUFFER_SIZE = 256 * 1024;
+
+    DirectoryWalker::Type typeFromMode(unsigned mode) {
+        if (S_ISREG(mode)) return DirectoryWalker::Type::File;
+        if (S_ISDIR(mode)) return DirectoryWalker::Type::Directory;
+        if (S_ISLNK(mode)) return DirectoryWalker::Type::Symlink;
+        return DirectoryWalker::Type::Other;
+    }
+
+    // Reads the entries of `path`. Returns 0 or an errno value.
+    int readDirectory(const std::string& path, bool wantStat, std::vector<DirectoryWalker::Entry>& entries) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd < 0) return errno;
+
+        thread_local std::vector<char> buffer(DIRENT_BUFFER_SIZE);
+        std::vector<size_t> untyped; // entries whose file system leaves d_type unknown
+        while (true) {
+            long n = syscall(SYS_getdents64, fd, buffer.data(), buffer.size());
+            if (n < 0) {
+                int error = errno;
+                ::close(fd);
+                return error;
+            }
+            if (n == 0) break;
+            for (long offset = 0; offset < n;) {
+                const LinuxDirent64* record = reinterpret_cast<const LinuxDirent64*>(buffer.data() + offset);
+                offset += record->d_reclen;
+                const char* name = record->d_name;
+                if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+
+                DirectoryWalker::Entry entry;
+                entry.name = name;
+                switch (record->d_type) {
+                case DT_REG: entry.type = DirectoryWalker::Type::File; break;
+                case DT_DIR: entry.type = DirectoryWalker::Type::Directory; break;
+                case DT_LNK: entry.type = DirectoryWalker::Type::Symlink; break;
+                case DT_UNKNOWN: entry.type = DirectoryWalker::Type::Other; untyped.push_back(entries.size()); break;
+                default: entry.type = DirectoryWalker::Type::Other; break;
+                }
+                entries.push_back(std::move(entry));
+            }
+        }
+
+        // statx relative to the open directory: no path lookup from the root per entry,
+        // and only the fields asked for are fetched.
+        auto fetch = [&](DirectoryWalker::Entry& entry) {
+            struct statx info;
+            unsigned mask = STATX_TYPE | (wantStat ? STATX_SIZE | STATX_MTIME : 0);
+            if (statx(fd, entry.name.c_str(), AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT | AT_STATX_DONT_SYNC, mask, &info) != 0) {
+                return;
+            }
+            entry.type = typeFromMode(info.stx_mode);
+            entry.size = info.stx_size;
+            entry.mtime = info.stx_mtime.tv_sec;
+        };
+        if (wantStat) {
+            for (auto& entry : entries) fetch(entry);
+        }
+        else {
+            for (size_t index : untyped) fetch(entries[index]);
+        }
+        ::close(fd);
+        return 0;
+    }
+#else
+    namespace fs = std::filesystem;
+
+    int readDirectory(const std::string& path, bool wantStat, std::vector<DirectoryWalker::Entry>& entries) {
+        std::error_code ec;
+        fs::directory_iterator it(path, ec), end;
+        for (; !ec && it != end; it.increment(ec)) {
+            DirectoryWalker::Entry entry;
+            entry.name = it->path().filename().string();
+            std::error_code statError;
+            fs::file_status status = it->symlink_status(statError);
+            if (fs::is_regular_file(status)) entry.type = DirectoryWalker::Type::File;
+            else if (fs::is_directory(status)) entry.type = DirectoryWalker::Type::Directory;
+            else if (fs::is_symlink(status)) entry.type = DirectoryWalker::Type::Symlink;
+            else entry.type = DirectoryWalker::Type::Other;
+            if (wantStat && entry.type == DirectoryWalker::Type::File) {
+                entry.size = it->file_size(statError);
+                // file_time_type has no fixed epoch in C++17: go through the current time.
+                auto written = it->last_write_time(statError);
+                auto age = fs::file_time_type::clock::now() - written;
+                entry.mtime = std::chrono::duration_cast<std::chrono::seconds>(
+                                  (std::chrono::system_clock::now() - age).time_since_epoch()).count();
+            }
+            entries.push_back(std::move(entry));
+        }
+        return ec ? (ec.value() == 0 ? 1 : ec.value()) : 0;
+    }
+#endif
+}
+
+std::unique_ptr<DirectoryWalker::Node> DirectoryWalker::walk(const std::string& root, const Options& options,
+                                                              const std::function<void(Node&, std::vector<Entry>&)>& visit,
+                                                              Stats& stats, std::string& error) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Entry> rootEntries;
+    int rootError = readDirectory(root, options.stat, rootEntries);
+    if (rootError != 0) {
+        error = std::generic_category().message(rootError);
+        return nullptr;
+    }
+
+    std::unique_ptr<Node> top(new Node);
+    top->path = root;
+    top->name = root;
+    stats.threads = options.threads == 0 ? ThreadPool::hardwareThreads() : options.threads;
+
+    std::atomic<uint64_t> directories{ 0 }, entryCount{ 0 }, errors{ 0 };
+    std::atomic<bool> cancelled{ false };
+    const std::atomic<bool>* cancel = Cancellation::flag();
+    WorkStealingPool pool(stats.threads);
+
+    // Files the directory, queues its subdirectories, then hands it to the caller.
+    std::function<void(Node&, std::vector<Entry>&)> finish;
+    std::function<void(Node*)> read = [&](Node* node) {
+        Cancellation::Scope scope(cancel);
+        if (Cancellation::requested()) {
+            cancelled = true;
+            return;
+        }
+        std::vector<Entry> entries;
+        int readError = readDirectory(node->path, options.stat, entries);
+        if (readError != 0) {
+            node->unreadable = true;
+            errors++;
+            std::cerr << "Cannot read '" << node->path << "': " << std::generic_category().message(readError) << "\n";
+        }
+        finish(*node, entries);
+    };
+    finish = [&](Node& node, std::vector<Entry>& entries) {
+        directories++;
+        entryCount += entries.size();
+        if (node.depth < options.maxDepth) {
+            for (const Entry& entry : entries) {
+                if (entry.type != Type::Directory || (!options.hidden && entry.name[0] == '.')) continue;
+                std::unique_ptr<Node> child(new Node);
+                child->name = entry.name;
+                child->path = childPath(node.path, entry.name);
+                child->depth = node.depth + 1;
+                Node* raw = child.get();
+                node.subdirectories.push_back(std::move(child));
+                pool.submit([&read, raw] { read(raw); });
+            }
+        }
+        visit(node, entries);
+    };
+
+    finish(*top, rootEntries);
+    pool.wait();
+
+    stats.directories = directories;
+    stats.entries = entryCount;
+    stats.errors = errors;
+    stats.cancelled = cancelled;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return top;
+}
+
+void DirectoryWalker::sort(Node& node) {
+    std::sort(node.subdirectories.begin(), node.subdirectories.end(),
+              [](const std::unique_ptr<Node>& a, const std::unique_ptr<Node>& b) { return a->name < b->name; });
+    std::sort(node.kept.begin(), node.kept.end(), [](const Entry& a, const Entry& b) { return a.name < b.name; });
+    for (auto& child : node.subdirectories) sort(*child);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <climits>
+
+// Walks a directory tree on several threads: every directory is a task on a
+// WorkStealingPool, so wide and deep parts of the tree spread across the threads.
+// On Linux a directory is read with getdents64 into a large buffer, and entry types
+// come from the directory itself; sizes and times, when asked for, come from statx
+// relative to the open directory, all issued back to back by the thread that read it.
+// Elsewhere std::filesystem does the reading. Symbolic links are reported, not followed.
+class DirectoryWalker {
+public:
+    enum class Type { File, Directory, Symlink, Other };
+
+    struct Entry {
+        std::string name;
+        Type type;
+        uint64_t size = 0;  // bytes; filled with Options::stat
+        int64_t mtime = 0;  // seconds since 1970; filled with Options::stat
+    };
+
+    // One directory of the walk. The walker fills in where it is and what lies below it;
+    // the totals and `kept` are for the caller's visit function.
+    struct Node {
+        std::string path;
+        std::string name;
+        unsigned depth = 0;
+        std::vector<std::unique_ptr<Node>> subdirectories; // in no particular order; see sort()
+        bool unreadable = false;
+
+        uint64_t bytes = 0;
+        uint64_t files = 0;
+        std::vector<Entry> kept;
+    };
+
+    struct Options {
+        unsigned threads = 0;           // 0: one per CPU
+        bool stat = false;              // fill in Entry::size and Entry::mtime
+        unsigned maxDepth = UINT_MAX;   // directories below this depth (the root is 0) are not read
+        bool hidden = true;             // false: directories whose names start with '.' are not read
+    };
+
+    struct Stats {
+        uint64_t directories = 0;
+        uint64_t entries = 0;
+        uint64_t errors = 0;
+        bool cancelled = false;
+        double seconds = 0;
+        unsigned threads = 0;
+    };
+
+    // Walks `root`, calling visit(node, entries) once for every directory read, on any of
+    // the walk's threads and possibly at the same time as for other directories. The
+    // entries exclude "." and "..". Returns nullptr, with `error` set, if `root` is not a
+    // readable directory; directories below it that cannot be read are reported on
+    // std::cerr, marked unreadable and counted in stats.errors.
+    static std::unique_ptr<Node> walk(const std::string& root, const Options& options,
+                                      const std::function<void(Node&, std::vector<Entry>&)>& visit, Stats& stats,
+                                      std::string& error);
+
+    // Sorts subdirectories and kept entries by name, all the way down.
+    static void sort(Node& node);
+};
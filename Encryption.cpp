@@ -1,283 +1,635 @@
 #include "Encryption.h"
+#include "MappedFile.h"
+#include "CipherKernels.h"
+#include "ThreadPool.h"
+#include "ChaCha20.h"
+#include "Sha256.h"
+#include "Cancellation.h"
 #include <fstream>
+#include <filesystem>
 #include <iostream>
 #include <cctype>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <limits>
 #include <stdexcept> 
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <random>
+
+namespace {
+    // Chunk size of the streaming ciphers: memory use is one chunk whatever the file size.
+    const size_t CHUNK_SIZE = 1 << 20; // 1 MiB
+
+    // Letters are ASCII letters only, whatever the locale, as std::isalpha sees them
+    // in the default "C" locale the program runs in.
+    constexpr bool isAsciiLetter(unsigned c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+
+    // SHIFT_TABLES.table[s][c] is byte c rotated s places through its alphabet, with
+    // case kept and every other byte unchanged. Built at compile time; Caesar uses
+    // one table, Vigenere one per key letter.
+    struct ShiftTables {
+        unsigned char table[26][256];
+    };
+
+    constexpr ShiftTables makeShiftTables() {
+        ShiftTables tables{};
+        for (unsigned shift = 0; shift < 26; ++shift) {
+            for (unsigned c = 0; c < 256; ++c) {
+                unsigned value = c;
+                if (c >= 'a' && c <= 'z') value = (c - 'a' + shift) % 26 + 'a';
+                else if (c >= 'A' && c <= 'Z') value = (c - 'A' + shift) % 26 + 'A';
+                tables.table[shift][c] = (unsigned char)value;
+            }
+        }
+        return tables;
+    }
 
-std::string Encryption::readFile(const std::string& filename) {
-    std::ifstream in(filename);
-    if (!in) return "";
+    constexpr ShiftTables SHIFT_TABLES = makeShiftTables();
+
+    struct LetterTable {
+        unsigned char isLetter[256];
+    };
+
+    constexpr LetterTable makeLetterTable() {
+        LetterTable letters{};
+        for (unsigned c = 0; c < 256; ++c) letters.isLetter[c] = isAsciiLetter(c) ? 1 : 0;
+        return letters;
+    }
+
+    constexpr LetterTable LETTERS = makeLetterTable();
+
+    static_assert(SHIFT_TABLES.table[3]['x'] == 'a' && SHIFT_TABLES.table[25]['A'] == 'Z' &&
+                  SHIFT_TABLES.table[7]['!'] == '!', "shift tables");
+
+    // ChaCha20 files start with
+    //
+    //   magic         4 bytes   0x89 'F' 'M' 'C'
+    //   version       1 byte    1
+    //   iterations    4 bytes   PBKDF2 iteration count, little-endian
+    //   salt         16 bytes   random, new for every file
+    //   check         4 bytes   recognises a wrong key before anything is written
+    //
+    // followed by the ciphertext. PBKDF2-HMAC-SHA256(user key, salt, iterations) gives
+    // 48 bytes: the ChaCha20 key, the nonce and the check value. With a fresh salt
+    // every file gets its own key and nonce, so reusing a user key never reuses a
+    // keystream. There is no authentication tag: tampering is not detected.
+    const unsigned char CHACHA_MAGIC[4] = { 0x89, 'F', 'M', 'C' };
+    const unsigned char CHACHA_VERSION = 1;
+    const uint32_t CHACHA_ITERATIONS = 100000;
+    // Room for files written with a stronger setting later; a larger count in a header
+    // is damage, and would keep the key derivation busy for hours before saying so.
+    const uint32_t CHACHA_MAX_ITERATIONS = CHACHA_ITERATIONS * 10;
+    const size_t CHACHA_SALT_SIZE = 16;
+    const size_t CHACHA_CHECK_SIZE = 4;
+    const size_t CHACHA_HEADER_SIZE = sizeof(CHACHA_MAGIC) + 1 + 4 + CHACHA_SALT_SIZE + CHACHA_CHECK_SIZE;
+
+    struct ChaChaSecrets {
+        unsigned char key[ChaCha20::KEY_SIZE];
+        unsigned char nonce[ChaCha20::NONCE_SIZE];
+        unsigned char check[CHACHA_CHECK_SIZE];
+    };
+
+    ChaChaSecrets deriveSecrets(const std::string& key, const unsigned char* salt, uint32_t iterations) {
+        unsigned char derived[sizeof(ChaChaSecrets)];
+        Sha256::pbkdf2(key, salt, CHACHA_SALT_SIZE, iterations, derived, sizeof(derived));
+        ChaChaSecrets secrets;
+        std::memcpy(secrets.key, derived, sizeof(secrets.key));
+        std::memcpy(secrets.nonce, derived + sizeof(secrets.key), sizeof(secrets.nonce));
+        std::memcpy(secrets.check, derived + sizeof(secrets.key) + sizeof(secrets.nonce), sizeof(secrets.check));
+        return secrets;
+    }
 
-    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    bool chachaSelfTest() {
+        return ChaCha20::selfTest() && Sha256::selfTest();
+    }
+
+    // Algorithm names are case-insensitive everywhere.
+    std::string lowerCase(const std::string& name) {
+        std::string lower = name;
+        for (auto& c : lower) c = (char)std::tolower((unsigned char)c);
+        return lower;
+    }
 }
 
+// Input files are mapped rather than read (see MappedFile). Both sides use binary mode
+// so every byte, including '\r' and 0x1A on Windows, round-trips unchanged.
 void Encryption::writeFile(const std::string& filename, const std::string& content) {
-    std::ofstream out(filename);
+    std::ofstream out(filename, std::ios::binary);
     if (!out) {
         std::cerr << "Error writing to file: " << filename << "\n";
         return; // Return void on failure
     }
-    out << content;
+    out.write(content.data(), (std::streamsize)content.size());
 }
 
-// --- Caesar Cipher ---
-std::string Encryption::caesarEncrypt(const std::string& text, int shift) {
-    std::string result = "";
-    shift = shift % 26;
-    if (shift < 0) shift += 26;
-    for (char ch : text) {
-        if (std::isalpha(ch)) {
-            if (std::islower(ch)) {
-                result += (char)(((ch - 'a' + shift) % 26) + 'a');
-            }
-            else {
-                result += (char)(((ch - 'A' + shift) % 26) + 'A');
-            }
+bool Encryption::streamFile(MappedFile& input, const std::string& filename, const ChunkCipher& cipher, unsigned threads,
+                            size_t inputStart, const std::string& header) {
+    const char* data = input.data() + inputStart;
+    const size_t inputSize = input.size() - inputStart;
+    if (inputSize > cipher.maxStream) {
+        std::cerr << "Error: File is too large for one key stream of this cipher.\n";
+        return false;
+    }
+
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        std::cerr << "Error writing to file: " << filename << "\n";
+        return false;
+    }
+    out.write(header.data(), (std::streamsize)header.size());
+
+    if (threads == 0) threads = 1;
+    ThreadPool pool(threads - 1);
+
+    // Chunks go in batches of two per thread: each is copied out of the mapping into
+    // its own buffer, the batch goes through the cipher together, and the input pages
+    // are released once the batch is written.
+    const size_t chunkCount = (inputSize + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    const size_t batchSize = std::min((size_t)threads * 2, chunkCount);
+    std::vector<std::vector<char>> buffers(batchSize);
+    std::vector<Piece> pieces;
+    uint64_t position = 0;
+
+    for (size_t first = 0; first < chunkCount; first += batchSize) {
+        if (Cancellation::requested()) {
+            out.close();
+            std::error_code ec;
+            std::filesystem::remove(filename, ec);
+            std::cerr << "Cancelled; the partial output '" << filename << "' was removed.\n";
+            return false;
         }
-        else {
-            result += ch;
+        size_t count = std::min(batchSize, chunkCount - first);
+        size_t batchStart = first * CHUNK_SIZE;
+        size_t batchEnd = std::min(inputSize, (first + count) * CHUNK_SIZE);
+
+        pool.parallelFor(count, [&](size_t i) {
+            size_t offset = batchStart + i * CHUNK_SIZE;
+            size_t n = std::min(CHUNK_SIZE, inputSize - offset);
+            buffers[i].resize(n);
+            std::memcpy(buffers[i].data(), data + offset, n);
+        });
+
+        pieces.clear();
+        for (size_t i = 0; i < count; ++i) pieces.push_back({ buffers[i].data(), buffers[i].size() });
+        position = applyPieces(pool, cipher, pieces, position);
+
+        for (size_t i = 0; i < count; ++i) {
+            out.write(buffers[i].data(), (std::streamsize)buffers[i].size());
         }
+        input.release(inputStart + batchStart, batchEnd - batchStart);
     }
-    return result;
+
+    out.close();
+    if (!out) {
+        std::cerr << "Error writing to file: " << filename << "\n";
+        return false;
+    }
+    return true;
 }
 
-std::string Encryption::caesarDecrypt(const std::string& text, int shift) {
+// --- Stream ciphers ---
+// Caesar, XOR and Vigenere keep no header; their key checks are shared by both directions.
+EngineStatus Encryption::classicCipher(const std::string& algo, const std::string& key, bool decrypt, ChunkCipher& cipher) {
+    if (algo == "caesar") {
+        // Validate key for Caesar: must be an integer
+        try {
+            size_t pos;
+            int shift = std::stoi(key, &pos);
+            if (pos != key.size()) return EngineStatus::InvalidKey; // not all of the key is the number
+            // Decrypting is encrypting with the inverse shift
+            if (decrypt) shift = 26 - (shift % 26);
+            cipher.apply = [shift](char* data, size_t n, uint64_t) { caesarApply(data, n, shift); };
+        }
+        catch (const std::logic_error&) {
+            // std::invalid_argument or std::out_of_range
+            return EngineStatus::InvalidKey;
+        }
+    }
+    else if (algo == "xor") {
+        // XOR key can be any string, but empty key is handled
+        if (key.empty()) return EngineStatus::InvalidKey;
+        size_t period;
+        std::string pattern = xorPattern(key, period);
+        cipher.advance = [](const char*, size_t n) { return (uint64_t)n; };
+        cipher.apply = [pattern, period](char* data, size_t n, uint64_t position) {
+            xorApply(data, n, pattern, period, (size_t)(position % period));
+        };
+    }
+    else if (algo == "vigenere") {
+        // Validate key for Vigenere: must contain at least one alphabetic character
+        bool has_alpha = false;
+        for (char c : key) {
+            if (std::isalpha(c)) {
+                has_alpha = true;
+                break;
+            }
+        }
+        if (key.empty() || !has_alpha) return EngineStatus::InvalidKey;
+        cipher.advance = [](const char* data, size_t n) { return (uint64_t)CipherKernels::countLetters(data, n); };
+        cipher.apply = [tables = vigenereKey(key, decrypt)](char* data, size_t n, uint64_t position) {
+            vigenereApply(data, n, tables, (size_t)(position % tables.size()));
+        };
+    }
+    else {
+        return EngineStatus::UnknownAlgorithm;
+    }
+    return EngineStatus::Ok;
+}
+
+EngineStatus Encryption::createEncryptor(const std::string& algorithm, const std::string& key, std::string& header,
+                                         ChunkCipher& cipher) {
+    header.clear();
+    if (algorithm != "chacha20") return classicCipher(algorithm, key, false, cipher);
+    if (key.empty()) return EngineStatus::InvalidKey;
+    return chachaEncryptHeader(key, header, cipher);
+}
+
+EngineStatus Encryption::createDecryptor(const std::string& algorithm, const std::string& key, std::string_view header,
+                                         ChunkCipher& cipher) {
+    if (algorithm != "chacha20") return classicCipher(algorithm, key, true, cipher);
+    if (key.empty()) return EngineStatus::InvalidKey;
+    return chachaDecryptHeader(header, key, cipher);
+}
+
+size_t Encryption::cipherHeaderSize(const std::string& algorithm) {
+    return algorithm == "chacha20" ? CHACHA_HEADER_SIZE : 0;
+}
+
+const char* Encryption::keyRule(const std::string& algorithm) {
+    if (algorithm == "caesar") return "must be an integer";
+    if (algorithm == "railfence") return "must be an integer greater than 1";
+    if (algorithm == "vigenere") return "must contain at least one letter";
+    return "cannot be empty";
+}
+
+void Encryption::reportError(const std::string& algorithm, EngineStatus status) {
+    if (status == EngineStatus::InvalidKey) {
+        std::cerr << "Error: Invalid key for the " << algorithm << " cipher; the key " << keyRule(algorithm) << ".\n";
+    }
+    else if (status == EngineStatus::UnknownAlgorithm) {
+        std::cerr << "Error: Unknown encryption algorithm '" << algorithm << "'.\n";
+    }
+    else {
+        std::cerr << "Error (" << algorithm << "): " << describe(status) << ".\n";
+    }
+}
+
+uint64_t Encryption::applyPieces(ThreadPool& pool, const ChunkCipher& cipher, const std::vector<Piece>& pieces, uint64_t position) {
+    // The first pass measures how far each piece moves the key; a prefix sum of those
+    // gives every piece its starting position, so the second pass transforms all of
+    // them at once. The output is the same as one sequential pass.
+    std::vector<uint64_t> positions(pieces.size(), 0);
+    if (cipher.advance) {
+        pool.parallelFor(pieces.size(), [&](size_t i) {
+            positions[i] = cipher.advance(pieces[i].data, pieces[i].n);
+        });
+    }
+    for (size_t i = 0; i < pieces.size(); ++i) {
+        uint64_t advance = positions[i];
+        positions[i] = position;
+        position += advance;
+    }
+    pool.parallelFor(pieces.size(), [&](size_t i) {
+        cipher.apply(pieces[i].data, pieces[i].n, positions[i]);
+    });
+    return position;
+}
+
+// --- Caesar Cipher ---
+void Encryption::caesarApply(char* data, size_t n, int shift) {
     shift = shift % 26;
     if (shift < 0) shift += 26;
-    return caesarEncrypt(text, 26 - shift); // Decrypting is encrypting with inverse shift
+    // Letters all sit in 0x40-0x7F, the only part of the table the kernel looks at.
+    CipherKernels::translateLetters(data, n, SHIFT_TABLES.table[shift] + 0x40);
 }
 
 // --- XOR Cipher ---
-std::string Encryption::xorCipher(const std::string& text, const std::string& key) {
-    std::string result = text;
-    // Basic XOR, key can be any characters
-    if (key.empty()) return text; // Return original text if key is empty
+std::string Encryption::xorPattern(const std::string& key, size_t& period) {
+    // The shortest whole number of key repetitions that fills a vector, so the kernel
+    // never splits a key copy across a wrap; then one vector's worth more, so loads
+    // that start near the end of the period need no wrap at all.
+    size_t copies = (CipherKernels::MAX_VECTOR + key.size() - 1) / key.size();
+    period = copies * key.size();
+    std::string pattern;
+    pattern.reserve(period + CipherKernels::MAX_VECTOR);
+    while (pattern.size() < period + CipherKernels::MAX_VECTOR) pattern += key;
+    return pattern;
+}
 
-    for (size_t i = 0; i < text.size(); ++i) {
-        result[i] ^= key[i % key.size()];
-    }
-    return result;
+void Encryption::xorApply(char* data, size_t n, const std::string& pattern, size_t period, size_t offset) {
+    CipherKernels::xorRepeating(data, n, (const unsigned char*)pattern.data(), period, offset);
 }
 
 // --- Vigenere Cipher ---
-std::string Encryption::vigenereEncrypt(const std::string& text, const std::string& key) {
-    std::string result = "";
-    std::string clean_key = "";
-    // Clean key: keep only alphabetic characters and convert to lowercase
+Encryption::VigenereKey Encryption::vigenereKey(const std::string& key, bool decrypt) {
+    // Keep only alphabetic characters; each selects the shift table for its position
+    VigenereKey tables;
     for (char k : key) {
-        if (std::isalpha(k)) {
-            clean_key += std::tolower(k);
-        }
+        unsigned char c = (unsigned char)k;
+        if (!isAsciiLetter(c)) continue;
+        int shift = (c | 0x20) - 'a';
+        tables.push_back(SHIFT_TABLES.table[decrypt ? (26 - shift) % 26 : shift]);
     }
+    return tables;
+}
 
-    if (clean_key.empty()) {
-        // If key is empty or contains no alphabetic chars, return original text
-        return text;
+void Encryption::vigenereApply(char* data, size_t n, const VigenereKey& key, size_t keyIndex) {
+    // Non-letters map to themselves in every table, so every byte goes through the
+    // current key letter's table and only letters move the key on: no branches.
+    const unsigned char* const* tables = key.data();
+    size_t length = key.size();
+    for (size_t i = 0; i < n; ++i) {
+        unsigned char c = (unsigned char)data[i];
+        data[i] = (char)tables[keyIndex][c];
+        keyIndex += LETTERS.isLetter[c];
+        if (keyIndex == length) keyIndex = 0;
     }
+}
 
-    size_t key_index = 0;
-    for (char ch : text) {
-        if (std::isalpha(ch)) {
-            char key_char = clean_key[key_index % clean_key.length()];
-            int shift = key_char - 'a';
+// --- ChaCha20 ---
+EngineStatus Encryption::chachaEncryptHeader(const std::string& key, std::string& header, ChunkCipher& cipher) {
+    if (!chachaSelfTest()) return EngineStatus::SelfTestFailed;
 
-            if (std::islower(ch)) {
-                result += (char)(((ch - 'a' + shift) % 26) + 'a');
-            }
-            else {
-                result += (char)(((ch - 'A' + shift) % 26) + 'A');
-            }
-            key_index++; // Move to the next key character only for alphabetic text characters
-        }
-        else {
-            result += ch; // Keep non-alphabetic characters as they are
-        }
+    unsigned char salt[CHACHA_SALT_SIZE];
+    std::random_device random;
+    for (size_t i = 0; i < sizeof(salt); i += 4) {
+        uint32_t value = random();
+        std::memcpy(salt + i, &value, 4);
     }
-    return result;
+    ChaChaSecrets secrets = deriveSecrets(key, salt, CHACHA_ITERATIONS);
+
+    header.assign((const char*)CHACHA_MAGIC, sizeof(CHACHA_MAGIC));
+    header.push_back((char)CHACHA_VERSION);
+    for (int i = 0; i < 4; ++i) header.push_back((char)(CHACHA_ITERATIONS >> (8 * i)));
+    header.append((const char*)salt, sizeof(salt));
+    header.append((const char*)secrets.check, sizeof(secrets.check));
+
+    cipher.advance = [](const char*, size_t n) { return (uint64_t)n; };
+    cipher.apply = [secrets](char* data, size_t n, uint64_t position) {
+        ChaCha20::apply(data, n, secrets.key, secrets.nonce, position);
+    };
+    cipher.maxStream = ChaCha20::MAX_STREAM;
+    return EngineStatus::Ok;
 }
 
-std::string Encryption::vigenereDecrypt(const std::string& text, const std::string& key) {
-    std::string result = "";
-    std::string clean_key = "";
-    // Clean key: keep only alphabetic characters and convert to lowercase
-    for (char k : key) {
-        if (std::isalpha(k)) {
-            clean_key += std::tolower(k);
+EngineStatus Encryption::chachaDecryptHeader(std::string_view bytes, const std::string& key, ChunkCipher& cipher) {
+    if (!chachaSelfTest()) return EngineStatus::SelfTestFailed;
+
+    const unsigned char* header = (const unsigned char*)bytes.data();
+    if (bytes.size() < CHACHA_HEADER_SIZE) return EngineStatus::Truncated;
+    if (std::memcmp(header, CHACHA_MAGIC, sizeof(CHACHA_MAGIC)) != 0) return EngineStatus::Corrupted;
+    if (header[sizeof(CHACHA_MAGIC)] != CHACHA_VERSION) return EngineStatus::UnsupportedVersion;
+    const unsigned char* p = header + sizeof(CHACHA_MAGIC) + 1;
+    uint32_t iterations = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+    const unsigned char* salt = p + 4;
+    const unsigned char* check = salt + CHACHA_SALT_SIZE;
+    if (iterations == 0 || iterations > CHACHA_MAX_ITERATIONS) return EngineStatus::Corrupted;
+
+    ChaChaSecrets secrets = deriveSecrets(key, salt, iterations);
+    if (std::memcmp(secrets.check, check, CHACHA_CHECK_SIZE) != 0) return EngineStatus::WrongKey;
+
+    cipher.advance = [](const char*, size_t n) { return (uint64_t)n; };
+    cipher.apply = [secrets](char* data, size_t n, uint64_t position) {
+        ChaCha20::apply(data, n, secrets.key, secrets.nonce, position);
+    };
+    cipher.maxStream = ChaCha20::MAX_STREAM;
+    return EngineStatus::Ok;
+}
+
+// --- Rail Fence Cipher ---
+// Text position i lies on rail i % cycle on the way down and cycle - i % cycle on
+// the way up, with cycle = 2 * (rails - 1). The ciphertext is rail 0, then rail 1,
+// and so on, so where a byte goes follows from its position alone: no fence is
+// built. Each task handles some rails over a stretch of whole cycles and writes
+// straight into the one output buffer.
+namespace {
+    // Whole cycles per task: a stretch small enough to stay in cache while every rail
+    // in it is walked, but at least enough cycles that each rail writes whole cache
+    // lines rather than a byte or two (long cycles mean many rails).
+    const size_t RAIL_SEGMENT_SIZE = 256 << 10; // 256 KiB
+    const size_t MIN_SEGMENT_CYCLES = 64;
+
+    struct RailFenceLayout {
+        size_t n;
+        size_t rails;
+        size_t cycle;
+
+        // Bytes per whole cycle on `rail`: one on the top and bottom rails, two between.
+        size_t perCycle(size_t rail) const {
+            return (rail == 0 || rail == rails - 1) ? 1 : 2;
         }
-    }
-    if (clean_key.empty()) {
-        // If key is empty or contains no alphabetic chars, return original text
-        return text;
-    }
-    size_t key_index = 0;
-    for (char ch : text) {
-        if (std::isalpha(ch)) {
-            char key_char = clean_key[key_index % clean_key.length()];
-            int shift = key_char - 'a';
 
-            if (std::islower(ch)) {
-                result += (char)(((ch - 'a' - shift + 26) % 26) + 'a');
-            }
-            else {
-                result += (char)(((ch - 'A' - shift + 26) % 26) + 'A');
+        // Ciphertext offset of `rail`: the number of text positions on rails above it.
+        size_t railStart(size_t rail) const {
+            if (rail == 0) return 0;
+            size_t full = n / cycle;
+            size_t rem = n % cycle;
+            // The trailing part cycle holds offsets 0..rem-1; those below `rail` going down
+            // and those above cycle - rail coming up are on earlier rails.
+            size_t partial = std::min(rem, rail);
+            if (rem > cycle - rail + 1) partial += rem - (cycle - rail + 1);
+            return full * (2 * rail - 1) + partial;
+        }
+    };
+
+    // Moves the bytes of rails [firstRail, lastRail) within cycles [firstCycle,
+    // lastCycle) between text order and rail order.
+    template <bool Decrypt>
+    void railFenceRange(const RailFenceLayout& fence, const char* in, char* out, size_t firstRail, size_t lastRail,
+                        size_t firstCycle, size_t lastCycle) {
+        const size_t n = fence.n;
+        const size_t cycle = fence.cycle;
+        for (size_t rail = firstRail; rail < lastRail; ++rail) {
+            size_t railPos = fence.railStart(rail) + firstCycle * fence.perCycle(rail);
+            bool middle = fence.perCycle(rail) == 2;
+            for (size_t base = firstCycle * cycle; base < lastCycle * cycle; base += cycle) {
+                size_t down = base + rail;
+                if (down >= n) break;
+                if (Decrypt) out[down] = in[railPos++];
+                else out[railPos++] = in[down];
+                if (!middle) continue;
+                size_t up = base + cycle - rail;
+                if (up >= n) break;
+                if (Decrypt) out[up] = in[railPos++];
+                else out[railPos++] = in[up];
             }
-            key_index++; // Move to the next key character only for alphabetic text characters
         }
-        else {
-            result += ch; // Keep non-alphabetic characters as they are
+    }
+
+    template <bool Decrypt>
+    void railFenceTransform(std::string_view text, int rails, char* out, unsigned threads) {
+        // More rails than bytes changes nothing: each byte is alone on its rail.
+        size_t railCount = std::min((size_t)rails, text.size());
+        if (railCount <= 1) {
+            if (!text.empty()) std::memcpy(out, text.data(), text.size());
+            return;
         }
+
+        RailFenceLayout fence{ text.size(), railCount, 2 * (railCount - 1) };
+
+        if (threads == 0) threads = 1;
+        ThreadPool pool(threads - 1);
+
+        // Tasks are stretches of whole cycles. When there are too few stretches to keep
+        // every thread busy (very long cycles), each stretch is also split by rails.
+        size_t cycles = (fence.n + fence.cycle - 1) / fence.cycle;
+        size_t cyclesPerSegment = std::max(MIN_SEGMENT_CYCLES, RAIL_SEGMENT_SIZE / fence.cycle);
+        size_t segments = (cycles + cyclesPerSegment - 1) / cyclesPerSegment;
+        size_t wanted = (size_t)threads * 2;
+        size_t railGroups = segments >= wanted ? 1 : std::min(railCount, (wanted + segments - 1) / segments);
+        size_t railsPerGroup = (railCount + railGroups - 1) / railGroups;
+
+        pool.parallelFor(segments * railGroups, [&](size_t task) {
+            size_t segment = task / railGroups;
+            size_t firstRail = (task % railGroups) * railsPerGroup;
+            size_t lastRail = std::min(railCount, firstRail + railsPerGroup);
+            size_t firstCycle = segment * cyclesPerSegment;
+            size_t lastCycle = std::min(cycles, firstCycle + cyclesPerSegment);
+            railFenceRange<Decrypt>(fence, text.data(), out, firstRail, lastRail, firstCycle, lastCycle);
+        });
     }
-    return result;
 }
 
-// --- Rail Fence Cipher ---
-std::string Encryption::railFenceEncrypt(const std::string& text, int rails) {
-    if (rails <= 1 || text.empty()) return text; // Need at least 2 rails
+EngineStatus Encryption::railFenceRails(const std::string& key, int& rails) {
+    try {
+        size_t pos;
+        rails = std::stoi(key, &pos);
+        if (pos != key.size()) return EngineStatus::InvalidKey; // not all of the key is the number
+    }
+    catch (const std::logic_error&) {
+        // std::invalid_argument or std::out_of_range
+        return EngineStatus::InvalidKey;
+    }
+    return rails > 1 ? EngineStatus::Ok : EngineStatus::InvalidKey;
+}
 
-    std::vector<std::string> fence(rails);
-    int rail = 0;
-    int direction = 1; // 1 for down, -1 for up
+void Encryption::railFenceEncrypt(std::string_view text, int rails, char* out, unsigned threads) {
+    railFenceTransform<false>(text, rails, out, threads);
+}
 
-    for (char ch : text) {
-        fence[rail] += ch;
-        if (rail == 0) direction = 1;
-        else if (rail == rails - 1) direction = -1;
-        rail += direction;
-    }
+void Encryption::railFenceDecrypt(std::string_view text, int rails, char* out, unsigned threads) {
+    railFenceTransform<true>(text, rails, out, threads);
+}
 
-    std::string result = "";
-    for (const auto& row : fence) {
-        result += row;
-    }
-    return result;
+// --- In-memory API ---
+size_t Encryption::encryptBound(const std::string& algorithm, size_t n) {
+    return n + cipherHeaderSize(lowerCase(algorithm));
+}
+
+EngineStatus Encryption::encryptBuffer(const std::string& algorithm, const std::string& key, const char* in, size_t n,
+                                       char* out, size_t capacity, size_t& written, unsigned threads) {
+    return transformBuffer(lowerCase(algorithm), key, false, in, n, out, capacity, written, threads);
+}
+
+EngineStatus Encryption::decryptBuffer(const std::string& algorithm, const std::string& key, const char* in, size_t n,
+                                       char* out, size_t capacity, size_t& written, unsigned threads) {
+    return transformBuffer(lowerCase(algorithm), key, true, in, n, out, capacity, written, threads);
 }
 
-std::string Encryption::railFenceDecrypt(const std::string& text, int rails) {
-    if (rails <= 1 || text.empty()) return text; // Need at least 2 rails
-
-    std::vector<std::string> fence(rails);
-    std::vector<int> rail_lengths(rails, 0);
-    int rail = 0;
-    int direction = 1; // 1 for down, -1 for up
-
-    // Calculate the length of each rail
-    for (char ch : text) {
-        rail_lengths[rail]++;
-        if (rail == 0) direction = 1;
-        else if (rail == rails - 1) direction = -1;
-        rail += direction;
-    }
-
-    // Fill the fence with parts of the text based on calculated lengths
-    size_t current_pos = 0;
-    for (int i = 0; i < rails; ++i) {
-        fence[i] = text.substr(current_pos, rail_lengths[i]);
-        current_pos += rail_lengths[i];
-    }
-
-    // Read the fence zig-zag to get the original text
-    std::string result = "";
-    rail = 0;
-    direction = 1;
-    std::vector<int> rail_indices(rails, 0); // To keep track of current position in each rail's string
-    for (size_t i = 0; i < text.length(); ++i) {
-        result += fence[rail][rail_indices[rail]++];
-        if (rail == 0) direction = 1;
-        else if (rail == rails - 1) direction = -1;
-        rail += direction;
-    }
-    return result;
+EngineStatus Encryption::transformBuffer(const std::string& algo, const std::string& key, bool decrypt, const char* in,
+                                         size_t n, char* out, size_t capacity, size_t& written, unsigned threads) {
+    written = 0;
+    if (threads == 0) threads = 1;
+
+    if (algo == "railfence") {
+        int rails;
+        EngineStatus status = railFenceRails(key, rails);
+        if (status != EngineStatus::Ok) return status;
+        if (capacity < n) return EngineStatus::OutputTooSmall;
+        if (decrypt) railFenceDecrypt(std::string_view(in, n), rails, out, threads);
+        else railFenceEncrypt(std::string_view(in, n), rails, out, threads);
+        written = n;
+        return EngineStatus::Ok;
+    }
+
+    // The cipher's header, if it has one, precedes the ciphertext
+    ChunkCipher cipher;
+    std::string header;
+    const char* text = in;
+    size_t textSize = n;
+    EngineStatus status;
+    if (decrypt) {
+        size_t headerSize = std::min(n, cipherHeaderSize(algo));
+        status = createDecryptor(algo, key, std::string_view(in, headerSize), cipher);
+        text += headerSize;
+        textSize -= headerSize;
+    }
+    else {
+        status = createEncryptor(algo, key, header, cipher);
+    }
+    if (status != EngineStatus::Ok) return status;
+    if (textSize > cipher.maxStream) return EngineStatus::TooLarge;
+    if (capacity < header.size() || capacity - header.size() < textSize) return EngineStatus::OutputTooSmall;
+
+    // As in streamFile, batches of two chunks per thread are copied and then go through
+    // the cipher while they are still in cache. Overlapping buffers are moved in one
+    // go first (and not at all when `out` is `in`), before the header can overwrite them.
+    char* target = out + header.size();
+    bool overlap = out < text + textSize && text < target + textSize;
+    if (overlap && target != text) std::memmove(target, text, textSize);
+    if (!header.empty()) std::memcpy(out, header.data(), header.size());
+
+    ThreadPool pool(threads - 1);
+    const size_t chunkCount = (textSize + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    const size_t batchSize = (size_t)threads * 2;
+    std::vector<Piece> pieces;
+    uint64_t position = 0;
+    for (size_t first = 0; first < chunkCount; first += batchSize) {
+        size_t count = std::min(batchSize, chunkCount - first);
+        pieces.clear();
+        for (size_t i = 0; i < count; ++i) {
+            size_t offset = (first + i) * CHUNK_SIZE;
+            pieces.push_back({ target + offset, std::min(CHUNK_SIZE, textSize - offset) });
+        }
+        if (!overlap) {
+            pool.parallelFor(count, [&](size_t i) {
+                std::memcpy(pieces[i].data, text + (pieces[i].data - target), pieces[i].n);
+            });
+        }
+        position = applyPieces(pool, cipher, pieces, position);
+    }
+    written = header.size() + textSize;
+    return EngineStatus::Ok;
 }
 
 
 // --- Encryption ---
-bool Encryption::encryptFile(const std::string& algorithm, const std::string& filename, const std::string& key) {
+// The file commands use the same key handling and ciphers as the in-memory API. Caesar,
+// XOR, Vigenere and ChaCha20 are streamed a batch of chunks at a time, so memory does
+// not grow with the file; Rail Fence needs the whole text at once.
+bool Encryption::encryptFile(const std::string& algorithm, const std::string& filename, const std::string& key, unsigned threads) {
     std::cout << "Encrypting '" << filename << "' using " << algorithm << " with key '" << key << "'...\n";
 
-    std::string content = readFile(filename);
-    if (content.empty()) {
+    MappedFile input;
+    if (!input.open(filename) || input.size() == 0) {
         std::cerr << "Error: Could not read content from " << filename << ". Encryption failed.\n";
         return false;
     }
+    std::string algo = lowerCase(algorithm);
 
-    std::string result;
-    std::string algo = algorithm;
-    for (auto& c : algo) c = std::tolower(c); // Convert algorithm name to lowercase
+    // Construct output filename: base_name_algorithm.enc
+    size_t last_dot_pos = filename.find_last_of('.');
+    std::string base_name = (last_dot_pos == std::string::npos) ? filename : filename.substr(0, last_dot_pos);
+    std::string outFile = base_name + "_" + algo + ".enc";
 
+    EngineStatus status;
     try {
-        if (algo == "caesar") {
-            // Validate key for Caesar: must be an integer
-            try {
-                size_t pos;
-                int shift = std::stoi(key, &pos);
-                if (pos != key.size()) { // Check if the entire string was consumed by stoi
-                    std::cerr << "Error: Invalid key format for Caesar cipher. Key must be an integer.\n";
-                    return false;
-                }
-                result = caesarEncrypt(content, shift);
-            }
-            catch (const std::invalid_argument) {
-                std::cerr << "Error: Invalid key format for Caesar cipher. Key must be an integer.\n";
-                return false;
-            }
-            catch (const std::out_of_range) {
-                std::cerr << "Error: Key value out of range for Caesar cipher.\n";
-                return false;
-            }
-        }
-        else if (algo == "xor") {
-            // XOR key can be any string, but empty key is handled
-            if (key.empty()) {
-                std::cerr << "Error: Key cannot be empty for XOR cipher.\n";
-                return false;
-            }
-            result = xorCipher(content, key);
-        }
-        else if (algo == "vigenere") {
-            // Validate key for Vigenere: must contain at least one alphabetic character
-            bool has_alpha = false;
-            for (char c : key) {
-                if (std::isalpha(c)) {
-                    has_alpha = true;
-                    break;
-                }
-            }
-            if (key.empty() || !has_alpha) {
-                std::cerr << "Error: Key for Vigenere cipher must contain at least one alphabetic character.\n";
-                return false;
-            }
-            result = vigenereEncrypt(content, key);
-        }
-        else if (algo == "railfence") {
-            // Validate key for Rail Fence: must be an integer > 1
-            try {
-                size_t pos;
-                int rails = std::stoi(key, &pos);
-                if (pos != key.size()) { // Check if the entire string was consumed by stoi
-                    std::cerr << "Error: Invalid key format for Rail Fence cipher. Key must be an integer.\n";
-                    return false;
-                }
-                if (rails <= 1) {
-                    std::cerr << "Error: Invalid key for Rail Fence. Number of rails must be greater than 1.\n";
-                    return false;
-                }
-                result = railFenceEncrypt(content, rails);
-            }
-            catch (const std::invalid_argument) {
-                std::cerr << "Error: Invalid key format for Rail Fence cipher. Key must be an integer.\n";
-                return false;
-            }
-            catch (const std::out_of_range) {
-                std::cerr << "Error: Key value out of range for Rail Fence cipher.\n";
-                return false;
-            }
+        if (algo == "railfence") {
+            std::string result(input.size(), '\0');
+            size_t written;
+            status = encryptBuffer(algo, key, input.data(), input.size(), &result[0], result.size(), written, threads);
+            if (status == EngineStatus::Ok) writeFile(outFile, result);
         }
         else {
-            std::cerr << "Error: Unknown encryption algorithm.\n";
-            return false;
+            ChunkCipher cipher;
+            std::string header;
+            status = createEncryptor(algo, key, header, cipher);
+            if (status == EngineStatus::Ok && !streamFile(input, outFile, cipher, threads, 0, header)) return false;
         }
     }
     catch (const std::exception& e) {
@@ -285,35 +637,25 @@ bool Encryption::encryptFile(const std::string& algorithm, const std::string& fi
         std::cerr << "An unexpected error occurred during encryption: " << e.what() << "\n";
         return false;
     }
-    catch (...) {
-        // Catch any other unknown exceptions
-        std::cerr << "An unknown error occurred during encryption.\n";
+
+    if (status != EngineStatus::Ok) {
+        reportError(algo, status);
         return false;
     }
-
-
-    // Construct output filename: base_name_algorithm.enc
-    size_t last_dot_pos = filename.find_last_of('.');
-    std::string base_name = (last_dot_pos == std::string::npos) ? filename : filename.substr(0, last_dot_pos);
-    std::string outFile = base_name + "_" + algo + ".enc";
-
-    writeFile(outFile, result);
     std::cout << "File encrypted to: " << outFile << "\n";
     return true; // Return true on success
 }
 
 // --- Decryption ---
-bool Encryption::decryptFile(const std::string& algorithm, const std::string& filename, const std::string& key) {
+bool Encryption::decryptFile(const std::string& algorithm, const std::string& filename, const std::string& key, unsigned threads) {
     std::cout << "Decrypting '" << filename << "' using " << algorithm << " with key '" << key << "'...\n";
 
-    std::string content = readFile(filename);
-    if (content.empty()) {
+    MappedFile input;
+    if (!input.open(filename) || input.size() == 0) {
         std::cerr << "Decryption failed: File is empty or unreadable.\n";
         return false;
     }
-
-    std::string algo = algorithm;
-    for (auto& c : algo) c = std::tolower(c); // Convert algorithm name to lowercase
+    std::string algo = lowerCase(algorithm);
 
     // Expected filename suffix based on the algorithm
     std::string expected_suffix = "_" + algo + ".enc";
@@ -325,79 +667,24 @@ bool Encryption::decryptFile(const std::string& algorithm, const std::string& fi
         return false;
     }
 
+    // Construct output filename: remove the algorithm suffix and .enc, then add .dec.txt
+    // Example: file_caesar.enc -> file.dec.txt
+    std::string outFile = filename.substr(0, filename.length() - expected_suffix.length()) + ".dec.txt";
 
-    std::string result;
+    EngineStatus status;
     try {
-        if (algo == "caesar") {
-            // Validate key for Caesar: must be an integer
-            try {
-                size_t pos;
-                int shift = std::stoi(key, &pos);
-                if (pos != key.size()) { // Check if the entire string was consumed by stoi
-                    std::cerr << "Error: Invalid key format for Caesar cipher. Key must be an integer.\n";
-                    return false;
-                }
-                result = caesarDecrypt(content, shift);
-            }
-            catch (const std::invalid_argument) {
-                std::cerr << "Error: Invalid key format for Caesar cipher. Key must be an integer.\n";
-                return false;
-            }
-            catch (const std::out_of_range) {
-                std::cerr << "Error: Key value out of range for Caesar cipher.\n";
-                return false;
-            }
-        }
-        else if (algo == "xor") {
-            // XOR key can be any string, but empty key is handled
-            if (key.empty()) {
-                std::cerr << "Error: Key cannot be empty for XOR cipher.\n";
-                return false;
-            }
-            result = xorCipher(content, key);
-        }
-        else if (algo == "vigenere") {
-            // Validate key for Vigenere: must contain at least one alphabetic character
-            bool has_alpha = false;
-            for (char c : key) {
-                if (std::isalpha(c)) {
-                    has_alpha = true;
-                    break;
-                }
-            }
-            if (key.empty() || !has_alpha) {
-                std::cerr << "Error: Key for Vigenere cipher must contain at least one alphabetic character.\n";
-                return false;
-            }
-            result = vigenereDecrypt(content, key);
-        }
-        else if (algo == "railfence") {
-            // Validate key for Rail Fence: must be an integer > 1
-            try {
-                size_t pos;
-                int rails = std::stoi(key, &pos);
-                if (pos != key.size()) { // Check if the entire string was consumed by stoi
-                    std::cerr << "Error: Invalid key format for Rail Fence cipher. Key must be an integer.\n";
-                    return false;
-                }
-                if (rails <= 1) {
-                    std::cerr << "Error: Invalid key for Rail Fence. Number of rails must be greater than 1.\n";
-                    return false;
-                }
-                result = railFenceDecrypt(content, rails);
-            }
-            catch (const std::invalid_argument) {
-                std::cerr << "Error: Invalid key format for Rail Fence cipher. Key must be an integer.\n";
-                return false;
-            }
-            catch (const std::out_of_range) {
-                std::cerr << "Error: Key value out of range for Rail Fence cipher.\n";
-                return false;
-            }
+        if (algo == "railfence") {
+            std::string result(input.size(), '\0');
+            size_t written;
+            status = decryptBuffer(algo, key, input.data(), input.size(), &result[0], result.size(), written, threads);
+            if (status == EngineStatus::Ok) writeFile(outFile, result);
         }
         else {
-            std::cerr << "Internal Error: Unknown decryption algorithm.\n"; // Should not happen if encrypt works
-            return false;
+            // The cipher's header, if it has one, precedes the ciphertext
+            ChunkCipher cipher;
+            size_t inputStart = std::min(input.size(), cipherHeaderSize(algo));
+            status = createDecryptor(algo, key, std::string_view(input.data(), inputStart), cipher);
+            if (status == EngineStatus::Ok && !streamFile(input, outFile, cipher, threads, inputStart)) return false;
         }
     }
     catch (const std::exception& e) {
@@ -405,21 +692,11 @@ bool Encryption::decryptFile(const std::string& algorithm, const std::string& fi
         std::cerr << "An unexpected error occurred during decryption: " << e.what() << "\n";
         return false;
     }
-    catch (...) {
-        // Catch any other unknown exceptions
-        std::cerr << "An unknown error occurred during decryption.\n";
+
+    if (status != EngineStatus::Ok) {
+        reportError(algo, status);
         return false;
     }
-
-
-    // Construct output filename: remove the algorithm suffix and .enc, then add .dec.txt
-    // Example: file_caesar.enc -> file.dec.txt
-    size_t suffix_pos = filename.rfind("_" + algo + ".enc");
-    std::string base_name = filename.substr(0, suffix_pos);
-    std::string outFile = base_name + ".dec.txt";
-
-    writeFile(outFile, result);
     std::cout << "File decrypted successfully to: " << outFile << "\n";
     return true; // Return true on success
 }
-
@@ -1,27 +1,104 @@
 #pragma once
+#include "EngineStatus.h"
 #include <string>
+#include <string_view>
 #include <vector>
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+class MappedFile;
+class ThreadPool;
+
 class Encryption {
 public:
-    static bool encryptFile(const std::string& algorithm, const std::string& filename, const std::string& key);
-    static bool decryptFile(const std::string& algorithm, const std::string& filename, const std::string& key);
+    // `threads` chunks (rail ranges for Rail Fence) are transformed concurrently.
+    static bool encryptFile(const std::string& algorithm, const std::string& filename, const std::string& key, unsigned threads = 1);
+    static bool decryptFile(const std::string& algorithm, const std::string& filename, const std::string& key, unsigned threads = 1);
+
+    // A streaming cipher: apply rewrites data[0, n) in place given the key position of
+    // data[0]; advance returns how far a chunk moves the key position on. Positions are
+    // worked out for a whole batch of chunks first, so the chunks can then be
+    // transformed independently. An empty advance means the cipher has no position.
+    // maxStream is the most bytes one key may transform.
+    struct ChunkCipher {
+        std::function<uint64_t(const char* data, size_t n)> advance;
+        std::function<void(char* data, size_t n, uint64_t position)> apply;
+        uint64_t maxStream = UINT64_MAX;
+    };
+
+    // Stream ciphers (every algorithm except Rail Fence) for callers that bring their
+    // own buffers. createEncryptor sets `header` to the bytes that must precede the
+    // ciphertext (empty for all but ChaCha20); createDecryptor takes those bytes back,
+    // cipherHeaderSize(algorithm) of them. Neither prints anything; reportError()
+    // explains a failure on std::cerr.
+    static EngineStatus createEncryptor(const std::string& algorithm, const std::string& key, std::string& header,
+                                        ChunkCipher& cipher);
+    static EngineStatus createDecryptor(const std::string& algorithm, const std::string& key, std::string_view header,
+                                        ChunkCipher& cipher);
+    static size_t cipherHeaderSize(const std::string& algorithm);
+
+    // What a key for `algorithm` has to look like ("must be an integer", ...).
+    static const char* keyRule(const std::string& algorithm);
+    static void reportError(const std::string& algorithm, EngineStatus status);
+
+    // Runs consecutive pieces of one stream, starting at key position `position`,
+    // through the cipher on `pool`. Returns the position after the last piece.
+    struct Piece {
+        char* data;
+        size_t n;
+    };
+    static uint64_t applyPieces(ThreadPool& pool, const ChunkCipher& cipher, const std::vector<Piece>& pieces, uint64_t position);
+
+    // --- In-memory API ---
+    // Every algorithm on buffers the caller owns: no files, nothing printed. The result
+    // goes to out[0, capacity) and `written` is set to its size on success. For all but
+    // Rail Fence, `out` may be `in` itself (encrypting in place; ChaCha20 then needs
+    // room for its header, which goes in front); otherwise the buffers must not overlap.
+    // Decrypted output is never longer than the input.
+    static size_t encryptBound(const std::string& algorithm, size_t n);
+    static EngineStatus encryptBuffer(const std::string& algorithm, const std::string& key, const char* in, size_t n,
+                                      char* out, size_t capacity, size_t& written, unsigned threads = 1);
+    static EngineStatus decryptBuffer(const std::string& algorithm, const std::string& key, const char* in, size_t n,
+                                      char* out, size_t capacity, size_t& written, unsigned threads = 1);
 
 private:
-    static std::string readFile(const std::string& filename);
     static void writeFile(const std::string& filename, const std::string& content);
 
+    // Writes `header`, then input from byte `inputStart` on through the cipher.
+    static bool streamFile(MappedFile& input, const std::string& filename, const ChunkCipher& cipher, unsigned threads,
+                           size_t inputStart = 0, const std::string& header = std::string());
+
+    // The work behind encryptBuffer and decryptBuffer.
+    static EngineStatus transformBuffer(const std::string& algorithm, const std::string& key, bool decrypt, const char* in,
+                                        size_t n, char* out, size_t capacity, size_t& written, unsigned threads);
+
+    static EngineStatus classicCipher(const std::string& algo, const std::string& key, bool decrypt, ChunkCipher& cipher);
+
     // Caesar Cipher
-    static std::string caesarEncrypt(const std::string& text, int shift);
-    static std::string caesarDecrypt(const std::string& text, int shift);
+    static void caesarApply(char* data, size_t n, int shift);
+
+    // XOR Cipher; the key is expanded once into a repeating pattern of `period` bytes.
+    // offset is the pattern position of data[0]
+    static std::string xorPattern(const std::string& key, size_t& period);
+    static void xorApply(char* data, size_t n, const std::string& pattern, size_t period, size_t offset);
 
-    // XOR Cipher
-    static std::string xorCipher(const std::string& text, const std::string& key);
+    // Vigenre Cipher; the key becomes one shift table per key letter (inverse shifts
+    // for decryption). keyIndex is the number of letters before data[0], modulo the key length
+    typedef std::vector<const unsigned char*> VigenereKey;
+    static VigenereKey vigenereKey(const std::string& key, bool decrypt);
+    static void vigenereApply(char* data, size_t n, const VigenereKey& key, size_t keyIndex);
 
-    // Vigenre Cipher
-    static std::string vigenereEncrypt(const std::string& text, const std::string& key);
-    static std::string vigenereDecrypt(const std::string& text, const std::string& key);
+    // ChaCha20; the key and nonce are derived from the user key and a random salt kept
+    // in a file header (layout in Encryption.cpp). chachaEncryptHeader builds a new
+    // header; chachaDecryptHeader checks the one at the start of `bytes` and the key.
+    static EngineStatus chachaEncryptHeader(const std::string& key, std::string& header, ChunkCipher& cipher);
+    static EngineStatus chachaDecryptHeader(std::string_view bytes, const std::string& key, ChunkCipher& cipher);
 
-    // Rail Fence Cipher
-    static std::string railFenceEncrypt(const std::string& text, int rails);
-    static std::string railFenceDecrypt(const std::string& text, int rails);
+    // Rail Fence Cipher; every byte's place is computed in closed form and written
+    // into `out` (text.size() bytes, not overlapping the text), so memory is the text
+    // plus the result. railFenceRails parses the key: an integer greater than 1
+    static EngineStatus railFenceRails(const std::string& key, int& rails);
+    static void railFenceEncrypt(std::string_view text, int rails, char* out, unsigned threads);
+    static void railFenceDecrypt(std::string_view text, int rails, char* out, unsigned threads);
 };
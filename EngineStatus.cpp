@@ -0,0 +1,19 @@
+#include "EngineStatus.h"
+
+const char* describe(EngineStatus status) {
+    switch (status) {
+    case EngineStatus::Ok: return "success";
+    case EngineStatus::OutputTooSmall: return "the output buffer is too small";
+    case EngineStatus::UnknownCodec: return "unknown compression codec";
+    case EngineStatus::UnknownAlgorithm: return "unknown encryption algorithm";
+    case EngineStatus::InvalidKey: return "invalid key for this algorithm";
+    case EngineStatus::WrongKey: return "wrong key";
+    case EngineStatus::Truncated: return "the data is truncated";
+    case EngineStatus::Corrupted: return "the data is corrupted";
+    case EngineStatus::UnsupportedVersion: return "unsupported format version";
+    case EngineStatus::TooLarge: return "too much data for one key stream of this cipher";
+    case EngineStatus::SelfTestFailed: return "the cipher failed its self-test and is disabled";
+    case EngineStatus::Cancelled: return "cancelled";
+    }
+    return "unknown error";
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+// Outcome of the in-memory engine calls (Compression::compressBuffer, Encryption::
+// encryptBuffer and the rest). They do no I/O and print nothing; the file commands
+// turn a status into a message with describe().
+enum class EngineStatus {
+    Ok,
+    OutputTooSmall,     // the output buffer cannot hold the result; its contents are unspecified
+    UnknownCodec,
+    UnknownAlgorithm,
+    InvalidKey,         // the key does not fit the algorithm (see Encryption::keyRule)
+    WrongKey,           // the key check in a ChaCha20 header does not match
+    Truncated,          // the input ends inside a header or a token
+    Corrupted,          // the input is not in the expected format, or a block fails to decode
+    UnsupportedVersion,
+    TooLarge,           // more data than one key stream of the cipher may cover
+    SelfTestFailed,     // a cipher's known-answer test failed; it is not used
+    Cancelled,          // the background job running the call was killed (see Cancellation)
+};
+
+// One line of English for `status`, without a trailing period.
+const char* describe(EngineStatus status);
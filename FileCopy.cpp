@@ -0,0 +1,211 @@
+#include "FileCopy.h"
+#include "Cancellation.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <system_error>
+
+#if defined(__linux__)
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#else
+#include <filesystem>
+#include <random>
+#endif
+
+const char* FileCopy::describe(Method method) {
+    switch (method) {
+    case Method::Reflink: return "reflink";
+    case Method::CopyFileRange: return "copy_file_range";
+    case Method::Sendfile: return "sendfile";
+    case Method::Buffered: return "buffered copy";
+    case Method::System: return "system copy";
+    }
+    return "copy";
+}
+
+#if defined(__linux__)
+
+namespace {
+    // Data moved per system call: large enough to keep the kernel busy, small enough that
+    // a killed job stops within a fraction of a second.
+    const size_t CHUNK = (size_t)16 << 20;
+    const size_t BUFFER_SIZE = (size_t)1 << 20;
+
+    // Errors that mean "not on these file systems", as opposed to a failed copy.
+    bool unsupported(int error) {
+        return error == ENOSYS || error == EXDEV || error == EINVAL || error == EOPNOTSUPP ||
+               error == ENOTTY || error == EBADF || error == EPERM;
+    }
+
+    std::string describeErrno(int error) {
+        return std::generic_category().message(error);
+    }
+
+    struct Descriptor {
+        int fd = -1;
+        ~Descriptor() {
+            if (fd >= 0) ::close(fd);
+        }
+    };
+
+    // A new, empty file next to `destination` (so that rename() can move it into place),
+    // named after it and hidden. Returns its descriptor, or -1 with errno set.
+    int createTemporary(const std::string& destination, std::string& temporary) {
+        size_t slash = destination.find_last_of('/');
+        std::string directory = slash == std::string::npos ? std::string() : destination.substr(0, slash + 1);
+        std::string name = slash == std::string::npos ? destination : destination.substr(slash + 1);
+        temporary = directory + "." + name + ".XXXXXX";
+        return ::mkostemp(&temporary[0], O_CLOEXEC);
+    }
+
+    // Moves up to `size` bytes with one of the calls, adding them to `done`. Returns 0 at
+    // the end, or an errno value; `done` tells whether any data went across before an error.
+    template <typename Call>
+    int transfer(uint64_t size, uint64_t& done, Call call) {
+        while (done < size) {
+            if (Cancellation::requested()) return ECANCELED;
+            ssize_t n = call((size_t)std::min<uint64_t>(CHUNK, size - done));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return errno;
+            }
+            if (n == 0) break; // the source shrank while it was copied
+            done += (uint64_t)n;
+        }
+        return 0;
+    }
+}
+
+bool FileCopy::copy(const std::string& source, const std::string& destination, Result& result, std::string& error) {
+    auto start = std::chrono::steady_clock::now();
+    Descriptor in, out;
+    in.fd = ::open(source.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat from;
+    if (in.fd < 0 || ::fstat(in.fd, &from) != 0) {
+        error = describeErrno(errno);
+        return false;
+    }
+    if (!S_ISREG(from.st_mode)) {
+        error = "not a regular file";
+        return false;
+    }
+    struct stat to;
+    if (::stat(destination.c_str(), &to) == 0 && to.st_dev == from.st_dev && to.st_ino == from.st_ino) {
+        error = "source and destination are the same file";
+        return false;
+    }
+    // The copy is made under a temporary name and renamed over the destination only once
+    // it is complete, so a failed or killed copy leaves an existing file as it was.
+    std::string temporary;
+    out.fd = createTemporary(destination, temporary);
+    if (out.fd < 0) {
+        error = describeErrno(errno);
+        return false;
+    }
+
+    // A clone that fails leaves nothing behind, whatever the reason. The calls after it
+    // hand over to the next one only when they fail before moving any data, with an
+    // error that means these file systems do not support them.
+    uint64_t size = (uint64_t)from.st_size;
+    uint64_t copied = 0;
+    int failure = EOPNOTSUPP;
+#if defined(FICLONE)
+    if (::ioctl(out.fd, FICLONE, in.fd) == 0) {
+        result.method = Method::Reflink;
+        copied = size;
+        failure = 0;
+    }
+#endif
+    // Files that claim to be empty may not be (those in /proc): they are read to the end.
+    if (failure != 0 && size == 0) {
+        failure = EOPNOTSUPP;
+        size = UINT64_MAX;
+    }
+    else if (failure != 0) {
+        result.method = Method::CopyFileRange;
+        failure = transfer(size, copied, [&](size_t n) { return ::copy_file_range(in.fd, nullptr, out.fd, nullptr, n, 0); });
+    }
+    if (failure != 0 && copied == 0 && unsupported(failure)) {
+        result.method = Method::Sendfile;
+        failure = transfer(size, copied, [&](size_t n) { return ::sendfile(out.fd, in.fd, nullptr, n); });
+    }
+    if (failure != 0 && copied == 0 && unsupported(failure)) {
+        result.method = Method::Buffered;
+        std::vector<char> buffer(BUFFER_SIZE);
+        failure = transfer(size, copied, [&](size_t n) -> ssize_t {
+            ssize_t got = ::read(in.fd, buffer.data(), std::min(n, buffer.size()));
+            for (ssize_t put = 0; got > 0 && put < got;) {
+                ssize_t written = ::write(out.fd, buffer.data() + put, (size_t)(got - put));
+                if (written < 0 && errno == EINTR) continue;
+                if (written <= 0) {
+                    // What did go across still counts; a write that moves nothing is an error
+                    // rather than a reason to try again forever.
+                    if (written == 0) errno = EIO;
+                    copied += (uint64_t)put;
+                    return -1;
+                }
+                put += written;
+            }
+            return got;
+        });
+    }
+    if (failure == 0 && ::fchmod(out.fd, from.st_mode & 07777) != 0) failure = errno;
+    if (failure == 0 && ::close(out.fd) != 0) failure = errno;
+    out.fd = -1;
+    if (failure == 0 && ::rename(temporary.c_str(), destination.c_str()) != 0) failure = errno;
+    if (failure != 0) {
+        error = failure == ECANCELED ? "cancelled" : describeErrno(failure);
+        ::unlink(temporary.c_str());
+        return false;
+    }
+
+    result.bytes = copied;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+#else
+
+bool FileCopy::copy(const std::string& source, const std::string& destination, Result& result, std::string& error) {
+    namespace fs = std::filesystem;
+    auto start = std::chrono::steady_clock::now();
+    std::error_code ec;
+    if (!fs::is_regular_file(source, ec)) {
+        error = ec ? ec.message() : "not a regular file";
+        return false;
+    }
+    if (fs::exists(destination, ec) && fs::equivalent(source, destination, ec)) {
+        error = "source and destination are the same file";
+        return false;
+    }
+    if (Cancellation::requested()) {
+        error = "cancelled";
+        return false;
+    }
+    // As on Linux, the copy goes to a temporary name beside the destination first, so a
+    // failed copy leaves an existing file as it was.
+    fs::path target(destination);
+    fs::path temporary = target.parent_path() /
+                         ("." + target.filename().string() + "." + std::to_string(std::random_device()()));
+    uint64_t size = fs::file_size(source, ec);
+    if (!ec && fs::copy_file(source, temporary, fs::copy_options::none, ec)) fs::rename(temporary, target, ec);
+    if (ec) {
+        error = ec.message();
+        std::error_code ignored;
+        fs::remove(temporary, ignored);
+        return false;
+    }
+    result.method = Method::System;
+    result.bytes = size;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+#endif
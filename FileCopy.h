@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+// Copies one file's contents as cheaply as the file systems involved allow. On Linux
+// the kernel is asked, in order, for a reflink (FICLONE: btrfs, XFS and others share
+// the blocks and nothing is copied), copy_file_range (done inside the kernel, or on
+// the server for NFS 4.2 and SMB), sendfile (still no trip through user space), and
+// only then is the data read and written through a large buffer. Elsewhere
+// std::filesystem::copy_file does the work (CopyFile on Windows, which has its own
+// server-side and clone paths).
+class FileCopy {
+public:
+    enum class Method { Reflink, CopyFileRange, Sendfile, Buffered, System };
+
+    struct Result {
+        Method method = Method::Buffered;
+        uint64_t bytes = 0;
+        double seconds = 0;
+    };
+
+    // Copies `source` to `destination`, replacing it, with the source's permissions. The
+    // data goes to a temporary file in the destination's directory that is renamed into
+    // place once complete. Returns false, with `error` set and the destination untouched,
+    // if the source is not a regular file, both name the same file, the copy fails or the
+    // background job running it is killed (see Cancellation).
+    static bool copy(const std::string& source, const std::string& destination, Result& result, std::string& error);
+
+    static const char* describe(Method method);
+};
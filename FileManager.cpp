@@ -3,18 +3,59 @@
 #include "Encryption.h"
 #include "MemoryManager.h"
 #include "ProcessManager.h" // Include ProcessManager header
+#include "MappedFile.h"
+#include "CpuFeatures.h"
+#include "RunScan.h"
+#include "CipherKernels.h"
+#include "ChaCha20.h"
+#include "Crc32c.h"
+#include "Pipeline.h"
+#include "InPlaceCipher.h"
+#include "Cancellation.h"
+#include "Glob.h"
+#include "WorkStealingPool.h"
+#include "ThreadPool.h"
+#include "DirectoryWalker.h"
+#include "StatCache.h"
+#include "FileCopy.h"
 #include <iostream>
 #include <filesystem>
 #include <fstream>
 #include <cstdlib>
-#include <sstream>
+#include <cstdio>
+#include <cstring>
+#include <climits>
+#include <charconv>
 #include <limits>
 #include <string>
 #include <cctype>
 #include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <ctime>
 
 namespace fs = std::filesystem;
 
+namespace {
+    // --cipher takes a name or the algorithm number used by encrypt/decrypt.
+    std::string cipherName(const std::string& arg) {
+        static const char* const numbered[] = { "caesar", "xor", "vigenere", "railfence", "chacha20" };
+        if (arg.size() == 1 && arg[0] >= '1' && arg[0] <= '5') return numbered[arg[0] - '1'];
+        std::string name = arg;
+        for (auto& c : name) c = (char)std::tolower((unsigned char)c);
+        return name;
+    }
+
+    // True if `output` names the same file as `input` (writing it would destroy the input).
+    bool sameFile(const std::string& input, const std::string& output) {
+        std::error_code ec;
+        return input != "-" && output != "-" && StatCache::get().exists(output) && fs::equivalent(input, output, ec);
+    }
+}
+
 // Constructor (if you have any initialization, do it here)
 FileManager::FileManager() {
     // Constructor initializes member objects (memoryManager, processManager)
@@ -22,531 +63,1543 @@ FileManager::FileManager() {
     // You can add any other initialization logic here if needed.
 }
 
+namespace {
+    // Id of the background job running on this thread, 0 on the command thread.
+    thread_local int currentJob = 0;
+}
+
 // Helper function to add a task to the process manager and return its ID
-int FileManager::addProcessTask(const std::string& taskDescription) {
-    return processManager.addProcess(taskDescription);
+int FileManager::addProcessTask(const std::string& taskDescription, std::ostream& messages) {
+    // A command running as a job already has its entry: the job's.
+    if (currentJob != 0) return currentJob;
+    return processManager.addProcess(taskDescription, messages);
 }
 
+bool FileManager::hasFailures() const {
+    return processManager.hasFailed();
+}
 
-void FileManager::handleCommand(const std::string& input) {
-    std::istringstream iss(input);
-    std::string command;
-    iss >> command;
 
-    std::vector<std::string> args;
-    std::string arg;
-    while (iss >> arg) {
-        args.push_back(arg);
+// --- Command dispatch ---
+// A command line is split into views of the line itself, into a word list that keeps
+// its capacity from one command to the next, and the command name is looked up in a
+// hash table of handlers: running a command allocates nothing until the handler does.
+namespace {
+    bool isSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
     }
+}
 
-    // Keep track of process ID for status update
-    int processId = -1; // Initialize with an invalid ID
+void FileManager::tokenize(std::string_view line, std::string_view& command, Args& words) {
+    words.clear();
+    command = std::string_view();
+    size_t i = 0;
+    while (true) {
+        while (i < line.size() && isSpace(line[i])) ++i;
+        if (i == line.size()) break;
+        size_t start = i;
+        std::string_view word;
+        size_t close;
+        if ((line[i] == '\'' || line[i] == '"') && (close = line.find(line[i], i + 1)) != std::string_view::npos) {
+            // 'a b' and "a b" are one word without the quotes, so names with spaces and
+            // wildcards meant for the batch forms get through as written.
+            word = line.substr(start + 1, close - start - 1);
+            i = close + 1;
+        }
+        else {
+            while (i < line.size() && !isSpace(line[i])) ++i;
+            word = line.substr(start, i - start);
+        }
+        if (command.empty()) command = word;
+        else words.push_back(word);
+    }
+}
 
-    if (command == "help") {
-        showHelp();
-        std::cout << "\n"; // Add space after command output
+// The second field says whether the command may run as a background job. Those that
+// read the console, drive the job list or end the session may not.
+const std::unordered_map<std::string_view, FileManager::Command>& FileManager::commandTable() {
+    static const std::unordered_map<std::string_view, Command> table = {
+        { "help", { &FileManager::handleHelp, true } },
+        { "list", { &FileManager::handleList, true } },
+        { "mkdir", { &FileManager::handleMkdir, true } },
+        { "touch", { &FileManager::handleTouch, true } },
+        { "rm", { &FileManager::handleRm, true } },
+        { "add", { &FileManager::handleAdd, true } },
+        { "read", { &FileManager::handleRead, true } },
+        { "write", { &FileManager::handleWrite, false } },
+        { "open", { &FileManager::handleOpen, true } },
+        { "compress", { &FileManager::handleCompress, true } },
+        { "decompress", { &FileManager::handleDecompress, true } },
+        { "encrypt", { &FileManager::handleEncrypt, true } },
+        { "decrypt", { &FileManager::handleDecrypt, true } },
+        { "pack", { &FileManager::handlePack, true } },
+        { "unpack", { &FileManager::handleUnpack, true } },
+        { "alloc", { &FileManager::handleAlloc, true } },
+        { "dealloc", { &FileManager::handleDealloc, true } },
+        { "checksum", { &FileManager::handleChecksum, true } },
+        { "cpuinfo", { &FileManager::handleCpuInfo, true } },
+        { "meminfo", { &FileManager::handleMemInfo, true } },
+        { "du", { &FileManager::handleDu, true } },
+        { "tree", { &FileManager::handleTree, true } },
+        { "find", { &FileManager::handleFind, true } },
+        { "procstatus", { &FileManager::handleProcStatus, true } },
+        { "jobs", { &FileManager::handleJobs, false } },
+        { "wait", { &FileManager::handleWait, false } },
+        { "kill", { &FileManager::handleKill, false } },
+        { "clearcp", { &FileManager::handleClearCompleted, true } },
+        { "clearallp", { &FileManager::handleClearAll, true } },
+        { "clear", { &FileManager::handleClear, false } },
+        { "exit", { &FileManager::handleExit, false } },
+    };
+    return table;
+}
+
+bool FileManager::handleCommand(std::string_view input) {
+    // A trailing '&' sends the command to a background job.
+    size_t last = input.find_last_not_of(" \t\r\n\v\f");
+    bool background = last != std::string_view::npos && input[last] == '&';
+    if (background) input = input.substr(0, last);
+
+    std::string_view command;
+    tokenize(input, command, words);
+    if (command.empty()) {
+        if (!background) return true;
+        std::cout << "Usage: <command> [args...] &\n\n";
+        return false;
     }
-    else if (command == "list") {
-        listFiles();
-        std::cout << "\n"; // Add space after command output
+
+    const auto& table = commandTable();
+    auto entry = table.find(command);
+    if (entry == table.end()) {
+        std::cout << "Unknown command. Type 'help' for available commands.\n\n"; // Add space to unknown command
+        return false;
     }
-    else if (command == "mkdir") {
-        if (args.empty()) {
-            std::cout << "Usage: mkdir <dir>\n\n"; // Add space to usage
-        }
-        else {
-            // Execute command logic first
-            makeDirectory(args[0]); // makeDirectory handles existence check and prints error
+    if (background) return startJob(input, command, entry->second);
+    return (this->*entry->second.handler)(words);
+}
 
-            // Add process task and update status
-            processId = addProcessTask("Create Directory: " + args[0]);
-            // Assuming makeDirectory succeeds if it doesn't print an error
-            // A more robust approach would be to have makeDirectory return a status
-            // For now, we'll assume completion unless an explicit error is caught.
-            processManager.updateProcessStatus(processId, ProcessStatus::Completed);
-            std::cout << "\n"; // Add space after command output
-        }
+// Runs the command on a worker thread under its own process entry. The job gets its
+// own copy of the line, since the caller's buffer is reused for the next command.
+bool FileManager::startJob(std::string_view input, std::string_view name, const Command& command) {
+    if (!command.background) {
+        std::cerr << "Error: '" << name << "' cannot run in the background.\n\n";
+        return false;
+    }
+    if (std::find(words.begin(), words.end(), "-") != words.end()) {
+        std::cerr << "Error: A background job cannot read stdin or write stdout ('-').\n\n";
+        return false;
     }
 
-    else if (command == "touch") {
-        if (args.empty()) {
-            std::cerr << "Usage: touch <filename>\n\n"; // Add space to usage
-            return;
-        }
-        std::string filename = args[0];
-        // Check if file exists before attempting to create
-        bool fileExists = fs::exists(filename);
+    size_t first = input.find_first_not_of(" \t\r\n\v\f");
+    size_t last = input.find_last_not_of(" \t\r\n\v\f");
+    std::string line(input.substr(first, last + 1 - first));
+    Handler handler = command.handler;
+    processManager.submit(line, [this, line, handler](int id) {
+        Args args;
+        std::string_view commandName;
+        tokenize(line, commandName, args);
+        currentJob = id;
+        bool success = (this->*handler)(args);
+        currentJob = 0;
+        return success;
+    });
+    std::cout << "\n";
+    return true;
+}
+
+bool FileManager::exitRequested() const {
+    return exiting;
+}
 
-        // Add process task early
-        processId = addProcessTask("Create File: " + filename);
+// Marks the task finished and passes `success` on as the command's result. A job's
+// entry is finished by ProcessManager once the whole command has returned.
+bool FileManager::finishTask(int processId, bool success) {
+    if (processId == currentJob) return success;
+    processManager.updateProcessStatus(processId, success ? ProcessStatus::Completed : ProcessStatus::Failed);
+    return success;
+}
 
-        // --- Execute command logic ---
-        if (fileExists) {
-            std::cerr << "Error: File '" << filename << "' already exists.\n";
-            processManager.updateProcessStatus(processId, ProcessStatus::Failed); // Mark as failed
-        }
-        else {
-            createFile(filename); // createFile handles creation and prints messages
-            // Assuming createFile succeeds if it doesn't print an error
-            processManager.updateProcessStatus(processId, ProcessStatus::Completed);
-        }
-        // --- End of command logic ---
-        std::cout << "\n"; // Add space after command output
+// --- Commands ---
+// Each returns whether the command succeeded; a usage message counts as a failure.
+bool FileManager::handleHelp(Args&) {
+    showHelp();
+    std::cout << "\n"; // Add space after command output
+    return true;
+}
+
+bool FileManager::handleList(Args& args) {
+    ListOptions options;
+    std::string sortText, limitText, offsetText;
+    options.longFormat = extractFlag(args, "--long") | extractFlag(args, "-l");
+    if (!extractOption(args, "--sort", sortText) || !extractOption(args, "--filter", options.filter) ||
+        !extractOption(args, "--limit", limitText) || !extractOption(args, "--offset", offsetText)) {
+        std::cerr << "Error: --sort, --filter, --limit and --offset each expect a value.\n\n";
+        return false;
+    }
+    bool ok = args.size() <= 1;
+    if (sortText == "size") options.sort = ListOptions::Sort::Size;
+    else if (sortText == "mtime") options.sort = ListOptions::Sort::Mtime;
+    else if (!sortText.empty() && sortText != "name") ok = false;
+    if (ok && !limitText.empty()) ok = parseByteCount(limitText, options.limit);
+    if (ok && !offsetText.empty()) ok = parseByteCount(offsetText, options.offset);
+    if (!ok) {
+        std::cout << "Usage: list [--sort=name|size|mtime] [--filter <glob>] [--limit N] [--offset N] [--long] [dir]\n\n";
+        return false;
     }
+    if (!args.empty()) options.directory.assign(args[0]);
 
-    else if (command == "rm") {
-        if (args.empty()) {
-            std::cout << "Usage: rm <file/dir>\n\n"; // Add space to usage
-        }
-        else {
-            // Check if file exists before attempting removal (and deallocation)
-            fs::path target = fs::current_path() / args[0];
-            bool fileExists = fs::exists(target);
+    bool success = listFiles(options);
+    std::cout << "\n"; // Add space after command output
+    return success;
+}
 
-            // Execute command logic first
-            // The remove function handles deallocation attempt and prints messages (including file not found error)
-            remove(args[0]);
+bool FileManager::handleMkdir(Args& args) {
+    if (args.empty()) {
+        std::cout << "Usage: mkdir <dir>\n\n"; // Add space to usage
+        return false;
+    }
+    std::string dirName(args[0]);
+    // Execute command logic first
+    bool success = makeDirectory(dirName); // makeDirectory handles existence check and prints error
+
+    // Add process task and update status
+    int processId = addProcessTask("Create Directory: " + dirName);
+    finishTask(processId, success);
+    std::cout << "\n"; // Add space after command output
+    return success;
+}
 
-            // Add process task and update status
-            processId = addProcessTask("Remove File/Directory: " + args[0]);
+bool FileManager::handleTouch(Args& args) {
+    if (args.empty()) {
+        std::cerr << "Usage: touch <filename>\n\n"; // Add space to usage
+        return false;
+    }
+    std::string filename(args[0]);
+    // Check if file exists before attempting to create
+    bool fileExists = StatCache::get().exists(filename);
 
-            // Update status based on whether the file existed before attempting removal
-            if (fileExists) {
-                // Assuming remove succeeds if it doesn't print a filesystem error
-                processManager.updateProcessStatus(processId, ProcessStatus::Completed);
-            }
-            else {
-                // If the file didn't exist, the remove operation failed
-                processManager.updateProcessStatus(processId, ProcessStatus::Failed);
-            }
-            std::cout << "\n"; // Add space after command output
-        }
+    // Add process task early
+    int processId = addProcessTask("Create File: " + filename);
+
+    // --- Execute command logic ---
+    bool success = false;
+    if (fileExists) {
+        std::cerr << "Error: File '" << filename << "' already exists.\n";
     }
-    else if (command == "add") {
-        if (args.empty()) {
-            std::cout << "Usage: add <full_path_to_file>\n\n"; // Add space to usage
-        }
-        else {
-            std::string srcPath = args[0];
-            // Check if source file exists before attempting to add
-            bool sourceExists = fs::exists(srcPath);
+    else {
+        success = createFile(filename); // createFile handles creation and prints messages
+    }
+    finishTask(processId, success);
+    // --- End of command logic ---
+    std::cout << "\n"; // Add space after command output
+    return success;
+}
 
-            // Execute command logic
-            addFile(srcPath); // addFile handles source file existence check and prints messages
+bool FileManager::handleRm(Args& args) {
+    if (args.empty()) {
+        std::cout << "Usage: rm <file/dir>\n\n"; // Add space to usage
+        return false;
+    }
+    std::string name(args[0]);
 
-            // Add process task and update status
-            processId = addProcessTask("Add File: " + srcPath);
+    // Execute command logic first
+    // The remove function handles deallocation attempt and prints messages (including file not found error)
+    bool success = remove(name);
 
-            // Update status based on whether the source file existed
-            if (sourceExists) {
-                // Assuming addFile succeeds if it doesn't print a filesystem error
-                processManager.updateProcessStatus(processId, ProcessStatus::Completed);
-            }
-            else {
-                processManager.updateProcessStatus(processId, ProcessStatus::Failed);
-            }
-            std::cout << "\n"; // Add space after command output
-        }
+    // Add process task and update status
+    int processId = addProcessTask("Remove File/Directory: " + name);
+    finishTask(processId, success);
+    std::cout << "\n"; // Add space after command output
+    return success;
+}
+
+bool FileManager::handleAdd(Args& args) {
+    unsigned threads = 0;
+    if (!extractThreadCount(args, threads)) {
+        std::cerr << "Error: -j expects a positive number of threads.\n\n";
+        return false;
     }
-    else if (command == "read") {
-        if (args.empty()) {
-            std::cout << "Usage: read <filename>\n\n"; // Add space to usage
-        }
-        else {
-            std::string filename = args[0];
-            // Check if file exists before attempting to read
-            bool fileExists = fs::exists(filename);
+    if (args.empty()) {
+        std::cout << "Usage: add [-j N] <file|dir|pattern>...\n\n"; // Add space to usage
+        return false;
+    }
+    if (args.size() > 1 || Glob::hasWildcards(args[0]) || StatCache::get().isDirectory(std::string(args[0]))) {
+        std::vector<std::string> operands(args.begin(), args.end());
+        return addFiles(operands, threads);
+    }
+    std::string srcPath(args[0]);
 
-            // Execute command logic
-            readFile(filename); // readFile handles file existence check and prints error
+    // Execute command logic
+    bool success = addFile(srcPath, fs::path(srcPath).filename().string()); // addFile handles source file existence check and prints messages
 
-            // Reading is usually quick, maybe don't track as a process?
-            // If you want to track:
-            processId = addProcessTask("Read File: " + filename);
-            processManager.updateProcessStatus(processId, fileExists ? ProcessStatus::Completed : ProcessStatus::Failed);
+    // Add process task and update status
+    int processId = addProcessTask("Add File: " + srcPath);
+    finishTask(processId, success);
+    std::cout << "\n"; // Add space after command output
+    return success;
+}
 
-            std::cout << "\n"; // Add space after command output
-        }
+bool FileManager::handleRead(Args& args) {
+    std::string offsetText, lengthText;
+    uint64_t offset = 0;
+    uint64_t length = UINT64_MAX;
+    if (!extractOption(args, "--offset", offsetText) || !extractOption(args, "--len", lengthText) ||
+        (!offsetText.empty() && !parseByteCount(offsetText, offset)) ||
+        (!lengthText.empty() && !parseByteCount(lengthText, length))) {
+        std::cerr << "Error: --offset and --len expect a number of bytes.\n\n";
+        return false;
     }
-    else if (command == "write") {
-        if (args.empty()) {
-            std::cout << "Usage: write <filename>\n\n"; // Add space to usage
-        }
-        else {
-            std::string filename = args[0];
-            // Check if file exists before writing
-            bool fileExists = fs::exists(filename);
+    if (args.empty()) {
+        std::cout << "Usage: read [--offset X] [--len N] <filename>\n\n"; // Add space to usage
+        return false;
+    }
+    std::string filename(args[0]);
 
-            // Add process task early
-            processId = addProcessTask("Write File: " + filename);
+    // Execute command logic
+    bool success;
+    if (offsetText.empty() && lengthText.empty()) {
+        success = readFile(filename); // readFile handles file existence check and prints error
+    }
+    else {
+        success = readFileRange(filename, offset, length);
+    }
 
-            // --- Execute command logic ---
-            if (!fileExists) {
-                std::cerr << "Error: File '" << filename << "' does not exist. Use 'touch' to create it first.\n";
-                processManager.updateProcessStatus(processId, ProcessStatus::Failed); // Mark as failed
-            }
-            else {
-                writeFile(filename); // writeFile handles opening and writing
-                // Assuming writeFile succeeds if it doesn't print an error
-                processManager.updateProcessStatus(processId, ProcessStatus::Completed);
-            }
-            // --- End of command logic ---
-            std::cout << "\n"; // Add space after command output
-        }
+    // Reading is usually quick, maybe don't track as a process?
+    // If you want to track:
+    int processId = addProcessTask("Read File: " + filename);
+    finishTask(processId, success);
+
+    std::cout << "\n"; // Add space after command output
+    return success;
+}
+
+bool FileManager::handleWrite(Args& args) {
+    if (args.empty()) {
+        std::cout << "Usage: write <filename>\n\n"; // Add space to usage
+        return false;
     }
+    std::string filename(args[0]);
+    // Check if file exists before writing
+    bool fileExists = StatCache::get().exists(filename);
 
-    else if (command == "open") {
-        if (args.empty()) {
-            std::cout << "Usage: open <filename>\n\n"; // Add space to usage
-        }
-        else {
-            std::string filename = args[0];
-            // Check if file exists before attempting to open
-            bool fileExists = fs::exists(filename);
+    // Add process task early
+    int processId = addProcessTask("Write File: " + filename);
 
-            // Execute command logic
-            openFile(filename); // openFile handles file existence check and prints error
+    // --- Execute command logic ---
+    bool success = false;
+    if (!fileExists) {
+        std::cerr << "Error: File '" << filename << "' does not exist. Use 'touch' to create it first.\n";
+    }
+    else {
+        success = writeFile(filename); // writeFile handles opening and writing
+    }
+    finishTask(processId, success);
+    // --- End of command logic ---
+    std::cout << "\n"; // Add space after command output
+    return success;
+}
 
-            // Opening is external, maybe don't track as a process?
-            // If you want to track:
-            processId = addProcessTask("Open File: " + filename);
-            processManager.updateProcessStatus(processId, fileExists ? ProcessStatus::Completed : ProcessStatus::Failed);
+bool FileManager::handleOpen(Args& args) {
+    if (args.empty()) {
+        std::cout << "Usage: open <filename>\n\n"; // Add space to usage
+        return false;
+    }
+    std::string filename(args[0]);
 
-            std::cout << "\n"; // Add space after command output
-        }
+    // Execute command logic
+    bool success = openFile(filename); // openFile handles file existence check and prints error
+
+    // Opening is external, maybe don't track as a process?
+    // If you want to track:
+    int processId = addProcessTask("Open File: " + filename);
+    finishTask(processId, success);
+
+    std::cout << "\n"; // Add space after command output
+    return success;
+}
+
+bool FileManager::handleCompress(Args& args) {
+    unsigned threads = 0;
+    std::string codec = "auto";
+    bool recursive = extractFlag(args, "-r");
+    if (!extractThreadCount(args, threads)) {
+        std::cerr << "Error: -j expects a positive number of threads.\n\n";
+        return false;
+    }
+    if (!extractOption(args, "--codec", codec)) {
+        std::cerr << "Error: --codec expects a codec name.\n\n";
+        return false;
+    }
+    if (args.empty()) {
+        std::cout << "Usage: compress [-j N] [--codec=<name|auto>] <filename|pattern>\n"
+                  << "       compress [-j N] [--codec=<name|auto>] -r <dir> [pattern]\n\n"; // Add space to usage
+        return false;
+    }
+    if (recursive || Glob::hasWildcards(args[0])) {
+        std::vector<std::string> files;
+        if (!collectFiles(args[0], recursive, args.size() > 1 ? args[1] : "*", files)) return false;
+        return runBatch("Compress", files, threads, [codec](const std::string& file) {
+            return Compression::compressFile(file, 1, codec);
+        });
+    }
+    if (threads == 0) threads = 1;
+    std::string filename(args[0]);
+    bool fileExists = StatCache::get().exists(filename);
+    int processId = addProcessTask("Compress File: " + filename);
+
+    bool success = false;
+    if (!fileExists) {
+        std::cerr << "Error: File '" << filename << "' does not exist. Cannot compress.\n";
+    }
+    else {
+        success = compress(filename, threads, codec);
     }
+    finishTask(processId, success);
+    std::cout << "\n";
+    return success;
+}
 
-    else if (command == "compress") {
-        if (args.empty()) {
-            std::cout << "Usage: compress <filename>\n\n"; // Add space to usage
-        }
-        else {
-            std::string filename = args[0];
-            bool fileExists = fs::exists(filename);
-            processId = addProcessTask("Compress File: " + filename);
+bool FileManager::handleDecompress(Args& args) {
+    unsigned threads = 0;
+    bool recursive = extractFlag(args, "-r");
+    if (!extractThreadCount(args, threads)) {
+        std::cerr << "Error: -j expects a positive number of threads.\n\n";
+        return false;
+    }
+    if (args.empty()) {
+        std::cout << "Usage: decompress [-j N] <filename|pattern>\n"
+                  << "       decompress [-j N] -r <dir> [pattern]   (pattern defaults to *_compressed.bin)\n\n"; // Add space to usage
+        return false;
+    }
+    if (recursive || Glob::hasWildcards(args[0])) {
+        std::vector<std::string> files;
+        if (!collectFiles(args[0], recursive, args.size() > 1 ? args[1] : "*_compressed.bin", files)) return false;
+        return runBatch("Decompress", files, threads, [](const std::string& file) {
+            return Compression::decompressFile(file, 1);
+        });
+    }
+    if (threads == 0) threads = 1;
+    std::string filename(args[0]);
+    // Check if file exists before decompressing
+    bool fileExists = StatCache::get().exists(filename);
+
+    // Add process task early
+    int processId = addProcessTask("Decompress File: " + filename);
+
+    // --- Execute command logic ---
+    bool success = false;
+    if (!fileExists) {
+        std::cerr << "Error: File '" << filename << "' does not exist. Cannot decompress.\n";
+    }
+    else {
+        // decompress calls Compression::decompressFile which returns bool
+        success = decompress(filename, threads);
+    }
+    finishTask(processId, success);
+    // --- End of command logic ---
+    std::cout << "\n"; // Add space after command output
+    return success;
+}
 
-            if (!fileExists) {
-                std::cerr << "Error: File '" << filename << "' does not exist. Cannot compress.\n";
-                processManager.updateProcessStatus(processId, ProcessStatus::Failed);
-            }
-            else {
-                bool success = compress(filename);  // new logic
-                if (success) {
-                    processManager.updateProcessStatus(processId, ProcessStatus::Completed);
-                }
-                else {
-                    processManager.updateProcessStatus(processId, ProcessStatus::Failed);
-                }
-            }
-            std::cout << "\n";
+bool FileManager::handleEncrypt(Args& args) {
+    return runCipherCommand(args, false);
+}
+
+bool FileManager::handleDecrypt(Args& args) {
+    return runCipherCommand(args, true);
+}
+
+// encrypt and decrypt take the same arguments and differ only in direction.
+bool FileManager::runCipherCommand(Args& args, bool decrypt) {
+    const char* verb = decrypt ? "decrypt" : "encrypt";
+    unsigned threads = 0;
+    bool recursive = extractFlag(args, "-r");
+    bool rollback = extractFlag(args, "--rollback");
+    bool inplace = extractFlag(args, "--inplace") || rollback;
+    if (!extractThreadCount(args, threads)) {
+        std::cerr << "Error: -j expects a positive number of threads.\n\n";
+        return false;
+    }
+    if (args.size() < 3) {
+        std::cout << "Usage: " << verb << " [-j N] [--inplace] [--rollback] <algorithm_number> <filename|pattern> <key>\n";
+        std::cout << "       " << verb << " [-j N] [--inplace] [--rollback] <algorithm_number> -r <dir> [pattern] <key>\n";
+        std::cout << "Available algorithms: 1:Caesar, 2:XOR, 3:Vigenere, 4:RailFence, 5:ChaCha20\n\n"; // Add space to usage
+        return false;
+    }
+    std::string_view algorithm_number = args[0];
+    std::string filename(args[1]);
+    std::string key(args[recursive && args.size() > 3 ? 3 : 2]);
+
+    static const char* const algorithms[] = { "caesar", "xor", "vigenere", "railfence", "chacha20" };
+    if (algorithm_number.size() != 1 || algorithm_number[0] < '1' || algorithm_number[0] > '5') {
+        std::cerr << "Invalid algorithm number. Please use 1, 2, 3, 4, or 5.\n\n"; // Add space to error
+        // No process added for invalid algorithm number, so no status update needed
+        return false;
+    }
+    std::string algorithm_name = algorithms[algorithm_number[0] - '1'];
+
+    if (recursive || Glob::hasWildcards(filename)) {
+        std::string_view pattern = args.size() > 3 ? args[2] : decrypt && !inplace ? "*.enc" : "*";
+        std::vector<std::string> files;
+        if (!collectFiles(filename, recursive, pattern, files)) return false;
+        return runBatch(decrypt ? "Decrypt" : "Encrypt", files, threads, [=](const std::string& file) {
+            if (inplace) return InPlaceCipher::run(algorithm_name, file, key, decrypt, rollback, 1);
+            if (decrypt) return Encryption::decryptFile(algorithm_name, file, key, 1);
+            return Encryption::encryptFile(algorithm_name, file, key, 1);
+        });
+    }
+    if (threads == 0) threads = 1;
+
+    // Add process task early
+    int processId = addProcessTask(std::string(decrypt ? "Decrypt File: " : "Encrypt File: ") + filename + " (" +
+                                   algorithm_name + (inplace ? ", in place)" : ")"));
+
+    // --- Check if file exists before encrypting/decrypting ---
+    if (!StatCache::get().exists(filename)) {
+        std::cerr << "Error: File '" << filename << "' does not exist. Cannot " << verb << ".\n";
+        finishTask(processId, false); // Mark as failed
+        std::cout << "\n"; // Add space after command output
+        return false;
+    }
+    // --- End of check ---
+
+    // Execute command logic
+    // Encryption::decryptFile also has an internal check for the .enc suffix
+    bool success;
+    if (inplace) success = InPlaceCipher::run(algorithm_name, filename, key, decrypt, rollback, threads);
+    else if (decrypt) success = Encryption::decryptFile(algorithm_name, filename, key, threads);
+    else success = Encryption::encryptFile(algorithm_name, filename, key, threads);
+    finishTask(processId, success);
+
+    std::cout << "\n"; // Add space after command output
+    return success;
+}
+
+bool FileManager::handlePack(Args& args) {
+    unsigned threads = 1;
+    std::string output, codec = "auto", cipher = "none", key;
+    if (!extractThreadCount(args, threads)) {
+        std::cerr << "Error: -j expects a positive number of threads.\n\n";
+        return false;
+    }
+    if (!extractOption(args, "-o", output) || !extractOption(args, "--codec", codec) ||
+        !extractOption(args, "--cipher", cipher) || !extractOption(args, "--key", key)) {
+        std::cerr << "Error: -o, --codec, --cipher and --key each expect a value.\n\n";
+        return false;
+    }
+    if (args.empty()) {
+        std::cout << "Usage: pack [-j N] [--codec=C] [--cipher=Y --key=K] [-o <out>] <file>\n\n";
+        return false;
+    }
+    std::string input(args[0]);
+    if (output.empty()) output = input == "-" ? "-" : input + ".pack";
+    // While the data goes to stdout, the console messages go to stderr so they cannot
+    // end up mixed into it.
+    std::ostream& messages = output == "-" ? std::cerr : std::cout;
+    int processId = addProcessTask("Pack File: " + input + " -> " + output, messages);
+
+    bool success = false;
+    if (input != "-" && !StatCache::get().exists(input)) {
+        std::cerr << "Error: File '" << input << "' does not exist. Cannot pack.\n";
+    }
+    else if (sameFile(input, output)) {
+        std::cerr << "Error: Output '" << output << "' is the input file.\n";
+    }
+    else {
+        success = Pipeline::pack(input, output, codec, cipherName(cipher), key, threads, messages);
+    }
+    finishTask(processId, success);
+    messages << "\n";
+    return success;
+}
+
+bool FileManager::handleUnpack(Args& args) {
+    unsigned threads = 1;
+    std::string output, key;
+    if (!extractThreadCount(args, threads)) {
+        std::cerr << "Error: -j expects a positive number of threads.\n\n";
+        return false;
+    }
+    if (!extractOption(args, "-o", output) || !extractOption(args, "--key", key)) {
+        std::cerr << "Error: -o and --key each expect a value.\n\n";
+        return false;
+    }
+    if (args.empty()) {
+        std::cout << "Usage: unpack [-j N] [--key=K] [-o <out>] <file.pack>\n\n";
+        return false;
+    }
+    std::string input(args[0]);
+    const std::string suffix = ".pack";
+    bool defaultOutput = output.empty();
+    if (defaultOutput && input == "-") {
+        output = "-";
+    }
+    else if (defaultOutput && input.size() > suffix.size() &&
+             input.compare(input.size() - suffix.size(), suffix.size(), suffix) == 0) {
+        output = input.substr(0, input.size() - suffix.size());
+    }
+    std::ostream& messages = output == "-" ? std::cerr : std::cout; // as in pack
+    int processId = addProcessTask("Unpack File: " + input + " -> " + (output.empty() ? "?" : output), messages);
+
+    bool success = false;
+    if (input != "-" && !StatCache::get().exists(input)) {
+        std::cerr << "Error: File '" << input << "' does not exist. Cannot unpack.\n";
+    }
+    else if (output.empty()) {
+        std::cerr << "Error: '" << input << "' has no .pack suffix; name the output with -o.\n";
+    }
+    else if (defaultOutput && output != "-" && StatCache::get().exists(output)) {
+        std::cerr << "Error: '" << output << "' already exists. Remove it or name the output with -o.\n";
+    }
+    else if (sameFile(input, output)) {
+        std::cerr << "Error: Output '" << output << "' is the input file.\n";
+    }
+    else {
+        success = Pipeline::unpack(input, output, key, threads, messages);
+    }
+    finishTask(processId, success);
+    messages << "\n";
+    return success;
+}
+
+bool FileManager::handleAlloc(Args& args) {
+    if (args.size() < 2) {
+        std::cout << "Usage: alloc <filename> <sizeKB>\n\n"; // Add space to usage
+        return false;
+    }
+    std::string filename(args[0]);
+    std::string size(args[1]);
+    // Check if file exists before allocating
+    bool fileExists = StatCache::get().exists(filename);
+
+    // Add process task early
+    int processId = addProcessTask("Allocate Memory: " + filename + " (" + size + "KB)");
+
+    // --- Execute command logic ---
+    bool success = false;
+    if (!fileExists) {
+        std::cerr << "Error: File '" << filename << "' does not exist. Cannot allocate memory.\n";
+    }
+    else {
+        try {
+            int sizeKB = std::stoi(size);
+            std::lock_guard<std::mutex> lock(memoryMutex);
+            memoryManager.allocate(filename, sizeKB); // Call allocate on the member variable
+            // memoryManager.allocate prints success/failure messages related to allocation logic
+            // We need to check the result of allocate to determine process status more accurately
+            // For now, we'll assume if file exists and size is valid, it attempts allocation.
+            // A more robust MM::allocate would return bool.
+            success = true; // Assuming success if file exists and size is valid
+        }
+        catch (const std::invalid_argument&) {
+            std::cerr << "Error: Invalid size. Please provide an integer value for sizeKB.\n";
+        }
+        catch (const std::out_of_range&) {
+            std::cerr << "Error: Size value out of range for integer conversion.\n";
         }
     }
-    else if (command == "decompress") {
-        if (args.empty()) {
-            std::cout << "Usage: decompress <filename>\n\n"; // Add space to usage
+    finishTask(processId, success);
+    // --- End of command logic ---
+    std::cout << "\n"; // Add space after command output
+    return success;
+}
+
+bool FileManager::handleDealloc(Args& args) {
+    if (args.empty()) {
+        std::cout << "Usage: dealloc <filename>\n\n"; // Add space to usage
+        return false;
+    }
+    std::string filename(args[0]);
+    // Check if file exists before deallocating
+    bool fileExists = StatCache::get().exists(filename);
+
+    // Add process task early
+    int processId = addProcessTask("Deallocate Memory: " + filename);
+
+    // --- Execute command logic ---
+    if (!fileExists) {
+        std::cerr << "Error: File '" << filename << "' does not exist. Cannot deallocate memory.\n";
+    }
+    else {
+        // memoryManager.deallocate is silent if no allocation exists.
+        // It doesn't return a status. We'll assume success if the file exists.
+        std::lock_guard<std::mutex> lock(memoryMutex);
+        memoryManager.deallocate(filename);
+    }
+    finishTask(processId, fileExists);
+    // --- End of command logic ---
+    std::cout << "\n"; // Add space after command output
+    return fileExists;
+}
+
+bool FileManager::handleChecksum(Args& args) {
+    unsigned threads = 0;
+    bool recursive = extractFlag(args, "-r");
+    if (!extractThreadCount(args, threads)) {
+        std::cerr << "Error: -j expects a positive number of threads.\n\n";
+        return false;
+    }
+    if (args.empty()) {
+        std::cout << "Usage: checksum <filename|pattern>\n"
+                  << "       checksum [-j N] -r <dir> [pattern]\n\n";
+        return false;
+    }
+    if (recursive || Glob::hasWildcards(args[0])) {
+        std::vector<std::string> files;
+        if (!collectFiles(args[0], recursive, args.size() > 1 ? args[1] : "*", files)) return false;
+        return runBatch("Checksum", files, threads, [this](const std::string& file) { return checksumFile(file); });
+    }
+    bool success = checksumFile(std::string(args[0]));
+    std::cout << "\n";
+    return success;
+}
+
+bool FileManager::handleCpuInfo(Args&) {
+    showCpuInfo();
+    std::cout << "\n";
+    return true;
+}
+
+bool FileManager::handleMemInfo(Args&) {
+    {
+        std::lock_guard<std::mutex> lock(memoryMutex);
+        memoryManager.displayMemoryUsage();
+    }
+    std::cout << "\n"; // Add space after command output
+    return true;
+}
+
+bool FileManager::handleProcStatus(Args&) {
+    processManager.showStatus();
+    std::cout << "\n"; // Add space after command output
+    return true;
+}
+
+bool FileManager::handleJobs(Args&) {
+    processManager.showJobs();
+    std::cout << "\n";
+    return true;
+}
+
+namespace {
+    bool parseProcessId(std::string_view text, int& id) {
+        auto result = std::from_chars(text.data(), text.data() + text.size(), id);
+        return result.ec == std::errc() && result.ptr == text.data() + text.size() && id > 0;
+    }
+}
+
+// "wait <id>" succeeds if that job completed; "wait" waits for every job and succeeds
+// if none of them failed or was killed.
+bool FileManager::handleWait(Args& args) {
+    if (args.empty()) {
+        size_t unsuccessful = processManager.waitAll();
+        if (unsuccessful > 0) std::cerr << unsuccessful << " of the jobs waited for did not complete.\n";
+        std::cout << "\n";
+        return unsuccessful == 0;
+    }
+    int id;
+    if (!parseProcessId(args[0], id)) {
+        std::cout << "Usage: wait [<id>]\n\n";
+        return false;
+    }
+    ProcessStatus status;
+    if (!processManager.wait(id, status)) {
+        std::cerr << "Error: No process with ID " << id << ".\n\n";
+        return false;
+    }
+    std::cout << "\n";
+    return status == ProcessStatus::Completed;
+}
+
+bool FileManager::handleKill(Args& args) {
+    int id;
+    if (args.empty() || !parseProcessId(args[0], id)) {
+        std::cout << "Usage: kill <id>\n\n";
+        return false;
+    }
+    if (!processManager.cancel(id)) {
+        std::cerr << "Error: No unfinished background job with ID " << id << ".\n\n";
+        return false;
+    }
+    std::cout << "Asked job " << id << " to stop.\n\n";
+    return true;
+}
+
+bool FileManager::handleClearCompleted(Args&) {
+    processManager.clearCompleted();
+    std::cout << "\n"; // Add space after command output
+    return true;
+}
+
+bool FileManager::handleClearAll(Args&) {
+    processManager.clearAll();
+    std::cout << "\n"; // Add space after command output
+    return true;
+}
+
+bool FileManager::handleClear(Args&) {
+    clearConsole();
+    return true;
+}
+
+// Ends the interactive loop or a batch; the caller decides how to wind down.
+bool FileManager::handleExit(Args&) {
+    exiting = true;
+    return true;
+}
+
+// --- Batches ---
+// "-r <dir> [pattern]" and operands with wildcards turn compress, decompress, encrypt,
+// decrypt and checksum into batches: one task per file on a work-stealing pool, the
+// largest files first, each file a child process of the batch's own.
+namespace {
+    // "1.5 GiB", formatted apart from std::cout's flags (jobs share the stream).
+    std::string formatBytes(double bytes) {
+        static const char* const units[] = { "B", "KiB", "MiB", "GiB", "TiB" };
+        int unit = 0;
+        while (bytes >= 1024 && unit < 4) {
+            bytes /= 1024;
+            ++unit;
         }
-        else {
-            std::string filename = args[0];
-            // Check if file exists before decompressing
-            bool fileExists = fs::exists(filename);
+        char text[32];
+        std::snprintf(text, sizeof(text), unit == 0 ? "%.0f %s" : "%.1f %s", bytes, units[unit]);
+        return text;
+    }
+}
 
-            // Add process task early
-            processId = addProcessTask("Decompress File: " + filename);
+bool FileManager::collectFiles(std::string_view operand, bool recursive, std::string_view namePattern,
+                               std::vector<std::string>& files) {
+    std::string error;
+    bool ok = recursive ? Glob::walk(std::string(operand), std::string(namePattern), files, error)
+                        : Glob::expand(std::string(operand), files, error);
+    if (!ok) {
+        std::cerr << "Error: " << error << ".\n\n";
+        return false;
+    }
+    if (files.empty()) {
+        std::cerr << "Error: No files match '" << operand;
+        if (recursive) std::cerr << "' with '" << namePattern;
+        std::cerr << "'.\n\n";
+        return false;
+    }
+    return true;
+}
 
-            // --- Execute command logic ---
-            if (!fileExists) {
-                std::cerr << "Error: File '" << filename << "' does not exist. Cannot decompress.\n";
-                processManager.updateProcessStatus(processId, ProcessStatus::Failed); // Mark as failed
-            }
-            else {
-                // decompress calls Compression::decompressFile which returns bool
-                bool success = decompress(filename);
-                if (success) {
-                    processManager.updateProcessStatus(processId, ProcessStatus::Completed);
-                }
-                else {
-                    processManager.updateProcessStatus(processId, ProcessStatus::Failed);
+bool FileManager::runBatch(const std::string& verb, const std::vector<std::string>& files, unsigned threads,
+                           const std::function<bool(const std::string&)>& operation) {
+    if (threads == 0) threads = ThreadPool::hardwareThreads();
+
+    // Largest first: the big files start early, and the small ones fill in around them.
+    struct Item {
+        const std::string* path;
+        uint64_t size;
+        int processId;
+    };
+    std::vector<Item> items;
+    items.reserve(files.size());
+    uint64_t totalSize = 0;
+    for (const std::string& file : files) {
+        uint64_t size = StatCache::get().lookup(file).size;
+        items.push_back({ &file, size, 0 });
+        totalSize += size;
+    }
+    std::stable_sort(items.begin(), items.end(), [](const Item& a, const Item& b) { return a.size > b.size; });
+
+    int batchId = addProcessTask(verb + " batch: " + std::to_string(files.size()) + " files");
+    for (Item& item : items) item.processId = processManager.addChild(batchId, *item.path);
+
+    // Pool threads do not inherit the job's cancellation flag, so each task installs it.
+    const std::atomic<bool>* cancel = Cancellation::flag();
+    std::atomic<size_t> failed{ 0 }, skipped{ 0 };
+    std::atomic<uint64_t> doneBytes{ 0 };
+    auto start = std::chrono::steady_clock::now();
+    {
+        WorkStealingPool pool(threads);
+        for (const Item& item : items) {
+            pool.submit([&, item] {
+                Cancellation::Scope scope(cancel);
+                if (Cancellation::requested()) {
+                    processManager.updateProcessStatus(item.processId, ProcessStatus::Cancelled);
+                    ++skipped;
+                    return;
                 }
-            }
-            // --- End of command logic ---
-            std::cout << "\n"; // Add space after command output
+                processManager.updateProcessStatus(item.processId, ProcessStatus::Running);
+                bool ok = operation(*item.path);
+                processManager.updateProcessStatus(item.processId, ok ? ProcessStatus::Completed : ProcessStatus::Failed);
+                if (ok) doneBytes += item.size;
+                else ++failed;
+            });
         }
+        pool.wait();
     }
-    else if (command == "encrypt") {
-        if (args.size() < 3) {
-            std::cout << "Usage: encrypt <algorithm_number> <filename> <key>\n";
-            std::cout << "Available algorithms: 1:Caesar, 2:XOR, 3:Vigenere, 4:RailFence\n\n"; // Add space to usage
-        }
-        else {
-            std::string algorithm_number = args[0];
-            std::string filename = args[1];
-            std::string key = args[2];
-            std::string algorithm_name;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t succeeded = files.size() - failed - skipped;
+    char rates[96];
+    std::snprintf(rates, sizeof(rates), "%.2f s (%s/s, %.1f files/s)", seconds,
+                  formatBytes(seconds > 0 ? doneBytes / seconds : 0).c_str(), seconds > 0 ? succeeded / seconds : 0.0);
+    std::cout << verb << " batch: " << succeeded << " of " << files.size() << " files (" << formatBytes((double)totalSize)
+              << ") in " << rates << " on " << threads << (threads == 1 ? " thread" : " threads");
+    if (failed > 0) std::cout << "; " << failed << " failed";
+    if (skipped > 0) std::cout << "; " << skipped << " cancelled";
+    std::cout << "\n\n";
+    return finishTask(batchId, failed == 0 && skipped == 0);
+}
 
-            if (algorithm_number == "1") {
-                algorithm_name = "caesar";
-            }
-            else if (algorithm_number == "2") {
-                algorithm_name = "xor";
-            }
-            else if (algorithm_number == "3") {
-                algorithm_name = "vigenere";
-            }
-            else if (algorithm_number == "4") {
-                algorithm_name = "railfence";
-            }
-            else {
-                std::cerr << "Invalid algorithm number. Please use 1, 2, 3, or 4.\n\n"; // Add space to error
-                // No process added for invalid algorithm number, so no status update needed
-                return;
-            }
-            // Add process task early
-            processId = addProcessTask("Encrypt File: " + filename + " (" + algorithm_name + ")");
-
-            // --- Check if file exists before encrypting ---
-            if (!fs::exists(filename)) {
-                std::cerr << "Error: File '" << filename << "' does not exist. Cannot encrypt.\n";
-                processManager.updateProcessStatus(processId, ProcessStatus::Failed); // Mark as failed
-                std::cout << "\n"; // Add space after command output
-                return;
-            }
-            // --- End of check ---
+// --- Directory trees ---
+// du, tree and find walk the tree with DirectoryWalker and print from the finished,
+// sorted tree, so the output does not depend on which thread read what. Output is
+// collected in a string and written in large pieces: a tree can have millions of lines.
+namespace {
+    const size_t OUTPUT_CHUNK = 64 * 1024;
 
-            // Execute command logic
-            bool success = Encryption::encryptFile(algorithm_name, filename, key);
-            if (success) {
-                processManager.updateProcessStatus(processId, ProcessStatus::Completed);
-            }
-            else {
-                processManager.updateProcessStatus(processId, ProcessStatus::Failed);
-            }
+    bool parseUnsigned(const std::string& text, unsigned& value) {
+        auto parsed = std::from_chars(text.data(), text.data() + text.size(), value);
+        return !text.empty() && parsed.ec == std::errc() && parsed.ptr == text.data() + text.size();
+    }
 
-            std::cout << "\n"; // Add space after command output
+    void flushOutput(std::string& out, bool force) {
+        if (out.size() >= OUTPUT_CHUNK || (force && !out.empty())) {
+            std::cout.write(out.data(), (std::streamsize)out.size());
+            out.clear();
         }
     }
-    else if (command == "decrypt") {
-        if (args.size() < 3) {
-            std::cout << "Usage: decrypt <algorithm_number> <filename> <key>\n";
-            std::cout << "Available algorithms: 1:Caesar, 2:XOR, 3:Vigenere, 4:RailFence\n\n"; // Add space to usage
-        }
-        else {
-            std::string algorithm_number = args[0];
-            std::string filename = args[1];
-            std::string key = args[2];
-            std::string algorithm_name;
 
-            if (algorithm_number == "1") {
-                algorithm_name = "caesar";
-            }
-            else if (algorithm_number == "2") {
-                algorithm_name = "xor";
-            }
-            else if (algorithm_number == "3") {
-                algorithm_name = "vigenere";
-            }
-            else if (algorithm_number == "4") {
-                algorithm_name = "railfence";
-            }
-            else {
-                std::cerr << "Invalid algorithm number. Please use 1, 2, 3, or 4.\n\n"; // Add space to error
-                // No process added for invalid algorithm number, so no status update needed
-                return;
-            }
-            // Add process task early
-            processId = addProcessTask("Decrypt File: " + filename + " (" + algorithm_name + ")");
-
-            // --- Check if file exists before decrypting ---
-            if (!fs::exists(filename)) {
-                std::cerr << "Error: File '" << filename << "' does not exist. Cannot decrypt.\n";
-                processManager.updateProcessStatus(processId, ProcessStatus::Failed); // Mark as failed
-                std::cout << "\n"; // Add space after command output
-                return;
-            }
-            // --- End of check ---
-            // Execute command logic
-            // Encryption::decryptFile also has an internal check for the .enc suffix
-            bool success = Encryption::decryptFile(algorithm_name, filename, key);
-            if (success) {
-                processManager.updateProcessStatus(processId, ProcessStatus::Completed);
-            }
-            else {
-                processManager.updateProcessStatus(processId, ProcessStatus::Failed);
-            }
-            std::cout << "\n"; // Add space after command output
+    std::string describeWalk(const DirectoryWalker::Stats& stats) {
+        char text[160];
+        std::snprintf(text, sizeof(text), "walked %llu directories, %llu entries in %.2f s on %u %s",
+                      (unsigned long long)stats.directories, (unsigned long long)stats.entries, stats.seconds,
+                      stats.threads, stats.threads == 1 ? "thread" : "threads");
+        std::string result = text;
+        if (stats.errors > 0) result += "; " + std::to_string(stats.errors) + " could not be read";
+        return result;
+    }
+
+    // Post-order: every directory's bytes and files grow to cover its whole subtree.
+    void addSubtrees(DirectoryWalker::Node& node) {
+        for (auto& child : node.subdirectories) {
+            addSubtrees(*child);
+            node.bytes += child->bytes;
+            node.files += child->files;
         }
     }
-    else if (command == "alloc") {
-        if (args.size() < 2) {
-            std::cout << "Usage: alloc <filename> <sizeKB>\n\n"; // Add space to usage
+
+    void printUsage(const DirectoryWalker::Node& node, unsigned maxDepth, std::string& out) {
+        if (node.depth < maxDepth) {
+            for (const auto& child : node.subdirectories) printUsage(*child, maxDepth, out);
         }
-        else {
-            std::string filename = args[0];
-            // Check if file exists before allocating
-            bool fileExists = fs::exists(filename);
+        char size[48];
+        std::snprintf(size, sizeof(size), "%12s %10llu  ", formatBytes((double)node.bytes).c_str(), (unsigned long long)node.files);
+        out += size;
+        out += node.path;
+        out += '\n';
+        flushOutput(out, false);
+    }
 
-            // Add process task early
-            processId = addProcessTask("Allocate Memory: " + filename + " (" + args[1] + "KB)");
+    // Subdirectories and kept entries of `node` in one name order.
+    template <typename Visit>
+    void forEachChild(const DirectoryWalker::Node& node, Visit visit) {
+        size_t d = 0, k = 0;
+        while (d < node.subdirectories.size() || k < node.kept.size()) {
+            bool takeDirectory = k == node.kept.size() ||
+                                 (d < node.subdirectories.size() && node.subdirectories[d]->name < node.kept[k].name);
+            const DirectoryWalker::Node* directory = takeDirectory ? node.subdirectories[d++].get() : nullptr;
+            const DirectoryWalker::Entry* entry = takeDirectory ? nullptr : &node.kept[k++];
+            visit(directory, entry, d == node.subdirectories.size() && k == node.kept.size());
+        }
+    }
 
-            // --- Execute command logic ---
-            if (!fileExists) {
-                std::cerr << "Error: File '" << filename << "' does not exist. Cannot allocate memory.\n";
-                processManager.updateProcessStatus(processId, ProcessStatus::Failed); // Mark as failed
+    void printTree(const DirectoryWalker::Node& node, std::string& prefix, std::string& out) {
+        forEachChild(node, [&](const DirectoryWalker::Node* directory, const DirectoryWalker::Entry* entry, bool last) {
+            out += prefix;
+            out += last ? "`-- " : "|-- ";
+            out += directory != nullptr ? directory->name : entry->name;
+            if (directory != nullptr) out += '/';
+            else if (entry->type == DirectoryWalker::Type::Symlink) out += '@';
+            out += '\n';
+            flushOutput(out, false);
+            if (directory != nullptr) {
+                prefix += last ? "    " : "|   ";
+                printTree(*directory, prefix, out);
+                prefix.resize(prefix.size() - 4);
             }
-            else {
-                try {
-                    int sizeKB = std::stoi(args[1]);
-                    memoryManager.allocate(filename, sizeKB); // Call allocate on the member variable
-                    // memoryManager.allocate prints success/failure messages related to allocation logic
-                    // We need to check the result of allocate to determine process status more accurately
-                    // For now, we'll assume if file exists and size is valid, it attempts allocation.
-                    // A more robust MM::allocate would return bool.
-                    processManager.updateProcessStatus(processId, ProcessStatus::Completed); // Assuming success if file exists and size is valid
-                }
-                catch (const std::invalid_argument) {
-                    std::cerr << "Error: Invalid size. Please provide an integer value for sizeKB.\n";
-                    processManager.updateProcessStatus(processId, ProcessStatus::Failed); // Mark as failed
-                }
-                catch (const std::out_of_range) {
-                    std::cerr << "Error: Size value out of range for integer conversion.\n";
-                    processManager.updateProcessStatus(processId, ProcessStatus::Failed); // Mark as failed
-                }
-            }
-            // --- End of command logic ---
-            std::cout << "\n"; // Add space after command output
-        }
+        });
     }
-    else if (command == "dealloc") {
-        if (args.empty()) {
-            std::cout << "Usage: dealloc <filename>\n\n"; // Add space to usage
+
+    // The predicates of find; each one that is set must hold.
+    struct FindFilter {
+        std::string name;           // glob pattern for the last path component
+        char type = 0;              // 'f', 'd', 'l' or 0 for any
+        int sizeSign = 0;           // -1 smaller than, 0 exactly, +1 larger than `size`
+        uint64_t size = 0;
+        bool bySize = false;
+        int ageSign = 0;            // as sizeSign, in whole days since the last change
+        int64_t days = 0;
+        bool byAge = false;
+        int64_t now = 0;
+
+        bool needsStat() const { return bySize || byAge; }
+
+        bool matches(const DirectoryWalker::Entry& entry) const {
+            if (!name.empty() && !Glob::match(name, entry.name)) return false;
+            if (type == 'f' && entry.type != DirectoryWalker::Type::File) return false;
+            if (type == 'd' && entry.type != DirectoryWalker::Type::Directory) return false;
+            if (type == 'l' && entry.type != DirectoryWalker::Type::Symlink) return false;
+            if (bySize && !compare(sizeSign, entry.size, size)) return false;
+            if (byAge && !compare(ageSign, (uint64_t)std::max<int64_t>(0, (now - entry.mtime) / 86400), (uint64_t)days)) return false;
+            return true;
         }
-        else {
-            std::string filename = args[0];
-            // Check if file exists before deallocating
-            bool fileExists = fs::exists(filename);
 
-            // Add process task early
-            processId = addProcessTask("Deallocate Memory: " + filename);
+        static bool compare(int sign, uint64_t value, uint64_t limit) {
+            return sign > 0 ? value > limit : sign < 0 ? value < limit : value == limit;
+        }
+    };
+
+    // "[+|-]N" with an optional k, M or G (powers of 1024) when `units` is set.
+    bool parseBound(const std::string& text, bool units, int& sign, uint64_t& value) {
+        std::string digits = text;
+        sign = 0;
+        if (!digits.empty() && (digits[0] == '+' || digits[0] == '-')) {
+            sign = digits[0] == '+' ? 1 : -1;
+            digits.erase(0, 1);
+        }
+        uint64_t scale = 1;
+        if (units && !digits.empty()) {
+            char unit = digits.back();
+            if (unit == 'k' || unit == 'K') scale = (uint64_t)1 << 10;
+            else if (unit == 'M') scale = (uint64_t)1 << 20;
+            else if (unit == 'G') scale = (uint64_t)1 << 30;
+            if (scale != 1) digits.pop_back();
+        }
+        auto parsed = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+        if (digits.empty() || parsed.ec != std::errc() || parsed.ptr != digits.data() + digits.size()) return false;
+        value *= scale;
+        return true;
+    }
 
-            // --- Execute command logic ---
-            if (!fileExists) {
-                std::cerr << "Error: File '" << filename << "' does not exist. Cannot deallocate memory.\n";
-                processManager.updateProcessStatus(processId, ProcessStatus::Failed); // Mark as failed
+    void printMatches(const DirectoryWalker::Node& node, std::string& out, uint64_t& count) {
+        forEachChild(node, [&](const DirectoryWalker::Node* directory, const DirectoryWalker::Entry* entry, bool) {
+            if (entry != nullptr) {
+                out += node.path == "." ? entry->name : node.path + "/" + entry->name;
+                out += '\n';
+                ++count;
+                flushOutput(out, false);
             }
             else {
-                // memoryManager.deallocate is silent if no allocation exists.
-                // It doesn't return a status. We'll assume success if the file exists.
-                memoryManager.deallocate(filename);
-                processManager.updateProcessStatus(processId, ProcessStatus::Completed); // Assuming success if file exists
+                printMatches(*directory, out, count);
             }
-            // --- End of command logic ---
-            std::cout << "\n"; // Add space after command output
+        });
+    }
+}
+
+bool FileManager::handleDu(Args& args) {
+    unsigned threads = 0;
+    std::string depthText;
+    bool summary = extractFlag(args, "-s");
+    if (!extractThreadCount(args, threads) || !extractOption(args, "-d", depthText)) {
+        std::cerr << "Error: -j and -d expect a number.\n\n";
+        return false;
+    }
+    unsigned maxDepth = summary ? 0 : UINT_MAX;
+    if (!depthText.empty() && !parseUnsigned(depthText, maxDepth)) {
+        std::cout << "Usage: du [-j N] [-d depth | -s] [dir]\n\n";
+        return false;
+    }
+    std::string root = args.empty() ? "." : std::string(args[0]);
+
+    DirectoryWalker::Options options;
+    options.threads = threads;
+    options.stat = true;
+    DirectoryWalker::Stats stats;
+    std::string error;
+    auto tree = DirectoryWalker::walk(root, options, [](DirectoryWalker::Node& node, std::vector<DirectoryWalker::Entry>& entries) {
+        for (const auto& entry : entries) {
+            if (entry.type == DirectoryWalker::Type::Directory) continue;
+            node.bytes += entry.size;
+            node.files++;
         }
+    }, stats, error);
+    if (tree == nullptr) {
+        std::cerr << "Error: Cannot read directory '" << root << "': " << error << ".\n\n";
+        return false;
     }
-    else if (command == "meminfo") {
-        memoryManager.displayMemoryUsage();
-        std::cout << "\n"; // Add space after command output
+    if (stats.cancelled) {
+        std::cerr << "du of '" << root << "' cancelled.\n\n";
+        return false;
     }
-    else if (command == "procstatus") { // New command to show process status
-        processManager.showStatus();
-        std::cout << "\n"; // Add space after command output
+    addSubtrees(*tree);
+    DirectoryWalker::sort(*tree);
+
+    std::string out = "        size      files  directory\n";
+    printUsage(*tree, maxDepth, out);
+    flushOutput(out, true);
+    std::cout << "(" << describeWalk(stats) << ")\n\n";
+    return stats.errors == 0;
+}
+
+bool FileManager::handleTree(Args& args) {
+    unsigned threads = 0;
+    std::string depthText;
+    if (!extractThreadCount(args, threads) || !extractOption(args, "-d", depthText)) {
+        std::cerr << "Error: -j and -d expect a number.\n\n";
+        return false;
     }
-    else if (command == "clearcp") { // New command to clear completed processes
-        processManager.clearCompleted();
-        std::cout << "\n"; // Add space after command output
+    unsigned levels = UINT_MAX;
+    if (!depthText.empty() && (!parseUnsigned(depthText, levels) || levels == 0)) {
+        std::cout << "Usage: tree [-j N] [-d levels] [dir]\n\n";
+        return false;
     }
-    else if (command == "clearallp") { // New command to clear all processes
-        processManager.clearAll();
-        std::cout << "\n"; // Add space after command output
+    std::string root = args.empty() ? "." : std::string(args[0]);
+
+    DirectoryWalker::Options options;
+    options.threads = threads;
+    options.maxDepth = levels - 1;
+    DirectoryWalker::Stats stats;
+    std::string error;
+    std::atomic<uint64_t> files{ 0 };
+    auto tree = DirectoryWalker::walk(root, options, [&files](DirectoryWalker::Node& node, std::vector<DirectoryWalker::Entry>& entries) {
+        for (auto& entry : entries) {
+            if (entry.type == DirectoryWalker::Type::Directory) continue;
+            node.kept.push_back(std::move(entry));
+        }
+        files += node.kept.size();
+    }, stats, error);
+    if (tree == nullptr) {
+        std::cerr << "Error: Cannot read directory '" << root << "': " << error << ".\n\n";
+        return false;
+    }
+    if (stats.cancelled) {
+        std::cerr << "tree of '" << root << "' cancelled.\n\n";
+        return false;
     }
+    DirectoryWalker::sort(*tree);
+
+    std::string out = root + "\n";
+    std::string prefix;
+    printTree(*tree, prefix, out);
+    flushOutput(out, true);
+    std::cout << "\n" << stats.directories - 1 << " directories, " << files << " files (" << describeWalk(stats) << ")\n\n";
+    return stats.errors == 0;
+}
 
-    else if (command == "clear") {
-        clearConsole();
+bool FileManager::handleFind(Args& args) {
+    unsigned threads = 0;
+    FindFilter filter;
+    std::string typeText, sizeText, ageText;
+    if (!extractThreadCount(args, threads) || !extractOption(args, "-name", filter.name) ||
+        !extractOption(args, "-type", typeText) || !extractOption(args, "-size", sizeText) ||
+        !extractOption(args, "-mtime", ageText)) {
+        std::cerr << "Error: -j, -name, -type, -size and -mtime each expect a value.\n\n";
+        return false;
     }
-    else if (command == "exit") {
-        std::exit(0);
+    uint64_t days = 0;
+    bool ok = args.size() <= 1 && (typeText.empty() || (typeText.size() == 1 && std::strchr("fdl", typeText[0]) != nullptr));
+    if (ok && !sizeText.empty()) ok = filter.bySize = parseBound(sizeText, true, filter.sizeSign, filter.size);
+    if (ok && !ageText.empty()) ok = filter.byAge = parseBound(ageText, false, filter.ageSign, days);
+    if (!ok) {
+        std::cout << "Usage: find [-j N] [dir] [-name pattern] [-type f|d|l] [-size [+|-]N[k|M|G]] [-mtime [+|-]days]\n\n";
+        return false;
     }
-    else {
-        std::cout << "Unknown command. Type 'help' for available commands.\n\n"; // Add space to unknown command
+    filter.type = typeText.empty() ? 0 : typeText[0];
+    filter.days = (int64_t)days;
+    filter.now = (int64_t)std::chrono::duration_cast<std::chrono::seconds>(
+                     std::chrono::system_clock::now().time_since_epoch()).count();
+    std::string root = args.empty() ? "." : std::string(args[0]);
+
+    DirectoryWalker::Options options;
+    options.threads = threads;
+    options.stat = filter.needsStat();
+    DirectoryWalker::Stats stats;
+    std::string error;
+    auto tree = DirectoryWalker::walk(root, options, [&filter](DirectoryWalker::Node& node, std::vector<DirectoryWalker::Entry>& entries) {
+        for (auto& entry : entries) {
+            if (filter.matches(entry)) node.kept.push_back(std::move(entry));
+        }
+    }, stats, error);
+    if (tree == nullptr) {
+        std::cerr << "Error: Cannot read directory '" << root << "': " << error << ".\n\n";
+        return false;
+    }
+    if (stats.cancelled) {
+        std::cerr << "find in '" << root << "' cancelled.\n\n";
+        return false;
     }
+    DirectoryWalker::sort(*tree);
+
+    // The paths are the command's output; the summary goes to stderr so it can be piped.
+    std::string out;
+    uint64_t count = 0;
+    printMatches(*tree, out, count);
+    flushOutput(out, true);
+    std::cerr << count << (count == 1 ? " match (" : " matches (") << describeWalk(stats) << ")\n\n";
+    return stats.errors == 0;
 }
 
 void FileManager::showHelp() {
     std::cout << "Available Commands:\n";
     std::cout << "  help                           - Show this help menu\n";
-    std::cout << "  list                           - List files and directories\n";
+    std::cout << "  list [--sort=name|size|mtime] [--filter P] [--limit N] [--offset N] [--long] [dir]\n";
+    std::cout << "                                 - List files and directories (size and mtime: largest/newest first)\n";
     std::cout << "  mkdir <dir>                    - Create a new directory\n";
     std::cout << "  rm <file/dir>                  - Delete a file or directory\n";
-    std::cout << "  add <filepath>                 - Add file to working directory\n";
+    std::cout << "  add [-j N] <file|dir|pattern>... - Copy files (directories with their contents) into the\n";
+    std::cout << "                                   working directory, -j N at a time; reflink or in-kernel\n";
+    std::cout << "                                   copy where the file system allows it\n";
     std::cout << "  touch <file>                   - Create a new empty file\n";
     std::cout << "  read <filename>                - Read and display file content\n";
+    std::cout << "  read --offset X --len N <file> - Display N bytes from byte X; compressed files decode\n";
+    std::cout << "                                   only the blocks covering the range\n";
     std::cout << "  write <filename>               - Write content to an existing file\n"; // Updated help for write
     std::cout << "  open <filename>                - Open a file using the default application\n";
-    std::cout << "  compress <file>                - Compress a text file using RLE\n";
-    std::cout << "  decompress <file>              - Decompress an RLE-compressed file\n";
-    std::cout << "  encrypt <algo> <file> <key>    - Encrypt a file using algorithm\n";
-    std::cout << "  decrypt <algo> <file> <key>    - Decrypt a file using algorithm\n";
+    std::cout << "  compress [-j N] [--codec=C] <file> - Compress a file (writes <name>_compressed.bin)\n";
+    std::cout << "                                   C: store, rle, lz, huff, rle+huff or auto (default: pick from a sample)\n";
+    std::cout << "  decompress [-j N] <file>       - Decompress a _compressed.bin (or legacy _compressed.txt) file\n";
+    std::cout << "                                   -j N spreads the blocks over N threads\n";
+    std::cout << "  encrypt [-j N] <algo> <file> <key> - Encrypt a file using algorithm\n";
+    std::cout << "  decrypt [-j N] <algo> <file> <key> - Decrypt a file using algorithm\n";
+    std::cout << "                                   -j N spreads the work over N threads\n";
+    std::cout << "                                   --inplace rewrites the file itself (not Rail Fence); an\n";
+    std::cout << "                                   interrupted run resumes when run again, --rollback undoes it\n";
+    std::cout << "  Batches: compress, decompress, encrypt, decrypt and checksum also take a pattern\n";
+    std::cout << "           ('logs/*.txt', 'data/**') or -r <dir> [pattern] in place of <file>, and run\n";
+    std::cout << "           the files in parallel (-j N files at a time, default one per CPU)\n";
+    std::cout << "  pack [-j N] [--codec=C] [--cipher=Y --key=K] [-o out] <file>\n";
+    std::cout << "                                 - Compress and encrypt in one pass (writes <file>.pack)\n";
+    std::cout << "                                   Y: none (default), caesar, xor, vigenere, chacha20 or 1/2/3/5\n";
+    std::cout << "  unpack [-j N] [--key=K] [-o out] <file.pack> - Decrypt and decompress a .pack file\n";
+    std::cout << "                                   '-' as file or out means stdin/stdout, e.g. from a shell:\n";
+    std::cout << "                                   fms pack - --cipher=chacha20 --key=K < in | fms unpack - --key=K\n";
     std::cout << "  alloc <file> <sizeKB>          - Allocate memory to an existing file\n"; // Updated help for alloc
     std::cout << "  dealloc <file>                 - Deallocate memory from an existing file\n"; // Updated help for dealloc
+    std::cout << "  checksum <file>                - Print the CRC-32C of a file\n";
+    std::cout << "  du [-j N] [-d depth | -s] [dir] - Size and file count of every directory below dir\n";
+    std::cout << "  tree [-j N] [-d levels] [dir]  - Show the directory tree\n";
+    std::cout << "  find [-j N] [dir] [-name P] [-type f|d|l] [-size [+|-]N[k|M|G]] [-mtime [+|-]days]\n";
+    std::cout << "                                 - List the entries below dir that match every test given\n";
+    std::cout << "                                   (du, tree and find read directories on -j N threads)\n";
+    std::cout << "  cpuinfo                        - Show CPU features and the kernel variants in use\n";
+    std::cout << "                                   (FMS_FORCE_SCALAR=1 in the environment forces scalar)\n";
     std::cout << "  meminfo                        - Show memory usage and allocations\n";
     std::cout << "  procstatus                     - Show the status of background processes\n"; // Added help for process status
+    std::cout << "  jobs                           - List the background jobs still queued or running\n";
+    std::cout << "  wait [<id>]                    - Wait for a background job (or all of them) to finish\n";
+    std::cout << "  kill <id>                      - Stop a background job at its next checkpoint\n";
+    std::cout << "  <command> &                    - Run the command as a background job and return at once\n";
     std::cout << "  clearcp                        - Clear completed processes from the queue\n"; // Added help for clear completed processes
     std::cout << "  clearallp                      - Clear all processes from the queue\n"; // Added help for clear all processes
     std::cout << "  clear                          - Clears the Console\n";
     std::cout << "  exit                           - Exit the CLI\n";
+    std::cout << "  Batch mode: fms --script <file|-> [--stop-on-error | --continue-on-error]\n";
+    std::cout << "                                   runs one command per line ('#' starts a comment) and\n";
+    std::cout << "                                   lists the failed ones at the end; piping commands into\n";
+    std::cout << "                                   fms does the same\n";
     std::cout << "    Available algorithms:\n";
     std::cout << "      1: Caesar\n";
     std::cout << "      2: XOR\n";
     std::cout << "      3: Vigenere\n";
     std::cout << "      4: Rail Fence\n";
+    std::cout << "      5: ChaCha20 (key is a passphrase; the only one of the five fit for real data)\n";
     std::cout << "\n"; // Add space after help
 }
 
-void FileManager::listFiles() {
-    // Error handling for directory_iterator in case current_path() is not accessible
-    try {
-        for (const auto& entry : fs::directory_iterator(fs::current_path())) {
-            if (entry.is_directory()) {
-                std::cout << "[DIR]  " << entry.path().filename().string() << '\n';
+// --- Listing ---
+// list reads the directory in one pass into a struct of arrays (the names back to back
+// in one buffer), so a million entries cost a few large allocations rather than a
+// million small ones, and sorting moves 4-byte indices instead of entries. With
+// --limit only the rows asked for are put in order.
+namespace {
+    struct Listing {
+        std::string names;
+        std::vector<uint32_t> nameEnd;  // name i is [nameEnd[i - 1], nameEnd[i]) of `names`
+        std::vector<uint8_t> types;     // DirectoryWalker::Type
+        std::vector<uint64_t> sizes;
+        std::vector<int64_t> mtimes;
+
+        size_t size() const { return types.size(); }
+
+        std::string_view name(size_t i) const {
+            size_t begin = i == 0 ? 0 : nameEnd[i - 1];
+            return std::string_view(names.data() + begin, nameEnd[i] - begin);
+        }
+
+        void add(const DirectoryWalker::Entry& entry) {
+            names += entry.name;
+            nameEnd.push_back((uint32_t)names.size());
+            types.push_back((uint8_t)entry.type);
+            sizes.push_back(entry.size);
+            mtimes.push_back(entry.mtime);
+        }
+    };
+
+    // A row of the listing as it is sorted: by `primary`, then `prefix`, then the name.
+    struct ListRow {
+        uint64_t primary = 0;
+        uint64_t prefix = 0;
+        uint32_t index = 0;
+    };
+
+    // "2026-10-18 14:05", reusing the previous text while the minute stays the same.
+    struct TimeFormatter {
+        int64_t minute = INT64_MIN;
+        char text[32] = "";
+
+        const char* format(int64_t seconds) {
+            if (seconds / 60 == minute) return text;
+            minute = seconds / 60;
+            std::time_t t = (std::time_t)seconds;
+            std::tm local{};
+#if defined(_WIN32)
+            localtime_s(&local, &t);
+#else
+            localtime_r(&t, &local);
+#endif
+            std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M", &local);
+            return text;
+        }
+    };
+
+    const char* typeMarker(uint8_t type) {
+        switch ((DirectoryWalker::Type)type) {
+        case DirectoryWalker::Type::Directory: return "[DIR]  ";
+        case DirectoryWalker::Type::Symlink: return "[LNK]  ";
+        default: return "       ";
+        }
+    }
+}
+
+bool FileManager::listFiles(const ListOptions& options) {
+    bool needStat = options.longFormat || options.sort != ListOptions::Sort::Name;
+    DirectoryWalker::Options walk;
+    walk.threads = 1;
+    walk.stat = needStat;
+    walk.maxDepth = 0;
+    DirectoryWalker::Stats stats;
+    std::string error;
+    Listing listing;
+    auto root = DirectoryWalker::walk(options.directory, walk, [&](DirectoryWalker::Node&, std::vector<DirectoryWalker::Entry>& entries) {
+        size_t nameBytes = 0;
+        for (const auto& entry : entries) nameBytes += entry.name.size();
+        listing.names.reserve(nameBytes);
+        listing.nameEnd.reserve(entries.size());
+        listing.types.reserve(entries.size());
+        listing.sizes.reserve(entries.size());
+        listing.mtimes.reserve(entries.size());
+        for (const auto& entry : entries) {
+            if (options.filter.empty() || Glob::match(options.filter, entry.name)) listing.add(entry);
+        }
+    }, stats, error);
+    if (root == nullptr) {
+        std::cerr << "Error listing directory '" << options.directory << "': " << error << ".\n";
+        return false;
+    }
+
+    // Directories sort like files; size and time ties fall back to the name. Each row
+    // carries its sort value and 8 bytes of its name (after the prefix all names share)
+    // in order of significance, so most comparisons never reach the name buffer.
+    size_t common = listing.size() == 0 ? 0 : listing.name(0).size();
+    for (size_t i = 1; i < listing.size() && common > 0; ++i) {
+        std::string_view a = listing.name(0), b = listing.name(i);
+        size_t n = 0;
+        while (n < common && n < b.size() && a[n] == b[n]) ++n;
+        common = n;
+    }
+    std::vector<ListRow> order(listing.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        ListRow& row = order[i];
+        if (options.sort == ListOptions::Sort::Size) row.primary = ~listing.sizes[i];
+        else if (options.sort == ListOptions::Sort::Mtime) row.primary = ~((uint64_t)listing.mtimes[i] ^ ((uint64_t)1 << 63));
+        std::string_view name = listing.name(i);
+        for (size_t k = 0; k < 8; ++k) {
+            row.prefix = (row.prefix << 8) | (common + k < name.size() ? (unsigned char)name[common + k] : 0);
+        }
+        row.index = (uint32_t)i;
+    }
+    auto before = [&](const ListRow& a, const ListRow& b) {
+        if (a.primary != b.primary) return a.primary < b.primary;
+        if (a.prefix != b.prefix) return a.prefix < b.prefix;
+        return listing.name(a.index) < listing.name(b.index);
+    };
+    size_t first = (size_t)std::min<uint64_t>(options.offset, order.size());
+    size_t last = (size_t)std::min<uint64_t>(order.size() - first, options.limit) + first;
+    if (last < order.size()) std::partial_sort(order.begin(), order.begin() + last, order.end(), before);
+    else std::sort(order.begin(), order.end(), before);
+
+    std::string out;
+    out.reserve(OUTPUT_CHUNK + 512);
+    TimeFormatter time;
+    char columns[64];
+    for (size_t row = first; row < last; ++row) {
+        uint32_t i = order[row].index;
+        out += typeMarker(listing.types[i]);
+        if (options.longFormat) {
+            std::snprintf(columns, sizeof(columns), "%14llu  %s  ", (unsigned long long)listing.sizes[i], time.format(listing.mtimes[i]));
+            out += columns;
+        }
+        out += listing.name(i);
+        out += '\n';
+        flushOutput(out, false);
+    }
+    flushOutput(out, true);
+
+    if (last - first < listing.size() || listing.size() < stats.entries) {
+        if (last > first) std::cout << "(entries " << first + 1 << "-" << last << " of " << listing.size();
+        else std::cout << "(offset " << options.offset << " is past all " << listing.size() << " entries";
+        if (!options.filter.empty()) std::cout << " matching '" << options.filter << "', " << stats.entries << " in all";
+        std::cout << ")\n";
+    }
+    return true;
+}
+
+// --- Copies ---
+// "add" with several operands, a pattern or a directory copies everything into the
+// working directory as one batch: directories keep their structure below their own
+// name, and the files are copied -j N at a time by runBatch.
+namespace {
+    // Files below `node` (which is `relative` below the copied directory), and the
+    // directories their copies go into.
+    void collectTree(const DirectoryWalker::Node& node, const std::string& relative, const std::string& target,
+                     std::vector<std::string>& sources, std::vector<std::string>& destinations,
+                     std::vector<std::string>& directories, uint64_t& skipped) {
+        std::string into = relative.empty() ? target : target + "/" + relative;
+        directories.push_back(into);
+        for (const auto& entry : node.kept) {
+            if (entry.type != DirectoryWalker::Type::File) {
+                ++skipped;
+                continue;
             }
-            else {
-                std::cout << "       " << entry.path().filename().string() << '\n';
+            sources.push_back(node.path == "." ? entry.name : (node.path.back() == '/' ? node.path : node.path + "/") + entry.name);
+            destinations.push_back(into + "/" + entry.name);
+        }
+        for (const auto& child : node.subdirectories) {
+            collectTree(*child, relative.empty() ? child->name : relative + "/" + child->name, target, sources,
+                        destinations, directories, skipped);
+        }
+    }
+}
+
+bool FileManager::addFiles(const std::vector<std::string>& operands, unsigned threads) {
+    std::vector<std::string> sources, destinations, directories;
+    uint64_t skipped = 0;
+    std::error_code ec;
+    fs::path here = fs::current_path(ec);
+    for (const std::string& operand : operands) {
+        if (Glob::hasWildcards(operand)) {
+            std::vector<std::string> files;
+            std::string error;
+            if (!Glob::expand(operand, files, error)) {
+                std::cerr << "Error: " << error << ".\n\n";
+                return false;
             }
+            if (files.empty()) std::cerr << "Warning: No files match '" << operand << "'.\n";
+            for (std::string& file : files) {
+                destinations.push_back(fs::path(file).filename().string());
+                sources.push_back(std::move(file));
+            }
+            continue;
+        }
+        if (!StatCache::get().isDirectory(operand)) {
+            sources.push_back(operand);
+            destinations.push_back(fs::path(operand).filename().string());
+            continue;
         }
+
+        // A directory lands under its own name; one that already is the working directory,
+        // or holds it, would be copied into itself.
+        fs::path name = fs::path(operand).lexically_normal().filename();
+        if (name.empty()) name = fs::path(operand).lexically_normal().parent_path().filename();
+        fs::path canonical = fs::weakly_canonical(operand, ec);
+        std::string inside = canonical.string() + "/";
+        if (name.empty() || name == "." || name == ".." || fs::equivalent(operand, name, ec) ||
+            (here.string() + "/").compare(0, inside.size(), inside) == 0) {
+            std::cerr << "Error: '" << operand << "' is or contains the working directory.\n\n";
+            return false;
+        }
+        DirectoryWalker::Options options;
+        options.threads = threads;
+        DirectoryWalker::Stats stats;
+        std::string error;
+        auto tree = DirectoryWalker::walk(operand, options, [](DirectoryWalker::Node& node, std::vector<DirectoryWalker::Entry>& entries) {
+            for (auto& entry : entries) {
+                if (entry.type != DirectoryWalker::Type::Directory) node.kept.push_back(std::move(entry));
+            }
+        }, stats, error);
+        if (tree == nullptr || stats.cancelled || stats.errors > 0) {
+            if (tree == nullptr) std::cerr << "Error: Cannot read directory '" << operand << "': " << error << ".\n";
+            std::cerr << "Nothing was added.\n\n";
+            return false;
+        }
+        DirectoryWalker::sort(*tree);
+        collectTree(*tree, "", name.string(), sources, destinations, directories, skipped);
     }
-    catch (const fs::filesystem_error& e) {
-        std::cerr << "Error listing directory: " << e.what() << std::endl;
+
+    // Two sources with one destination would be written at the same time.
+    std::vector<std::string> unique = destinations;
+    std::sort(unique.begin(), unique.end());
+    auto clash = std::adjacent_find(unique.begin(), unique.end());
+    if (clash != unique.end()) {
+        std::cerr << "Error: More than one source would be copied to '" << *clash << "'. Nothing was added.\n\n";
+        return false;
+    }
+    if (sources.empty()) {
+        std::cerr << "Error: Nothing to add.\n\n";
+        return false;
     }
+    for (const std::string& directory : directories) {
+        if (!fs::create_directories(directory, ec) && ec) {
+            std::cerr << "Error: Cannot create directory '" << directory << "': " << ec.message() << ".\n\n";
+            return false;
+        }
+    }
+    std::unordered_map<std::string, std::string> destinationOf;
+    for (size_t i = 0; i < sources.size(); ++i) destinationOf.emplace(sources[i], destinations[i]);
+    if (skipped > 0) {
+        std::cout << skipped << (skipped == 1 ? " symbolic link or special file" : " symbolic links and special files")
+                  << " skipped.\n";
+    }
+
+    // Copies mostly wait on the disks or the network, so more are kept in flight than
+    // there are CPUs.
+    if (threads == 0) threads = std::max(4u, ThreadPool::hardwareThreads());
+    return runBatch("Add", sources, threads, [this, &destinationOf](const std::string& source) {
+        return addFile(source, destinationOf.at(source));
+    });
 }
 
-void FileManager::makeDirectory(const std::string& dirName) {
-    if (fs::create_directory(dirName)) {
+bool FileManager::makeDirectory(const std::string& dirName) {
+    std::error_code ec;
+    if (fs::create_directory(dirName, ec)) {
         std::cout << "Directory '" << dirName << "' created.\n";
+        return true;
     }
-    else {
-        std::cerr << "Failed to create directory '" << dirName << "' or it already exists.\n"; // Use cerr for errors
-    }
+    std::cerr << "Failed to create directory '" << dirName << "' or it already exists.\n"; // Use cerr for errors
+    return false;
 }
 
-void FileManager::remove(const std::string& name) {
+bool FileManager::remove(const std::string& name) {
     try {
         fs::path target = fs::current_path() / name;
 
         // Attempt to deallocate memory before removing the file from the filesystem
         // MM::deallocate handles if no memory was allocated, so it's safe to call.
-        bool wasAllocated = memoryManager.hasAllocation(name);
-        memoryManager.deallocate(name);
+        bool wasAllocated;
+        {
+            std::lock_guard<std::mutex> lock(memoryMutex);
+            wasAllocated = memoryManager.hasAllocation(name);
+            memoryManager.deallocate(name);
+        }
 
         // If memory was allocated, print a confirmation message
         if (wasAllocated) {
             std::cout << "Memory allocated for '" << name << "' has been deallocated.\n";
         }
 
-        if (!fs::exists(target)) {
+        StatCache::Info info = StatCache::get().lookup(target.string());
+        if (!info.exists) {
             std::cerr << "Error: File or directory '" << name << "' does not exist.\n"; // Use cerr for errors
-            return;
+            return false;
         }
 
-        if (fs::is_directory(target)) {
+        if (info.directory) {
             // Note: fs::remove_all will remove the directory and its contents.
             // If you allocated memory to files *within* the directory,
             // those allocations in MemoryManager will NOT be automatically deallocated
@@ -562,66 +1615,86 @@ void FileManager::remove(const std::string& name) {
     }
     catch (const fs::filesystem_error& e) {
         std::cerr << "Error removing '" << name << "': " << e.what() << '\n';
+        return false;
     }
+    return true;
 }
 
-void FileManager::addFile(const std::string& srcPath) {
-    try {
-        fs::path source(srcPath);
-        fs::path destination = fs::current_path() / source.filename();
-
-        if (!fs::exists(source)) {
-            std::cerr << "Error: Source file '" << srcPath << "' does not exist.\n"; // Use cerr for errors
-            return;
-        }
-
-        fs::copy_file(source, destination, fs::copy_options::overwrite_existing);
-        std::cout << "File '" << source.filename().string() << "' added successfully to working directory.\n";
+// Copies srcPath to `destination` (relative to the working directory) with FileCopy and
+// reports how it went, throughput included.
+bool FileManager::addFile(const std::string& srcPath, const std::string& destination) {
+    if (!StatCache::get().exists(srcPath)) {
+        std::cerr << "Error: Source file '" << srcPath << "' does not exist.\n"; // Use cerr for errors
+        return false;
     }
-    catch (const fs::filesystem_error& e) {
-        std::cerr << "Error adding file '" << srcPath << "': " << e.what() << '\n';
+    FileCopy::Result result;
+    std::string error;
+    if (!FileCopy::copy(srcPath, destination, result, error)) {
+        std::cerr << "Error adding file '" << srcPath << "': " << error << ".\n";
+        return false;
     }
+    // Formatted apart from std::cout: batch copies finish on several threads at once.
+    char rate[96];
+    std::snprintf(rate, sizeof(rate), "%s by %s, %s/s", formatBytes((double)result.bytes).c_str(),
+                  FileCopy::describe(result.method),
+                  formatBytes(result.seconds > 0 ? result.bytes / result.seconds : 0).c_str());
+    std::cout << "File '" << destination << "' added to the working directory (" << rate << ").\n";
+    return true;
 }
 
-void FileManager::createFile(const std::string& filename) {
-    // This function is now called ONLY if the file doesn't exist (checked in handleCommand)
+bool FileManager::createFile(const std::string& filename) {
+    // This function is now called ONLY if the file doesn't exist (checked in handleTouch)
     std::ofstream file(filename);
     if (file) {
         std::cout << "File created: '" << filename << "'\n";
         file.close();
+        return true;
     }
-    else {
-        // This error indicates a problem creating a *new* file
-        std::cerr << "Failed to create file: '" << filename << "'\n";
-    }
+    // This error indicates a problem creating a *new* file
+    std::cerr << "Failed to create file: '" << filename << "'\n";
+    return false;
 }
 
-void FileManager::readFile(const std::string& filename) {
+bool FileManager::readFile(const std::string& filename) {
     // Check if file exists before attempting to open
-    if (!fs::exists(filename)) {
+    if (!StatCache::get().exists(filename)) {
         std::cerr << "Error: File '" << filename << "' not found.\n";
-        return;
+        return false;
     }
 
-    std::ifstream file(filename);
+    // The mapped file goes to the console in one write instead of line by line.
+    MappedFile file;
 
-    if (file.is_open()) {
+    if (file.open(filename)) {
         std::cout << "--- Content of '" << filename << "' ---\n";
-        std::string line;
-        while (std::getline(file, line)) {
-            std::cout << line << '\n';
+        std::cout.write(file.data(), (std::streamsize)file.size());
+        if (file.size() > 0 && file.data()[file.size() - 1] != '\n') {
+            std::cout << '\n';
         }
         std::cout << "-----------------------------\n";
-        file.close();
+        return true;
     }
-    else {
-        // This case might be less likely after fs::exists check, but good to keep
-        std::cerr << "Error: Could not open file '" << filename << "' for reading.\n";
+    // This case might be less likely after the existence check, but good to keep
+    std::cerr << "Error: Could not open file '" << filename << "' for reading.\n";
+    return false;
+}
+
+// Prints bytes [offset, offset + length) of a file. For compressed files these are bytes
+// of the original content, and only the blocks covering them are decompressed.
+bool FileManager::readFileRange(const std::string& filename, uint64_t offset, uint64_t length) {
+    if (!StatCache::get().exists(filename)) {
+        std::cerr << "Error: File '" << filename << "' not found.\n";
+        return false;
     }
+
+    std::cout << "--- Content of '" << filename << "' from byte " << offset << " ---\n";
+    bool success = Compression::readRange(filename, offset, length, std::cout);
+    std::cout << "\n-----------------------------\n";
+    return success;
 }
 
-void FileManager::writeFile(const std::string& filename) {
-    // This function is now called ONLY if the file exists (checked in handleCommand)
+bool FileManager::writeFile(const std::string& filename) {
+    // This function is now called ONLY if the file exists (checked in handleWrite)
     std::ofstream file(filename, std::ios::out); // std::ios::out truncates the file
 
     if (file.is_open()) {
@@ -635,19 +1708,19 @@ void FileManager::writeFile(const std::string& filename) {
         }
         file.close();
         std::cout << "Content written to '" << filename << "'.\n";
+        return true;
     }
-    else {
-        // This error indicates a problem opening an *existing* file for writing
-        std::cerr << "Error: Could not open existing file '" << filename << "' for writing.\n";
-    }
+    // This error indicates a problem opening an *existing* file for writing
+    std::cerr << "Error: Could not open existing file '" << filename << "' for writing.\n";
+    return false;
 }
 
-void FileManager::openFile(const std::string& filename) {
+bool FileManager::openFile(const std::string& filename) {
     fs::path filePath = fs::current_path() / filename;
 
-    if (!fs::exists(filePath)) {
+    if (!StatCache::get().exists(filePath.string())) {
         std::cerr << "Error: File '" << filename << "' not found.\n";
-        return;
+        return false;
     }
 
     std::string command;
@@ -664,22 +1737,122 @@ void FileManager::openFile(const std::string& filename) {
 
     if (result != 0) {
         std::cerr << "Warning: System command failed (" << result << "). Could not open file '" << filename << "' or the command encountered an issue.\n";
+        return false;
     }
-    else {
-        std::cout << "Attempting to open file '" << filename << "' using default application...\n";
-    }
+    std::cout << "Attempting to open file '" << filename << "' using default application...\n";
+    return true;
 }
 
 // Assuming compress and decompress are in Compression class as per your file structure
-bool FileManager::compress(const std::string& filename) {
-    // File existence checked in handleCommand
-     return Compression::compressFile(filename);
+bool FileManager::compress(const std::string& filename, unsigned threads, const std::string& codec) {
+    // File existence checked in handleCompress
+     return Compression::compressFile(filename, threads, codec);
 }
 
 // Calls Compression::decompressFile which now returns bool
-bool FileManager::decompress(const std::string& filename) {
-    // File existence checked in handleCommand
-    return Compression::decompressFile(filename); // Return the bool result
+bool FileManager::decompress(const std::string& filename, unsigned threads) {
+    // File existence checked in handleDecompress
+    return Compression::decompressFile(filename, threads); // Return the bool result
+}
+
+// Removes "-j N" from args and stores N in threads (left unchanged when the option is absent).
+// Returns false if the option is present but N is missing or not a positive number.
+bool FileManager::extractThreadCount(Args& args, unsigned& threads) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] != "-j") continue;
+        if (i + 1 >= args.size()) return false;
+        std::string_view text = args[i + 1];
+        unsigned value = 0;
+        auto parsed = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (parsed.ec != std::errc() || parsed.ptr != text.data() + text.size() || value == 0) return false;
+        threads = value;
+        args.erase(args.begin() + i, args.begin() + i + 2);
+        return true;
+    }
+    return true;
+}
+
+// Removes every occurrence of the flag `name` from args. Returns true if there was one.
+bool FileManager::extractFlag(Args& args, std::string_view name) {
+    size_t before = args.size();
+    args.erase(std::remove(args.begin(), args.end(), name), args.end());
+    return args.size() != before;
+}
+
+// Parses a non-negative decimal byte count. Returns false on anything else.
+bool FileManager::parseByteCount(const std::string& text, uint64_t& value) {
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) return false;
+    try {
+        value = std::stoull(text);
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+// Removes "--name=value" or "--name value" from args and stores the value (left unchanged
+// when the option is absent). Returns false if the option is present without a value.
+bool FileManager::extractOption(Args& args, std::string_view name, std::string& value) {
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == name) {
+            if (i + 1 >= args.size()) return false;
+            value.assign(args[i + 1]);
+            args.erase(args.begin() + i, args.begin() + i + 2);
+            return true;
+        }
+        if (args[i].size() > name.size() && args[i].compare(0, name.size(), name) == 0 && args[i][name.size()] == '=') {
+            value.assign(args[i].substr(name.size() + 1));
+            args.erase(args.begin() + i);
+            return !value.empty();
+        }
+    }
+    return true;
+}
+
+// Prints the CRC-32C of a file, read through the mapping one block at a time.
+bool FileManager::checksumFile(const std::string& filename) {
+    MappedFile file;
+    if (!StatCache::get().exists(filename) || !file.open(filename)) {
+        std::cerr << "Error: Could not open file '" << filename << "' for reading.\n";
+        return false;
+    }
+    const size_t step = 1 << 20;
+    uint32_t crc = 0;
+    for (size_t offset = 0; offset < file.size(); offset += step) {
+        if (Cancellation::requested()) {
+            std::cerr << "Checksum of '" << filename << "' cancelled.\n";
+            return false;
+        }
+        size_t n = std::min(step, file.size() - offset);
+        crc = Crc32c::update(crc, file.data() + offset, n);
+        file.release(offset, n);
+    }
+    // Formatted apart from std::cout: a background job may be printing at the same
+    // time, and stream flags such as std::hex are shared by everyone writing to it.
+    char hex[9];
+    std::snprintf(hex, sizeof(hex), "%08x", (unsigned)crc);
+    std::cout << "CRC-32C of '" << filename << "': " << hex << " (" << file.size() << " bytes)\n";
+    return true;
+}
+
+// Reports what the CPU offers and which version of each kernel family was bound to it.
+void FileManager::showCpuInfo() {
+    const CpuFeatures& cpu = CpuFeatures::get();
+    std::cout << "CPU features:";
+    if (cpu.sse2) std::cout << " sse2";
+    if (cpu.sse42) std::cout << " sse4.2";
+    if (cpu.avx2) std::cout << " avx2";
+    if (cpu.avx512bw) std::cout << " avx512bw";
+    if (!cpu.sse2 && !cpu.sse42 && !cpu.avx2 && !cpu.avx512bw) std::cout << " none used";
+    std::cout << "\n";
+    if (cpu.forcedScalar) std::cout << "FMS_FORCE_SCALAR is set: every kernel runs its scalar version\n";
+
+    std::cout << "Kernels in use:\n";
+    std::cout << "  RLE run scan                      " << RunScan::activeVariant() << "\n";
+    std::cout << "  XOR / shift tables / letter count " << CipherKernels::activeVariant() << "\n";
+    std::cout << "  ChaCha20                          " << ChaCha20::activeVariant() << "\n";
+    std::cout << "  CRC-32C                           " << Crc32c::activeVariant() << "\n";
 }
 
 
@@ -1,7 +1,12 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <filesystem>
 #include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <functional>
+#include <cstdint>
 #include "Compression.h"      
 #include "MemoryManager.h"    
 #include "Encryption.h"       
@@ -12,23 +17,105 @@ namespace fs = std::filesystem;
 class FileManager {
 public:
     FileManager(); 
-    void handleCommand(const std::string& input);
+
+    // Runs one command line. Returns false if the command failed, was unknown or was
+    // given the wrong arguments.
+    bool handleCommand(std::string_view input);
+
+    // True once "exit" has run; the caller stops reading commands.
+    bool exitRequested() const;
+
+    // True if any command run so far has failed (the exit status of one-shot mode).
+    bool hasFailures() const;
 
 private:
+    // The words after the command name, as views into the command line.
+    typedef std::vector<std::string_view> Args;
+    typedef bool (FileManager::*Handler)(Args& args);
+    struct Command {
+        Handler handler;
+        bool background; // may run as a job ("<command> &")
+    };
+
     MemoryManager memoryManager;   
-    ProcessManager processManager;  
+    std::mutex memoryMutex; // background jobs reach memoryManager too (alloc, rm)
+    ProcessManager processManager; // declared after what jobs use: it waits for them when destroyed
+    Args words; // reused by every command, so tokenizing allocates nothing
+    bool exiting = false;
+
+    // What "list" shows (see handleList).
+    struct ListOptions {
+        enum class Sort { Name, Size, Mtime };
+        std::string directory = ".";
+        Sort sort = Sort::Name;     // size and mtime put the largest / newest first
+        std::string filter;         // glob for the entry names; empty for all
+        uint64_t offset = 0;
+        uint64_t limit = UINT64_MAX;
+        bool longFormat = false;    // type, size in bytes and modification time
+    };
+
+    static void tokenize(std::string_view line, std::string_view& command, Args& words);
+    static const std::unordered_map<std::string_view, Command>& commandTable();
+    bool startJob(std::string_view input, std::string_view name, const Command& command);
+    bool finishTask(int processId, bool success);
+
+    bool handleHelp(Args& args);
+    bool handleList(Args& args);
+    bool handleMkdir(Args& args);
+    bool handleTouch(Args& args);
+    bool handleRm(Args& args);
+    bool handleAdd(Args& args);
+    bool handleRead(Args& args);
+    bool handleWrite(Args& args);
+    bool handleOpen(Args& args);
+    bool handleCompress(Args& args);
+    bool handleDecompress(Args& args);
+    bool handleEncrypt(Args& args);
+    bool handleDecrypt(Args& args);
+    bool runCipherCommand(Args& args, bool decrypt);
+    bool handlePack(Args& args);
+    bool handleUnpack(Args& args);
+    bool handleAlloc(Args& args);
+    bool handleDealloc(Args& args);
+    bool handleChecksum(Args& args);
+    bool handleDu(Args& args);
+    bool handleTree(Args& args);
+    bool handleFind(Args& args);
+    bool handleCpuInfo(Args& args);
+    bool handleMemInfo(Args& args);
+    bool handleProcStatus(Args& args);
+    bool handleJobs(Args& args);
+    bool handleWait(Args& args);
+    bool handleKill(Args& args);
+    bool handleClearCompleted(Args& args);
+    bool handleClearAll(Args& args);
+    bool handleClear(Args& args);
+    bool handleExit(Args& args);
+
+    bool collectFiles(std::string_view operand, bool recursive, std::string_view namePattern,
+                      std::vector<std::string>& files);
+    bool runBatch(const std::string& verb, const std::vector<std::string>& files, unsigned threads,
+                  const std::function<bool(const std::string&)>& operation);
 
     void showHelp();
-    void listFiles();
-    void makeDirectory(const std::string& dirName);
-    void remove(const std::string& name);
-    void addFile(const std::string& srcPath);
-    void createFile(const std::string& filename);
-    void readFile(const std::string& filename);
-    void writeFile(const std::string& filename);
-    void openFile(const std::string& filename);
-    bool compress(const std::string& filename);
-    bool decompress(const std::string& filename);
-    int addProcessTask(const std::string& taskDescription); 
+    bool listFiles(const ListOptions& options);
+    bool makeDirectory(const std::string& dirName);
+    bool remove(const std::string& name);
+    bool addFile(const std::string& srcPath, const std::string& destination);
+    bool addFiles(const std::vector<std::string>& operands, unsigned threads);
+    bool createFile(const std::string& filename);
+    bool readFile(const std::string& filename);
+    bool readFileRange(const std::string& filename, uint64_t offset, uint64_t length);
+    bool writeFile(const std::string& filename);
+    bool openFile(const std::string& filename);
+    bool compress(const std::string& filename, unsigned threads, const std::string& codec);
+    bool decompress(const std::string& filename, unsigned threads);
+    bool extractThreadCount(Args& args, unsigned& threads);
+    bool extractOption(Args& args, std::string_view name, std::string& value);
+    bool extractFlag(Args& args, std::string_view name);
+    bool parseByteCount(const std::string& text, uint64_t& value);
+    bool checksumFile(const std::string& filename);
+    void showCpuInfo();
+    int addProcessTask(const std::string& taskDescription, std::ostream& messages = std::cout);
     void clearConsole();
 };
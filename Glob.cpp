@@ -0,0 +1,204 @@
+#include "Glob.h"
+#include "DirectoryWalker.h"
+#include <filesystem>
+#include <algorithm>
+#include <system_error>
+
+namespace fs = std::filesystem;
+
+namespace {
+    bool isSeparator(char c) {
+#if defined(_WIN32)
+        return c == '/' || c == '\\';
+#else
+        return c == '/';
+#endif
+    }
+
+    // Matches a bracket expression starting at pattern[p] == '['. Sets `next` past it.
+    // A '[' without its ']' is taken literally, as the shell does.
+    bool matchBracket(std::string_view pattern, size_t p, char c, bool& matched, size_t& next) {
+        size_t i = p + 1;
+        bool negate = i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^');
+        if (negate) ++i;
+        bool found = false;
+        bool first = true;
+        for (; i < pattern.size() && (first || pattern[i] != ']'); ++i, first = false) {
+            char low = pattern[i];
+            char high = low;
+            if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']') {
+                high = pattern[i + 2];
+                i += 2;
+            }
+            if ((unsigned char)low <= (unsigned char)c && (unsigned char)c <= (unsigned char)high) found = true;
+        }
+        if (i >= pattern.size()) return false;
+        matched = found != negate;
+        next = i + 1;
+        return true;
+    }
+
+    // Matches one path component against one pattern component ('*', '?', brackets).
+    bool matchName(std::string_view pattern, std::string_view name) {
+        if (!name.empty() && name[0] == '.' && (pattern.empty() || pattern[0] != '.')) return false;
+        // Iterative wildcard match: on a mismatch, let the last '*' swallow one more character.
+        size_t p = 0, n = 0, starP = std::string_view::npos, starN = 0;
+        while (n < name.size()) {
+            if (p < pattern.size()) {
+                char pc = pattern[p];
+                if (pc == '*') {
+                    starP = p++;
+                    starN = n;
+                    continue;
+                }
+                if (pc == '?') {
+                    ++p;
+                    ++n;
+                    continue;
+                }
+                bool matched;
+                size_t next;
+                if (pc == '[' && matchBracket(pattern, p, name[n], matched, next)) {
+                    if (matched) {
+                        p = next;
+                        ++n;
+                        continue;
+                    }
+                }
+                else if (pc == name[n]) {
+                    ++p;
+                    ++n;
+                    continue;
+                }
+            }
+            if (starP == std::string_view::npos) return false;
+            p = starP + 1;
+            n = ++starN;
+        }
+        while (p < pattern.size() && pattern[p] == '*') ++p;
+        return p == pattern.size();
+    }
+
+    void splitComponents(std::string_view text, std::vector<std::string_view>& parts) {
+        size_t start = 0;
+        for (size_t i = 0; i <= text.size(); ++i) {
+            if (i == text.size() || isSeparator(text[i])) {
+                if (i > start) parts.push_back(text.substr(start, i - start));
+                start = i + 1;
+            }
+        }
+    }
+
+    bool matchParts(const std::vector<std::string_view>& pattern, size_t p, const std::vector<std::string_view>& path, size_t n) {
+        while (p < pattern.size()) {
+            if (pattern[p] == "**") {
+                // Any number of directories: try every split point.
+                for (size_t skip = n; skip <= path.size(); ++skip) {
+                    if (matchParts(pattern, p + 1, path, skip)) return true;
+                    if (skip < path.size() && !path[skip].empty() && path[skip][0] == '.') break;
+                }
+                return false;
+            }
+            if (n == path.size() || !matchName(pattern[p], path[n])) return false;
+            ++p;
+            ++n;
+        }
+        return n == path.size();
+    }
+
+    std::string relativeName(const fs::path& file, const fs::path& base) {
+        return file.lexically_relative(base).generic_string();
+    }
+}
+
+bool Glob::hasWildcards(std::string_view text) {
+    return text.find_first_of("*?[") != std::string_view::npos;
+}
+
+bool Glob::match(std::string_view pattern, std::string_view path) {
+    std::vector<std::string_view> patternParts, pathParts;
+    splitComponents(pattern, patternParts);
+    splitComponents(path, pathParts);
+    return matchParts(patternParts, 0, pathParts, 0);
+}
+
+bool Glob::expand(const std::string& pattern, std::vector<std::string>& files, std::string& error) {
+    // The walk starts from the longest leading run of components without wildcards, and
+    // only descends when the rest of the pattern spans more than one name.
+    std::vector<std::string_view> parts;
+    splitComponents(pattern, parts);
+    size_t fixed = 0;
+    while (fixed < parts.size() && !hasWildcards(parts[fixed])) ++fixed;
+    if (fixed == parts.size()) {
+        std::error_code ec;
+        if (fs::is_regular_file(pattern, ec)) files.push_back(pattern);
+        return true;
+    }
+
+    std::string base = isSeparator(pattern[0]) ? pattern.substr(0, 1) : std::string();
+    for (size_t i = 0; i < fixed; ++i) {
+        if (!base.empty() && !isSeparator(base.back())) base += '/';
+        base.append(parts[i].data(), parts[i].size());
+    }
+    fs::path root = base.empty() ? fs::path(".") : fs::path(base);
+    std::string rest;
+    for (size_t i = fixed; i < parts.size(); ++i) {
+        if (!rest.empty()) rest += '/';
+        rest.append(parts[i].data(), parts[i].size());
+    }
+    bool deep = parts.size() - fixed > 1 || rest.find("**") != std::string::npos;
+
+    std::error_code ec;
+    std::vector<std::string> found;
+    auto consider = [&](const fs::directory_entry& entry) {
+        std::error_code statError;
+        if (!entry.is_regular_file(statError)) return;
+        std::string relative = relativeName(entry.path(), root);
+        if (match(rest, relative)) found.push_back(base.empty() ? relative : (fs::path(base) / relative).generic_string());
+    };
+    if (deep) {
+        fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end;
+        for (; !ec && it != end; it.increment(ec)) consider(*it);
+    }
+    else {
+        fs::directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end;
+        for (; !ec && it != end; it.increment(ec)) consider(*it);
+    }
+    if (ec) {
+        error = "Could not read '" + root.string() + "': " + ec.message();
+        return false;
+    }
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+    return true;
+}
+
+bool Glob::walk(const std::string& directory, const std::string& namePattern, std::vector<std::string>& files,
+                std::string& error) {
+    DirectoryWalker::Options options;
+    options.hidden = false;
+    DirectoryWalker::Stats stats;
+    auto tree = DirectoryWalker::walk(directory, options, [&](DirectoryWalker::Node& node, std::vector<DirectoryWalker::Entry>& entries) {
+        for (auto& entry : entries) {
+            if (entry.type == DirectoryWalker::Type::File && matchName(namePattern, entry.name)) node.kept.push_back(std::move(entry));
+        }
+    }, stats, error);
+    if (tree == nullptr) {
+        error = "Could not read '" + directory + "': " + error;
+        return false;
+    }
+
+    std::vector<std::string> found;
+    std::vector<const DirectoryWalker::Node*> pending{ tree.get() };
+    while (!pending.empty()) {
+        const DirectoryWalker::Node* node = pending.back();
+        pending.pop_back();
+        for (const auto& entry : node->kept) {
+            found.push_back(node->path == "." ? entry.name : (fs::path(node->path) / entry.name).generic_string());
+        }
+        for (const auto& child : node->subdirectories) pending.push_back(child.get());
+    }
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+    return true;
+}
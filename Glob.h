@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Expands file operands with wildcards into the files they name, for the batch forms
+// of the file commands. Patterns use '/' (or '\' on Windows) between directories:
+//
+//   *        any run of characters within one name
+//   ?        any one character
+//   [abc]    one of the characters listed; [a-z] ranges, [!...] negation
+//   **       as a whole path component, any number of directories (including none)
+//
+// Names starting with '.' are matched only by patterns that spell out the '.'.
+class Glob {
+public:
+    static bool hasWildcards(std::string_view text);
+
+    // True if `path` (relative, '/'-separated) matches `pattern` as a whole.
+    static bool match(std::string_view pattern, std::string_view path);
+
+    // Appends the regular files matching `pattern` to `files`, in sorted order. Returns
+    // false, with `error` set, if the directory the pattern starts from cannot be read.
+    static bool expand(const std::string& pattern, std::vector<std::string>& files, std::string& error);
+
+    // Appends every regular file under `directory`, at any depth, whose name matches
+    // `namePattern` (a single-name pattern such as "*.txt"), skipping hidden directories.
+    // The tree is read in parallel (DirectoryWalker).
+    static bool walk(const std::string& directory, const std::string& namePattern, std::vector<std::string>& files,
+                     std::string& error);
+};
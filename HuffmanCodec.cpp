@@ -0,0 +1,307 @@
+#include "HuffmanCodec.h"
+#include <cstring>
+#include <cstdint>
+
+namespace {
+    const unsigned MAX_CODE_LENGTH = 11;
+    const size_t TABLE_SIZE = (size_t)1 << MAX_CODE_LENGTH;
+    const uint64_t TABLE_MASK = TABLE_SIZE - 1;
+    const size_t HEADER_SIZE = 128;
+
+    inline void store64(unsigned char* p, uint64_t value) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        for (int i = 0; i < 8; ++i) p[i] = (unsigned char)(value >> (8 * i));
+#else
+        std::memcpy(p, &value, sizeof(value));
+#endif
+    }
+
+    inline uint64_t load64(const unsigned char* p) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        uint64_t value = 0;
+        for (int i = 0; i < 8; ++i) value |= (uint64_t)p[i] << (8 * i);
+        return value;
+#else
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+#endif
+    }
+
+    // Optimal code lengths for the byte frequencies, then clamped to MAX_CODE_LENGTH.
+    // Clamping oversubscribes the code space, so the longest codes still below the
+    // limit are lengthened one bit at a time until the Kraft sum fits again; those are
+    // the rarest symbols, which keeps the cost of the limit small.
+    void buildLengths(const uint64_t freq[256], unsigned char lengths[256]) {
+        std::memset(lengths, 0, 256);
+
+        int symbols[256];
+        int count = 0;
+        for (int s = 0; s < 256; ++s) {
+            if (freq[s] != 0) symbols[count++] = s;
+        }
+        if (count == 0) return;
+        if (count == 1) {
+            lengths[symbols[0]] = 1;
+            return;
+        }
+
+        // Leaves sorted by frequency, then the classic two-queue merge: internal nodes
+        // are created in non-decreasing weight order, so each step takes the two
+        // lightest heads of the leaf and node queues.
+        for (int i = 1; i < count; ++i) {
+            int s = symbols[i];
+            int j = i;
+            while (j > 0 && freq[symbols[j - 1]] > freq[s]) {
+                symbols[j] = symbols[j - 1];
+                --j;
+            }
+            symbols[j] = s;
+        }
+
+        uint64_t weight[511];
+        int parent[511];
+        for (int i = 0; i < count; ++i) weight[i] = freq[symbols[i]];
+        int nextLeaf = 0;
+        int nextNode = count;
+        int created = count;
+        auto takeLightest = [&]() {
+            if (nextLeaf < count && (nextNode == created || weight[nextLeaf] <= weight[nextNode])) return nextLeaf++;
+            return nextNode++;
+        };
+        while (created < 2 * count - 1) {
+            int a = takeLightest();
+            int b = takeLightest();
+            weight[created] = weight[a] + weight[b];
+            parent[a] = created;
+            parent[b] = created;
+            created++;
+        }
+
+        // Parents always come after their children, so one backward pass gives depths.
+        unsigned depth[511];
+        depth[created - 1] = 0;
+        for (int i = created - 2; i >= 0; --i) depth[i] = depth[parent[i]] + 1;
+
+        uint32_t kraft = 0;
+        for (int i = 0; i < count; ++i) {
+            unsigned length = depth[i] < MAX_CODE_LENGTH ? depth[i] : MAX_CODE_LENGTH;
+            lengths[symbols[i]] = (unsigned char)length;
+            kraft += 1u << (MAX_CODE_LENGTH - length);
+        }
+        while (kraft > TABLE_SIZE) {
+            // symbols[] is sorted by rising frequency: the first symbol with the
+            // longest sub-limit length is the cheapest one to lengthen.
+            int pick = -1;
+            for (int i = 0; i < count; ++i) {
+                unsigned length = lengths[symbols[i]];
+                if (length < MAX_CODE_LENGTH && (pick < 0 || length > lengths[symbols[pick]])) pick = i;
+            }
+            unsigned char& length = lengths[symbols[pick]];
+            kraft -= 1u << (MAX_CODE_LENGTH - length - 1);
+            length++;
+        }
+    }
+
+    // Canonical codes (shorter codes first, ties by byte value), stored bit-reversed
+    // because the stream is read least-significant bit first. Returns false if the
+    // lengths do not describe a prefix code.
+    bool assignCodes(const unsigned char lengths[256], uint16_t codes[256]) {
+        unsigned lengthCount[MAX_CODE_LENGTH + 1] = {};
+        for (int s = 0; s < 256; ++s) {
+            if (lengths[s] > MAX_CODE_LENGTH) return false;
+            lengthCount[lengths[s]]++;
+        }
+        lengthCount[0] = 0;
+
+        uint32_t kraft = 0;
+        unsigned nextCode[MAX_CODE_LENGTH + 2];
+        unsigned code = 0;
+        for (unsigned length = 1; length <= MAX_CODE_LENGTH; ++length) {
+            kraft += lengthCount[length] << (MAX_CODE_LENGTH - length);
+            code = (code + lengthCount[length - 1]) << 1;
+            nextCode[length] = code;
+        }
+        if (kraft > TABLE_SIZE) return false;
+
+        for (int s = 0; s < 256; ++s) {
+            unsigned length = lengths[s];
+            if (length == 0) {
+                codes[s] = 0;
+                continue;
+            }
+            unsigned value = nextCode[length]++;
+            unsigned reversed = 0;
+            for (unsigned i = 0; i < length; ++i) reversed |= ((value >> i) & 1) << (length - 1 - i);
+            codes[s] = (uint16_t)reversed;
+        }
+        return true;
+    }
+
+    // --- Decode tables ---
+    //
+    // single[w]: the symbol whose code is a prefix of the 11-bit window w, as
+    //            symbol | length << 8 (length 0 = no code matches).
+    // multi[w]:  up to three symbols decoded back to back from w, packed as
+    //            s0 | s1 << 8 | s2 << 16 | count << 24 | bits << 26 (0 = invalid).
+
+    bool buildTables(const unsigned char lengths[256], uint16_t single[], uint32_t multi[]) {
+        uint16_t codes[256];
+        if (!assignCodes(lengths, codes)) return false;
+
+        std::memset(single, 0, TABLE_SIZE * sizeof(single[0]));
+        for (int s = 0; s < 256; ++s) {
+            unsigned length = lengths[s];
+            if (length == 0) continue;
+            for (size_t w = codes[s]; w < TABLE_SIZE; w += (size_t)1 << length) {
+                single[w] = (uint16_t)(s | (length << 8));
+            }
+        }
+
+        for (size_t w = 0; w < TABLE_SIZE; ++w) {
+            unsigned bits = single[w] >> 8;
+            if (bits == 0) {
+                multi[w] = 0;
+                continue;
+            }
+            uint32_t entry = single[w] & 0xFF;
+            unsigned count = 1;
+            while (count < 3) {
+                uint16_t next = single[(w >> bits) & TABLE_MASK];
+                unsigned length = next >> 8;
+                if (length == 0 || bits + length > MAX_CODE_LENGTH) break;
+                entry |= (uint32_t)(next & 0xFF) << (8 * count);
+                bits += length;
+                count++;
+            }
+            multi[w] = entry | (count << 24) | (bits << 26);
+        }
+        return true;
+    }
+}
+
+void HuffmanCodec::compress(const char* block, size_t n, std::vector<char>& out) const {
+    const unsigned char* data = (const unsigned char*)block;
+    out.clear();
+    if (n == 0) return;
+
+    // Four interleaved histograms avoid the store-to-load stall of counting the same
+    // byte value twice in a row, which is the common case in text and logs.
+    uint32_t counts[4][256] = {};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        counts[0][data[i]]++;
+        counts[1][data[i + 1]]++;
+        counts[2][data[i + 2]]++;
+        counts[3][data[i + 3]]++;
+    }
+    for (; i < n; ++i) counts[0][data[i]]++;
+    uint64_t freq[256];
+    for (int s = 0; s < 256; ++s) freq[s] = (uint64_t)counts[0][s] + counts[1][s] + counts[2][s] + counts[3][s];
+
+    unsigned char lengths[256];
+    uint16_t codes[256];
+    buildLengths(freq, lengths);
+    assignCodes(lengths, codes);
+
+    // Worst case is every byte at the length limit, plus slack for the 8-byte stores.
+    out.resize(HEADER_SIZE + (n * MAX_CODE_LENGTH + 7) / 8 + 8);
+    unsigned char* header = (unsigned char*)out.data();
+    for (size_t s = 0; s < 256; s += 2) header[s / 2] = (unsigned char)(lengths[s] | (lengths[s + 1] << 4));
+
+    // Codes accumulate in a 64-bit buffer; whole bytes are written out after every
+    // four symbols (at most 44 bits plus fewer than 8 left over).
+    unsigned char* w = header + HEADER_SIZE;
+    uint64_t bits = 0;
+    unsigned count = 0;
+    i = 0;
+    for (; i + 4 <= n; i += 4) {
+        for (size_t k = 0; k < 4; ++k) {
+            unsigned char s = data[i + k];
+            bits |= (uint64_t)codes[s] << count;
+            count += lengths[s];
+        }
+        store64(w, bits);
+        w += count >> 3;
+        bits >>= count & ~7u;
+        count &= 7;
+    }
+    for (; i < n; ++i) {
+        unsigned char s = data[i];
+        bits |= (uint64_t)codes[s] << count;
+        count += lengths[s];
+    }
+    store64(w, bits);
+    w += (count + 7) >> 3;
+    out.resize((size_t)(w - (unsigned char*)out.data()));
+}
+
+size_t HuffmanCodec::maxCompressedSize(size_t n) const {
+    return n == 0 ? 0 : HEADER_SIZE + (n * MAX_CODE_LENGTH + 7) / 8;
+}
+
+// Every code is at least one bit long.
+size_t HuffmanCodec::maxDecompressedSize(size_t n) const {
+    return n <= HEADER_SIZE ? 0 : (n - HEADER_SIZE) * 8;
+}
+
+bool HuffmanCodec::decompress(const char* in, size_t n, char* outBytes, size_t rawSize) const {
+    if (rawSize == 0) return n == 0;
+    if (n < HEADER_SIZE) return false;
+
+    const unsigned char* p = (const unsigned char*)in;
+    const unsigned char* end = p + n;
+    unsigned char* out = (unsigned char*)outBytes;
+
+    unsigned char lengths[256];
+    for (size_t s = 0; s < 256; s += 2) {
+        lengths[s] = p[s / 2] & 0x0F;
+        lengths[s + 1] = p[s / 2] >> 4;
+    }
+    p += HEADER_SIZE;
+
+    uint16_t single[TABLE_SIZE];
+    uint32_t multi[TABLE_SIZE];
+    if (!buildTables(lengths, single, multi)) return false;
+
+    uint64_t bits = 0;
+    unsigned count = 0;
+    size_t produced = 0;
+
+    // Fast path: one refill tops the buffer up to at least 56 bits, enough for four
+    // lookups of up to 11 bits each, and each lookup may emit three symbols. The
+    // refill loads 8 bytes but only advances past the whole bytes that fit; the rest
+    // is loaded again, into the same bit positions, next time.
+    while (end - p >= 8 && rawSize - produced >= 12) {
+        bits |= load64(p) << count;
+        p += (63 - count) >> 3;
+        count |= 56;
+        for (int k = 0; k < 4; ++k) {
+            uint32_t entry = multi[bits & TABLE_MASK];
+            if (entry == 0) return false;
+            out[produced] = (unsigned char)entry;
+            out[produced + 1] = (unsigned char)(entry >> 8);
+            out[produced + 2] = (unsigned char)(entry >> 16);
+            produced += (entry >> 24) & 3;
+            unsigned length = entry >> 26;
+            bits >>= length;
+            count -= length;
+        }
+    }
+
+    // Tail: one symbol at a time, refilling byte by byte and checking every code
+    // against the bits actually left in the stream.
+    while (produced < rawSize) {
+        while (count <= 56 && p < end) {
+            bits |= (uint64_t)*p++ << count;
+            count += 8;
+        }
+        uint16_t entry = single[bits & TABLE_MASK];
+        unsigned length = entry >> 8;
+        if (length == 0 || length > count) return false;
+        out[produced++] = (unsigned char)entry;
+        bits >>= length;
+        count -= length;
+    }
+    return true;
+}
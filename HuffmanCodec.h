@@ -0,0 +1,22 @@
+#pragma once
+#include "Codec.h"
+
+// Canonical Huffman coding of single bytes. A block is
+//
+//   code lengths  128 bytes   4 bits per byte value (low nibble first), 0 = unused
+//   bitstream                 codes packed least-significant bit first, zero padded
+//
+// Code lengths are limited to 11 bits so that one 2048-entry table lookup always
+// resolves at least one symbol; the decoder's table also stores the second and third
+// symbol of a window when they fit, so typical text decodes several bytes per lookup.
+class HuffmanCodec : public Codec {
+public:
+    static const unsigned char ID = 3;
+
+    unsigned char id() const override { return ID; }
+    const char* name() const override { return "huff"; }
+    void compress(const char* data, size_t n, std::vector<char>& out) const override;
+    bool decompress(const char* in, size_t n, char* out, size_t rawSize) const override;
+    size_t maxCompressedSize(size_t n) const override;
+    size_t maxDecompressedSize(size_t n) const override;
+};
@@ -0,0 +1,467 @@
+#include "InPlaceCipher.h"
+#include "Encryption.h"
+#include "PositionalFile.h"
+#include "ThreadPool.h"
+#include "Crc32c.h"
+#include "Sha256.h"
+#include "Cancellation.h"
+#include <iostream>
+#include <filesystem>
+#include <random>
+#include <cstring>
+#include <cctype>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+namespace fs = std::filesystem;
+
+// --- Journal ---
+//
+// The file is rewritten one CHUNK_SIZE chunk at a time. Before a chunk is written, the
+// journal records where it starts, the key position there, and a CRC-32C of every
+// PAGE_SIZE page of the chunk both before and after the transform; only then is the
+// chunk written and flushed. After a crash, every page of that chunk matches one of
+// its two checksums (disks write a 4 KiB page whole), which tells recovery exactly
+// which pages still need the transform: everything before the chunk is done and
+// everything after it untouched. The journal costs 8 bytes per page (0.2%) and two
+// flushes per chunk.
+//
+// The journal file has two fixed-size slots written alternately, so a crash while one
+// is written leaves the other intact. Each slot holds one record:
+//
+//   magic         4 bytes   0x89 'F' 'M' 'J'
+//   version       1 byte    1
+//   flags         1 byte    1 = decrypting, 2 = rolling back the run described by bit 0
+//   algorithm     16 bytes  Encryption algorithm name, zero padded
+//   key salt      16 bytes  with the key check: SHA-256(salt, key) truncated to 8 bytes,
+//   key check     8 bytes   so a resumed run cannot continue under another key
+//                           (ChaCha20 leaves both zero: its header checks the key)
+//   header size   1 byte    the ChaCha20 header follows, zero padded to 64 bytes
+//   header        64 bytes
+//   data length   8 bytes   bytes the cipher covers (the file without the ChaCha20 trailer)
+//   end           8 bytes   this run transforms [0, end)
+//   sequence      8 bytes   the slot with the higher number is current
+//   done          8 bytes   [0, done) is transformed
+//   position      8 bytes   key position at `done`
+//   page count    4 bytes   pages of the chunk at `done` being written; 0 if none
+//   checksums     8 bytes   per page: CRC-32C before, CRC-32C after
+//   record CRC    4 bytes   CRC-32C of everything above
+//
+// All numbers are little-endian.
+
+namespace {
+    const size_t CHUNK_SIZE = (size_t)16 << 20; // 16 MiB
+    const size_t PIECE_SIZE = 1 << 20;          // unit of parallel work inside a chunk
+    const size_t PAGE_SIZE = 4096;
+    const size_t CHUNK_PAGES = CHUNK_SIZE / PAGE_SIZE;
+
+    const unsigned char MAGIC[4] = { 0x89, 'F', 'M', 'J' };
+    const unsigned char VERSION = 1;
+    const unsigned char FLAG_DECRYPT = 1;
+    const unsigned char FLAG_ROLLBACK = 2;
+    const size_t NAME_SIZE = 16;
+    const size_t SALT_SIZE = 16;
+    const size_t CHECK_SIZE = 8;
+    const size_t MAX_HEADER_SIZE = 64;
+    const size_t SLOT_SIZE = 256 + CHUNK_PAGES * 8;
+
+    const std::string JOURNAL_SUFFIX = ".journal";
+
+    struct Journal {
+        bool decrypt = false;
+        bool rollback = false;
+        std::string algorithm;
+        unsigned char keySalt[SALT_SIZE] = {};
+        unsigned char keyCheck[CHECK_SIZE] = {};
+        std::string header;
+        uint64_t dataLength = 0;
+        uint64_t end = 0;
+        uint64_t sequence = 0;
+        uint64_t done = 0;
+        uint64_t position = 0;
+        std::vector<uint32_t> before; // per page of the chunk in flight; empty if none
+        std::vector<uint32_t> after;
+
+        // True if this run decrypts: a rollback runs the other way.
+        bool decrypting() const { return decrypt != rollback; }
+    };
+
+    void put(std::vector<char>& out, uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i) out.push_back((char)(value >> (8 * i)));
+    }
+
+    uint64_t get(const char*& p, int bytes) {
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; ++i) value |= (uint64_t)(unsigned char)p[i] << (8 * i);
+        p += bytes;
+        return value;
+    }
+
+    std::vector<char> encode(const Journal& journal) {
+        std::vector<char> out(MAGIC, MAGIC + sizeof(MAGIC));
+        out.push_back((char)VERSION);
+        out.push_back((char)((journal.decrypt ? FLAG_DECRYPT : 0) | (journal.rollback ? FLAG_ROLLBACK : 0)));
+        std::string name = journal.algorithm;
+        name.resize(NAME_SIZE, '\0');
+        out.insert(out.end(), name.begin(), name.end());
+        out.insert(out.end(), journal.keySalt, journal.keySalt + SALT_SIZE);
+        out.insert(out.end(), journal.keyCheck, journal.keyCheck + CHECK_SIZE);
+        std::string header = journal.header;
+        out.push_back((char)header.size());
+        header.resize(MAX_HEADER_SIZE, '\0');
+        out.insert(out.end(), header.begin(), header.end());
+        put(out, journal.dataLength, 8);
+        put(out, journal.end, 8);
+        put(out, journal.sequence, 8);
+        put(out, journal.done, 8);
+        put(out, journal.position, 8);
+        put(out, journal.before.size(), 4);
+        for (size_t i = 0; i < journal.before.size(); ++i) {
+            put(out, journal.before[i], 4);
+            put(out, journal.after[i], 4);
+        }
+        put(out, Crc32c::update(0, out.data(), out.size()), 4);
+        return out;
+    }
+
+    // Parses one slot; false if it holds no complete record.
+    bool decode(const std::vector<char>& slot, Journal& journal) {
+        const size_t fixedSize = sizeof(MAGIC) + 2 + NAME_SIZE + SALT_SIZE + CHECK_SIZE + 1 + MAX_HEADER_SIZE + 5 * 8 + 4;
+        if (slot.size() < fixedSize + 4 || std::memcmp(slot.data(), MAGIC, sizeof(MAGIC)) != 0) return false;
+
+        const char* p = slot.data() + sizeof(MAGIC);
+        if ((unsigned char)*p++ != VERSION) return false;
+        unsigned char flags = (unsigned char)*p++;
+        journal.decrypt = (flags & FLAG_DECRYPT) != 0;
+        journal.rollback = (flags & FLAG_ROLLBACK) != 0;
+        journal.algorithm.assign(p, std::find(p, p + NAME_SIZE, '\0'));
+        p += NAME_SIZE;
+        std::memcpy(journal.keySalt, p, SALT_SIZE);
+        p += SALT_SIZE;
+        std::memcpy(journal.keyCheck, p, CHECK_SIZE);
+        p += CHECK_SIZE;
+        size_t headerSize = (unsigned char)*p++;
+        if (headerSize > MAX_HEADER_SIZE) return false;
+        journal.header.assign(p, headerSize);
+        p += MAX_HEADER_SIZE;
+        journal.dataLength = get(p, 8);
+        journal.end = get(p, 8);
+        journal.sequence = get(p, 8);
+        journal.done = get(p, 8);
+        journal.position = get(p, 8);
+        size_t pages = (size_t)get(p, 4);
+        if (pages > CHUNK_PAGES || (size_t)(slot.data() + slot.size() - p) < pages * 8 + 4) return false;
+        journal.before.resize(pages);
+        journal.after.resize(pages);
+        for (size_t i = 0; i < pages; ++i) {
+            journal.before[i] = (uint32_t)get(p, 4);
+            journal.after[i] = (uint32_t)get(p, 4);
+        }
+        size_t recordSize = (size_t)(p - slot.data());
+        return get(p, 4) == Crc32c::update(0, slot.data(), recordSize) && journal.done <= journal.end;
+    }
+
+    // The current record of a journal file: the valid slot with the higher sequence.
+    bool loadJournal(PositionalFile& file, Journal& journal) {
+        std::vector<char> slot(SLOT_SIZE);
+        bool found = false;
+        for (int i = 0; i < 2; ++i) {
+            Journal candidate;
+            if (file.readAt(i * SLOT_SIZE, slot.data(), SLOT_SIZE) && decode(slot, candidate) &&
+                (!found || candidate.sequence > journal.sequence)) {
+                journal = candidate;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    // Writes the next record into the slot not holding the current one, and flushes it.
+    bool saveJournal(PositionalFile& file, Journal& journal) {
+        ++journal.sequence;
+        std::vector<char> record = encode(journal);
+        return file.writeAt((journal.sequence % 2) * SLOT_SIZE, record.data(), record.size()) && file.sync();
+    }
+
+    void keyCheck(const std::string& key, const unsigned char salt[SALT_SIZE], unsigned char check[CHECK_SIZE]) {
+        Sha256 hash;
+        hash.update(salt, SALT_SIZE);
+        hash.update(key.data(), key.size());
+        unsigned char digest[Sha256::DIGEST_SIZE];
+        hash.finish(digest);
+        std::memcpy(check, digest, CHECK_SIZE);
+    }
+
+    // Reports a failed createEncryptor/createDecryptor.
+    bool cipherReady(const std::string& algorithm, EngineStatus status) {
+        if (status == EngineStatus::Ok) return true;
+        Encryption::reportError(algorithm, status);
+        return false;
+    }
+
+    // The cipher a journal's run applies. ChaCha20 is its own inverse and is rebuilt
+    // from the stored header, which also checks the key.
+    bool makeCipher(const Journal& journal, const std::string& key, Encryption::ChunkCipher& cipher) {
+        EngineStatus status;
+        if (journal.algorithm == "chacha20") status = Encryption::createDecryptor(journal.algorithm, key, journal.header, cipher);
+        else if (journal.decrypting()) status = Encryption::createDecryptor(journal.algorithm, key, std::string_view(), cipher);
+        else {
+            std::string header;
+            status = Encryption::createEncryptor(journal.algorithm, key, header, cipher);
+        }
+        return cipherReady(journal.algorithm, status);
+    }
+
+    // CRC-32C of every page of data[0, n), computed one piece per task.
+    void pageChecksums(ThreadPool& pool, const char* data, size_t n, std::vector<uint32_t>& out) {
+        out.resize((n + PAGE_SIZE - 1) / PAGE_SIZE);
+        pool.parallelFor((n + PIECE_SIZE - 1) / PIECE_SIZE, [&](size_t piece) {
+            size_t first = piece * PIECE_SIZE / PAGE_SIZE;
+            size_t last = std::min(out.size(), (piece + 1) * PIECE_SIZE / PAGE_SIZE);
+            for (size_t page = first; page < last; ++page) {
+                size_t offset = page * PAGE_SIZE;
+                out[page] = Crc32c::update(0, data + offset, std::min(PAGE_SIZE, n - offset));
+            }
+        });
+    }
+
+    std::vector<Encryption::Piece> split(char* data, size_t n, size_t pieceSize) {
+        std::vector<Encryption::Piece> pieces;
+        for (size_t offset = 0; offset < n; offset += pieceSize) {
+            pieces.push_back({ data + offset, std::min(pieceSize, n - offset) });
+        }
+        return pieces;
+    }
+
+    // Brings the chunk recorded in the journal to its transformed state: pages that
+    // match their "before" checksum get the transform, pages matching "after" are
+    // left alone. Fails if a page matches neither.
+    bool settleChunk(PositionalFile& file, Journal& journal, PositionalFile& journalFile,
+                     const Encryption::ChunkCipher& cipher, ThreadPool& pool) {
+        size_t n = (size_t)std::min<uint64_t>(CHUNK_SIZE, journal.end - journal.done);
+        if (journal.before.size() != (n + PAGE_SIZE - 1) / PAGE_SIZE) {
+            std::cerr << "Error: The journal does not match the file.\n";
+            return false;
+        }
+        std::vector<char> chunk(n);
+        if (!file.readAt(journal.done, chunk.data(), n)) {
+            std::cerr << "Error: Could not read the interrupted chunk at byte " << journal.done << ".\n";
+            return false;
+        }
+        std::vector<uint32_t> current;
+        pageChecksums(pool, chunk.data(), n, current);
+        std::vector<char> pending(current.size(), 0);
+        size_t pendingPages = 0;
+        for (size_t page = 0; page < current.size(); ++page) {
+            if (current[page] == journal.after[page]) continue;
+            if (current[page] != journal.before[page]) {
+                std::cerr << "Error: Bytes " << journal.done + page * PAGE_SIZE << " to "
+                          << journal.done + std::min(n, (page + 1) * PAGE_SIZE) - 1
+                          << " were torn by the interruption and cannot be recovered.\n";
+                return false;
+            }
+            pending[page] = 1;
+            ++pendingPages;
+        }
+
+        // Positions still come from every page (the ciphers keep letters letters, so
+        // the count is the same in either state); only pending pages are transformed.
+        Encryption::ChunkCipher partial;
+        partial.advance = cipher.advance;
+        partial.apply = [&](char* data, size_t size, uint64_t position) {
+            if (pending[(size_t)(data - chunk.data()) / PAGE_SIZE]) cipher.apply(data, size, position);
+        };
+        uint64_t position = Encryption::applyPieces(pool, partial, split(chunk.data(), n, PAGE_SIZE), journal.position);
+        if (pendingPages > 0 && (!file.writeAt(journal.done, chunk.data(), n) || !file.sync())) {
+            std::cerr << "Error: Could not write the interrupted chunk at byte " << journal.done << ".\n";
+            return false;
+        }
+
+        journal.done += n;
+        journal.position = position;
+        journal.before.clear();
+        journal.after.clear();
+        return saveJournal(journalFile, journal);
+    }
+
+    // Puts the ChaCha20 trailer where this run leaves it: present after encrypting
+    // (or undoing a decryption), gone after decrypting (or undoing an encryption).
+    bool finishTrailer(PositionalFile& file, const Journal& journal) {
+        if (journal.algorithm != "chacha20") return true;
+        if (journal.decrypt == journal.rollback) {
+            return file.writeAt(journal.dataLength, journal.header.data(), journal.header.size()) &&
+                   file.resize(journal.dataLength + journal.header.size()) && file.sync();
+        }
+        return file.resize(journal.dataLength) && file.sync();
+    }
+}
+
+bool InPlaceCipher::run(const std::string& algorithm, const std::string& filename, const std::string& key,
+                        bool decrypt, bool rollback, unsigned threads) {
+    std::string algo = algorithm;
+    for (auto& c : algo) c = (char)std::tolower((unsigned char)c);
+    if (algo == "railfence") {
+        std::cerr << "Error: Rail Fence moves bytes around and cannot work in place.\n";
+        return false;
+    }
+    if (algo != "caesar" && algo != "xor" && algo != "vigenere" && algo != "chacha20") {
+        std::cerr << "Error: Unknown encryption algorithm.\n";
+        return false;
+    }
+
+    PositionalFile file;
+    uint64_t fileSize = 0;
+    if (!file.open(filename) || !file.size(fileSize)) {
+        std::cerr << "Error: Could not open '" << filename << "' for reading and writing.\n";
+        return false;
+    }
+
+    const std::string journalPath = filename + JOURNAL_SUFFIX;
+    PositionalFile journalFile;
+    Journal journal;
+    Encryption::ChunkCipher cipher;
+    bool resuming = fs::exists(journalPath);
+
+    if (resuming) {
+        if (!journalFile.open(journalPath) || !loadJournal(journalFile, journal)) {
+            std::cerr << "Error: The journal '" << journalPath << "' is damaged; the file cannot be recovered automatically.\n";
+            return false;
+        }
+        if (journal.algorithm != algo) {
+            std::cerr << "Error: '" << filename << "' has an interrupted in-place run using " << journal.algorithm
+                      << "; finish or roll it back with that algorithm.\n";
+            return false;
+        }
+        if (journal.rollback && !rollback) {
+            std::cerr << "Error: '" << filename << "' has an interrupted rollback; finish it with --rollback.\n";
+            return false;
+        }
+        if (!journal.rollback && !rollback && journal.decrypt != decrypt) {
+            std::cerr << "Error: '" << filename << "' has an interrupted in-place " << (journal.decrypt ? "decryption" : "encryption")
+                      << "; finish it with " << (journal.decrypt ? "decrypt" : "encrypt") << " --inplace or undo it with --rollback.\n";
+            return false;
+        }
+        if (fileSize != journal.dataLength && fileSize != journal.dataLength + journal.header.size()) {
+            std::cerr << "Error: '" << filename << "' changed size since the interrupted run; it cannot be resumed.\n";
+            return false;
+        }
+        if (algo != "chacha20") {
+            unsigned char check[CHECK_SIZE];
+            keyCheck(key, journal.keySalt, check);
+            if (std::memcmp(check, journal.keyCheck, CHECK_SIZE) != 0) {
+                std::cerr << "Error: The key is not the one the interrupted run used.\n";
+                return false;
+            }
+        }
+        if (!makeCipher(journal, key, cipher)) return false;
+        std::cout << (rollback ? "Rolling back" : "Resuming") << " the interrupted in-place "
+                  << (journal.decrypting() ? "decryption" : "encryption") << " of '" << filename << "' ("
+                  << journal.done << " of " << journal.end << " bytes done)...\n";
+    }
+    else {
+        if (rollback) {
+            std::cerr << "Error: '" << filename << "' has no interrupted in-place run to roll back.\n";
+            return false;
+        }
+        journal.decrypt = decrypt;
+        journal.algorithm = algo;
+        journal.dataLength = fileSize;
+        if (algo == "chacha20") {
+            if (decrypt) {
+                size_t headerSize = Encryption::cipherHeaderSize(algo);
+                journal.header.resize(headerSize);
+                if (fileSize < headerSize || !file.readAt(fileSize - headerSize, &journal.header[0], headerSize)) {
+                    std::cerr << "Decryption failed: not a ChaCha20 file encrypted in place.\n";
+                    return false;
+                }
+                journal.dataLength = fileSize - headerSize;
+                if (!cipherReady(algo, Encryption::createDecryptor(algo, key, journal.header, cipher))) return false;
+            }
+            else if (!cipherReady(algo, Encryption::createEncryptor(algo, key, journal.header, cipher))) {
+                return false;
+            }
+        }
+        else {
+            std::random_device random;
+            for (size_t i = 0; i < SALT_SIZE; ++i) journal.keySalt[i] = (unsigned char)random();
+            keyCheck(key, journal.keySalt, journal.keyCheck);
+            if (!makeCipher(journal, key, cipher)) return false;
+        }
+        if (journal.dataLength > cipher.maxStream) {
+            std::cerr << "Error: File is too large for one key stream of this cipher.\n";
+            return false;
+        }
+        journal.end = journal.dataLength;
+
+        if (!journalFile.open(journalPath, true) || !journalFile.resize(2 * SLOT_SIZE) || !saveJournal(journalFile, journal)) {
+            std::cerr << "Error: Could not create the journal '" << journalPath << "'.\n";
+            return false;
+        }
+        std::cout << (decrypt ? "Decrypting '" : "Encrypting '") << filename << "' in place using " << algo << "...\n";
+    }
+
+    if (threads == 0) threads = 1;
+    ThreadPool pool(threads - 1);
+
+    if (!journal.before.empty() && !settleChunk(file, journal, journalFile, cipher, pool)) return false;
+
+    // A rollback runs the settled run's transform backwards over what it had done.
+    if (rollback && !journal.rollback) {
+        journal.rollback = true;
+        journal.end = journal.done;
+        journal.done = 0;
+        journal.position = 0;
+        cipher = Encryption::ChunkCipher();
+        if (!makeCipher(journal, key, cipher) || !saveJournal(journalFile, journal)) return false;
+    }
+
+    std::vector<char> chunk;
+    while (journal.done < journal.end) {
+        // The journal is current between chunks, so a cancelled run stops like an
+        // interrupted one and can be finished or rolled back the same way.
+        if (Cancellation::requested()) {
+            std::cerr << "Cancelled at byte " << journal.done << " of '" << filename
+                      << "'; run the command again to finish or --rollback to undo.\n";
+            return false;
+        }
+        size_t n = (size_t)std::min<uint64_t>(CHUNK_SIZE, journal.end - journal.done);
+        chunk.resize(n);
+        if (!file.readAt(journal.done, chunk.data(), n)) {
+            std::cerr << "Error: Could not read '" << filename << "' at byte " << journal.done << ".\n";
+            return false;
+        }
+        pageChecksums(pool, chunk.data(), n, journal.before);
+        uint64_t position = Encryption::applyPieces(pool, cipher, split(chunk.data(), n, PIECE_SIZE), journal.position);
+        pageChecksums(pool, chunk.data(), n, journal.after);
+
+        if (!saveJournal(journalFile, journal)) {
+            std::cerr << "Error: Could not write the journal '" << journalPath << "'.\n";
+            return false;
+        }
+        if (!file.writeAt(journal.done, chunk.data(), n) || !file.sync()) {
+            std::cerr << "Error: Could not write '" << filename << "' at byte " << journal.done
+                      << "; run the command again to finish or --rollback to undo.\n";
+            return false;
+        }
+        journal.done += n;
+        journal.position = position;
+    }
+
+    if (!finishTrailer(file, journal)) {
+        std::cerr << "Error: Could not finish '" << filename << "'; run the command again.\n";
+        return false;
+    }
+    journalFile.close();
+    std::error_code ec;
+    fs::remove(journalPath, ec);
+
+    if (journal.rollback) {
+        std::cout << "Rolled back '" << filename << "' to its state before the interrupted run.\n";
+    }
+    else {
+        std::cout << "File " << (journal.decrypt ? "decrypted" : "encrypted") << " in place: " << filename
+                  << " (" << journal.dataLength << " bytes)\n";
+    }
+    return true;
+}
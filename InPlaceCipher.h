@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+
+// Encrypts or decrypts a file in its own storage, for the length-preserving ciphers
+// (Caesar, XOR, Vigenere and ChaCha20), so no second copy of the file is needed and
+// every byte is written once. The file is rewritten chunk by chunk through positional
+// reads and writes; a small journal next to it (<file>.journal) records how far the
+// run got, so a run that was interrupted can be finished or rolled back.
+//
+// ChaCha20 keeps its header (salt and key check) as a 29-byte trailer at the end of
+// the file instead of in front, since putting it in front would mean moving every
+// byte; such files are decrypted with decrypt --inplace.
+class InPlaceCipher {
+public:
+    // Transforms `filename` with `algorithm` (decrypting when `decrypt` is set). If the
+    // file has a journal, the interrupted run is resumed instead - or, with `rollback`,
+    // undone, leaving the file as it was before that run started.
+    static bool run(const std::string& algorithm, const std::string& filename, const std::string& key,
+                    bool decrypt, bool rollback, unsigned threads = 1);
+};
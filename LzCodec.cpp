@@ -0,0 +1,210 @@
+#include "LzCodec.h"
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+namespace {
+    const size_t MIN_MATCH = 4;
+    const size_t MAX_OFFSET = 65535;
+    const int HASH_BITS = 16;
+    const size_t HASH_SIZE = (size_t)1 << HASH_BITS;
+
+    // How many earlier positions with the same hash are tried before giving up. Higher
+    // finds longer matches at the cost of encoder speed; decoding is unaffected.
+    const int MAX_CHAIN = 8;
+
+    // After this many consecutive positions without a match the encoder starts
+    // stepping over input faster, so incompressible stretches cost little time.
+    const int SKIP_TRIGGER = 6;
+
+    inline uint32_t read32(const unsigned char* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline uint64_t read64(const unsigned char* p) {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    inline uint32_t hash4(uint32_t value) {
+        return (value * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    // Length of the common prefix of a and b, not reading past `end` on b's side
+    // (a always trails b, so it stays in bounds too).
+    inline size_t matchLength(const unsigned char* a, const unsigned char* b, const unsigned char* end) {
+        const unsigned char* start = b;
+        while (b + 8 <= end && read64(a) == read64(b)) {
+            a += 8;
+            b += 8;
+        }
+        while (b < end && *a == *b) {
+            a++;
+            b++;
+        }
+        return (size_t)(b - start);
+    }
+
+    void appendLength(std::vector<char>& out, size_t length) {
+        while (length >= 255) {
+            out.push_back((char)255);
+            length -= 255;
+        }
+        out.push_back((char)length);
+    }
+
+    void appendSequence(std::vector<char>& out, const unsigned char* literals, size_t literalLength,
+                        size_t offset, size_t match) {
+        size_t matchCode = match - MIN_MATCH;
+        unsigned char token = (unsigned char)(((literalLength < 15 ? literalLength : 15) << 4) |
+                                              (matchCode < 15 ? matchCode : 15));
+        out.push_back((char)token);
+        if (literalLength >= 15) appendLength(out, literalLength - 15);
+        out.insert(out.end(), literals, literals + literalLength);
+        out.push_back((char)(offset & 0xFF));
+        out.push_back((char)(offset >> 8));
+        if (matchCode >= 15) appendLength(out, matchCode - 15);
+    }
+
+    void appendLastLiterals(std::vector<char>& out, const unsigned char* literals, size_t literalLength) {
+        out.push_back((char)((literalLength < 15 ? literalLength : 15) << 4));
+        if (literalLength >= 15) appendLength(out, literalLength - 15);
+        out.insert(out.end(), literals, literals + literalLength);
+    }
+
+    bool readLength(const unsigned char*& p, const unsigned char* end, size_t& length) {
+        unsigned char byte;
+        do {
+            if (p == end) return false;
+            byte = *p++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+}
+
+void LzCodec::compress(const char* block, size_t n, std::vector<char>& out) const {
+    const unsigned char* data = (const unsigned char*)block;
+    const unsigned char* end = data + n;
+    out.clear();
+    out.reserve(maxCompressedSize(n));
+
+    // Match-finder tables are reused across calls on the same thread, so compressing
+    // a file does not allocate per block.
+    thread_local std::vector<int32_t> head;
+    thread_local std::vector<int32_t> chain;
+    head.assign(HASH_SIZE, -1);
+    if (chain.size() < n) chain.resize(n);
+
+    size_t anchor = 0;
+    size_t pos = 0;
+    int misses = 0;
+    while (pos + MIN_MATCH <= n) {
+        uint32_t h = hash4(read32(data + pos));
+        uint32_t prefix = read32(data + pos);
+
+        size_t bestLength = 0;
+        size_t bestOffset = 0;
+        int32_t candidate = head[h];
+        for (int depth = 0; candidate >= 0 && depth < MAX_CHAIN; ++depth) {
+            size_t offset = pos - (size_t)candidate;
+            if (offset > MAX_OFFSET) break;
+            if (read32(data + candidate) == prefix) {
+                size_t length = MIN_MATCH + matchLength(data + candidate + MIN_MATCH, data + pos + MIN_MATCH, end);
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestOffset = offset;
+                }
+            }
+            candidate = chain[candidate];
+        }
+        chain[pos] = head[h];
+        head[h] = (int32_t)pos;
+
+        if (bestLength < MIN_MATCH) {
+            pos += 1 + (size_t)(misses++ >> SKIP_TRIGGER);
+            continue;
+        }
+
+        appendSequence(out, data + anchor, pos - anchor, bestOffset, bestLength);
+
+        // Index the positions the match covers so later data can refer back into it.
+        size_t matchEnd = pos + bestLength;
+        for (size_t i = pos + 1; i < matchEnd && i + MIN_MATCH <= n; ++i) {
+            uint32_t hi = hash4(read32(data + i));
+            chain[i] = head[hi];
+            head[hi] = (int32_t)i;
+        }
+        pos = matchEnd;
+        anchor = pos;
+        misses = 0;
+    }
+
+    if (anchor < n) {
+        appendLastLiterals(out, data + anchor, n - anchor);
+    }
+}
+
+// Every match of four or more bytes costs at most its token and offset, so only the
+// literal length extensions (one byte per 255 literals) and the final token add size.
+size_t LzCodec::maxCompressedSize(size_t n) const {
+    return n + n / 255 + 16;
+}
+
+// Literals are copied once each; a match's bytes come from its length extension, at
+// most 255 per byte (the token, offset and nibble add fewer than a byte each).
+size_t LzCodec::maxDecompressedSize(size_t n) const {
+    return n > SIZE_MAX / 255 ? SIZE_MAX : n * 255;
+}
+
+bool LzCodec::decompress(const char* in, size_t n, char* outBytes, size_t rawSize) const {
+    const unsigned char* p = (const unsigned char*)in;
+    const unsigned char* end = p + n;
+    unsigned char* out = (unsigned char*)outBytes;
+    size_t produced = 0;
+
+    while (p < end) {
+        unsigned char token = *p++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !readLength(p, end, literalLength)) return false;
+        if (literalLength > (size_t)(end - p) || literalLength > rawSize - produced) return false;
+        std::memcpy(out + produced, p, literalLength);
+        p += literalLength;
+        produced += literalLength;
+
+        if (p == end) break; // the last sequence has no match part
+
+        if (end - p < 2) return false;
+        size_t offset = (size_t)p[0] | ((size_t)p[1] << 8);
+        p += 2;
+        if (offset == 0 || offset > produced) return false;
+
+        size_t match = token & 0x0F;
+        if (match == 15 && !readLength(p, end, match)) return false;
+        match += MIN_MATCH;
+        if (match > rawSize - produced) return false;
+
+        unsigned char* dst = out + produced;
+        const unsigned char* src = dst - offset;
+        if (offset >= match) {
+            std::memcpy(dst, src, match);
+        }
+        else {
+            // Overlapping copy: the match repeats the last `offset` bytes. Each memcpy
+            // takes the whole pattern written so far, so the chunk size doubles and even
+            // offset-1 runs need only a logarithmic number of calls.
+            size_t copied = 0;
+            while (copied < match) {
+                size_t chunk = std::min(offset + copied, match - copied);
+                std::memcpy(dst + copied, src, chunk);
+                copied += chunk;
+            }
+        }
+        produced += match;
+    }
+    return produced == rawSize;
+}
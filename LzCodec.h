@@ -0,0 +1,24 @@
+#pragma once
+#include "Codec.h"
+
+// Byte-aligned LZ77 in the style of LZ4. Each sequence is
+//
+//   token        1 byte   high nibble: literal length, low nibble: match length - 4
+//   literal length extension (only if the nibble is 15): bytes added until one is < 255
+//   literals
+//   offset       2 bytes  little-endian distance back to the match, 1..65535
+//   match length extension, encoded like the literal one
+//
+// The final sequence of a block carries literals only and ends the input. Matches
+// are found with a hash chain over 4-byte prefixes, walked to a bounded depth.
+class LzCodec : public Codec {
+public:
+    static const unsigned char ID = 2;
+
+    unsigned char id() const override { return ID; }
+    const char* name() const override { return "lz"; }
+    void compress(const char* data, size_t n, std::vector<char>& out) const override;
+    bool decompress(const char* in, size_t n, char* out, size_t rawSize) const override;
+    size_t maxCompressedSize(size_t n) const override;
+    size_t maxDecompressedSize(size_t n) const override;
+};
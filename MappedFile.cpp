@@ -0,0 +1,137 @@
+#include "MappedFile.h"
+#include <cstdint>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // An empty file has nothing to map; data() still points at valid (empty) memory.
+    const char EMPTY[1] = { 0 };
+
+#if !defined(_WIN32)
+    // Transparent huge pages cut TLB misses on multi-GB sequential scans. Kernels
+    // without huge-page support for file mappings just ignore the hint.
+    const size_t HUGE_PAGE_HINT_THRESHOLD = (size_t)64 << 20; // 64 MiB
+#endif
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const std::string& path, Access access) {
+    close();
+
+    DWORD flags = access == Access::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || (uint64_t)size.QuadPart > (uint64_t)SIZE_MAX) {
+        CloseHandle(file);
+        return false;
+    }
+    if (size.QuadPart == 0) {
+        CloseHandle(file);
+        view = EMPTY;
+        opened = true;
+        return true;
+    }
+
+    // The mapping object keeps the file open; the file handle is no longer needed.
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr) return false;
+
+    view = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        mapping = nullptr;
+        return false;
+    }
+    length = (size_t)size.QuadPart;
+    opened = true;
+    return true;
+}
+
+void MappedFile::release(size_t offset, size_t n) {
+    if (view == nullptr || view == EMPTY || offset >= length) return;
+    if (n > length - offset) n = length - offset;
+    // Unlocking pages that were never locked drops them from the working set.
+    VirtualUnlock((LPVOID)(view + offset), n);
+}
+
+void MappedFile::close() {
+    if (view != nullptr && view != EMPTY) UnmapViewOfFile(view);
+    if (mapping != nullptr) CloseHandle(mapping);
+    mapping = nullptr;
+    view = nullptr;
+    length = 0;
+    opened = false;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path, Access access) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || (uint64_t)info.st_size > (uint64_t)SIZE_MAX) {
+        ::close(fd);
+        return false;
+    }
+    if (info.st_size == 0) {
+        ::close(fd);
+        view = EMPTY;
+        opened = true;
+        return true;
+    }
+
+    // The mapping holds its own reference to the file, so the descriptor can go now.
+    size_t size = (size_t)info.st_size;
+    void* address = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) return false;
+
+    madvise(address, size, access == Access::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+#if defined(MADV_HUGEPAGE)
+    if (access == Access::Sequential && size >= HUGE_PAGE_HINT_THRESHOLD) madvise(address, size, MADV_HUGEPAGE);
+#endif
+
+    view = (const char*)address;
+    length = size;
+    opened = true;
+    return true;
+}
+
+void MappedFile::release(size_t offset, size_t n) {
+    if (view == nullptr || view == EMPTY || offset >= length) return;
+    // Only whole pages inside the range can go; the mapping's last page is partial in
+    // the file but whole in memory, so a range reaching the end may round up.
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start = (offset + page - 1) / page * page;
+    size_t end = n >= length - offset ? (length + page - 1) / page * page : (offset + n) / page * page;
+    if (start < end) madvise((void*)(view + start), end - start, MADV_DONTNEED);
+}
+
+void MappedFile::close() {
+    if (view != nullptr && view != EMPTY) munmap((void*)view, length);
+    view = nullptr;
+    length = 0;
+    opened = false;
+}
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+// Read-only view of a whole file through the OS page cache (mmap on POSIX, a file
+// mapping on Windows). Data is paged in as it is touched and never copied into a
+// user-space buffer, so large files cost no more memory than the pages in use.
+class MappedFile {
+public:
+    // How the caller will walk the file; passed to the kernel as a read-ahead hint.
+    enum class Access { Sequential, Random };
+
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps `path`, replacing any earlier mapping. Returns false if the file cannot be
+    // opened or mapped (or does not fit in the address space of a 32-bit build). An
+    // empty file opens successfully with size() == 0.
+    bool open(const std::string& path, Access access = Access::Sequential);
+    void close();
+
+    // Tells the OS the caller is done with [offset, offset + n): the pages leave this
+    // process's working set but stay in the page cache. Keeps resident memory flat
+    // while streaming through a file larger than RAM.
+    void release(size_t offset, size_t n);
+
+    bool isOpen() const { return opened; }
+    const char* data() const { return view; }
+    size_t size() const { return length; }
+
+private:
+    const char* view = nullptr;
+    size_t length = 0;
+    bool opened = false;
+#if defined(_WIN32)
+    void* mapping = nullptr;
+#endif
+};
@@ -1,16 +1,17 @@
 #include "MemoryManager.h"
+#include "StatCache.h"
 #include <iostream> // For std::cout, std::cerr
-#include <fstream>  // For file operations (though fs::exists is used for checking)
+#include <fstream>  // For file operations (though StatCache is used for checking)
 #include <unordered_map> // For std::unordered_map
 #include <string>   // For std::string
-#include <filesystem> // For fs::exists
+#include <filesystem>
 MemoryManager::MemoryManager() : usedMemoryKB(0) {
 }
 
 // Allocate memory for a file
 void MemoryManager::allocate(const std::string& fileName, int sizeKB) {
-    // Check if the file exists using filesystem
-    if (!fs::exists(fileName)) {
+    // Check if the file exists (usually answered from the stat cache: the caller just asked)
+    if (!StatCache::get().exists(fileName)) {
         std::cout << "Error: File '" << fileName << "' does not exist. Cannot allocate memory.\n";
         return;
     }
@@ -72,5 +73,6 @@ void MemoryManager::displayMemoryUsage() const {
             std::cout << "  File: '" << pair.first << "' -> " << pair.second << " KB\n";
         }
     }
+    StatCache::get().report(std::cout);
     std::cout << "--------------------------\n";
 }
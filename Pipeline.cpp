@@ -0,0 +1,517 @@
+#include "Pipeline.h"
+#include "Codec.h"
+#include "Encryption.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "Crc32c.h"
+#include "Varint.h"
+#include "Cancellation.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+namespace fs = std::filesystem;
+
+// --- Packed container format ---
+//
+//   magic         4 bytes   0x89 'F' 'M' 'P'
+//   version       1 byte    1
+//   codec         1 byte    codec id from CodecRegistry
+//   cipher        1 byte    0 = none, otherwise the encrypt algorithm number (1 = Caesar,
+//                           2 = XOR, 3 = Vigenere, 5 = ChaCha20)
+//   block size    varint    uncompressed size of every block but the last
+//   cipher header           Encryption::cipherHeaderSize bytes (ChaCha20: salt and key check)
+//
+// Everything after the header is one cipher stream holding a sequence of frames:
+//
+//   raw size      varint    0 marks the end of the data; nothing may follow it
+//   payload size  varint
+//   checksum      4 bytes   little-endian CRC-32C of the raw block
+//   payload                 the block compressed with the codec
+//
+// Unlike the framed compressed format there is no block table at the end, so the
+// container can be produced and consumed through a pipe. The checksum catches damage
+// and a wrong Caesar/XOR/Vigenere key, which nothing in the header can detect.
+
+namespace {
+    const size_t BLOCK_SIZE = 1 << 20; // 1 MiB
+
+    // A larger block size in a header is damage, not something to allocate for.
+    const uint64_t MAX_BLOCK_SIZE = 64 << 20;
+
+    const unsigned char MAGIC[4] = { 0x89, 'F', 'M', 'P' };
+    const unsigned char VERSION = 1;
+    const size_t PREFIX_SIZE = sizeof(MAGIC) + 3; // magic, version, codec and cipher bytes
+
+    // Cipher byte -> Encryption algorithm name; Rail Fence (4) has no place here.
+    const char* const CIPHERS[] = { "none", "caesar", "xor", "vigenere", nullptr, "chacha20" };
+    const int CIPHER_COUNT = sizeof(CIPHERS) / sizeof(CIPHERS[0]);
+
+    int cipherId(const std::string& name) {
+        for (int i = 0; i < CIPHER_COUNT; ++i) {
+            if (CIPHERS[i] != nullptr && name == CIPHERS[i]) return i;
+        }
+        return -1;
+    }
+
+    // Where pack and unpack read from: a mapped file, or stdin for "-". Either way
+    // every byte is read once. take() hands out spans of the mapping itself, or of a
+    // buffer filled straight from stdin; readInto() moves the next bytes into memory
+    // the caller owns.
+    class Input {
+    public:
+        bool open(const std::string& name) {
+            if (name != "-") return file.open(name);
+#if defined(_WIN32)
+            _setmode(_fileno(stdin), _O_BINARY);
+#endif
+            stream = stdin;
+            return true;
+        }
+
+        // The whole input when it is a mapped file, nullptr for stdin.
+        const char* mapped() const { return stream == nullptr ? file.data() : nullptr; }
+        size_t mappedSize() const { return file.size(); }
+
+        // Up to n bytes; fewer only at the end of the input. The span stays valid until
+        // the next call.
+        const char* take(size_t n, size_t& got) {
+            if (stream != nullptr) {
+                buffer.resize(n);
+                got = std::fread(buffer.data(), 1, n, stream);
+                return buffer.data();
+            }
+            file.release(released, offset - released);
+            released = offset;
+            got = std::min(n, file.size() - offset);
+            offset += got;
+            return file.data() + released;
+        }
+
+        size_t readInto(char* out, size_t n) {
+            if (stream != nullptr) return std::fread(out, 1, n, stream);
+            size_t got = std::min(n, file.size() - offset);
+            std::memcpy(out, file.data() + offset, got);
+            file.release(offset, got);
+            offset += got;
+            return got;
+        }
+
+        bool failed() const { return stream != nullptr && std::ferror(stream); }
+
+    private:
+        MappedFile file;
+        std::FILE* stream = nullptr;
+        std::vector<char> buffer;
+        size_t offset = 0;
+        size_t released = 0;
+    };
+
+    // Where pack and unpack write to: a file, or stdout for "-". A file that was not
+    // finished is removed, so a failed run leaves nothing that looks like a result.
+    class Output {
+    public:
+        ~Output() {
+            if (!path.empty() && !finished) {
+                file.close();
+                std::error_code ec;
+                fs::remove(path, ec);
+            }
+        }
+
+        bool open(const std::string& name) {
+            if (name == "-") {
+#if defined(_WIN32)
+                _setmode(_fileno(stdout), _O_BINARY);
+#endif
+                stream = stdout;
+                return true;
+            }
+            file.open(name, std::ios::binary);
+            if (!file) return false;
+            path = name;
+            return true;
+        }
+
+        void write(const char* data, size_t n) {
+            if (stream != nullptr) {
+                if (std::fwrite(data, 1, n, stream) != n) error = true;
+            }
+            else {
+                file.write(data, (std::streamsize)n);
+            }
+        }
+
+        // Flushes everything out; false if any write failed.
+        bool finish() {
+            if (stream != nullptr) {
+                finished = std::fflush(stream) == 0 && !error;
+            }
+            else {
+                file.close();
+                finished = !file.fail();
+            }
+            return finished;
+        }
+
+    private:
+        std::ofstream file;
+        std::FILE* stream = nullptr;
+        std::string path;
+        bool error = false;
+        bool finished = false;
+    };
+
+    // One complete frame found in the decrypted stream during unpack.
+    struct Frame {
+        const char* payload;
+        size_t payloadSize;
+        size_t rawSize;
+        uint32_t checksum;
+        size_t rawOffset; // where the block goes in this round's output
+    };
+
+    uint32_t readLE32(const char* p) {
+        const unsigned char* b = (const unsigned char*)p;
+        return (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+    }
+
+    // How messages name an input or output; "-" stands for a standard stream.
+    const char* label(const std::string& name, const char* stream) {
+        return name == "-" ? stream : name.c_str();
+    }
+}
+
+// --- Pack ---
+bool Pipeline::pack(const std::string& inputName, const std::string& outputName, const std::string& codecName,
+                    const std::string& cipherName, const std::string& key, unsigned threads, std::ostream& messages) {
+    int cipher = cipherId(cipherName);
+    if (cipher < 0) {
+        if (cipherName == "railfence") {
+            std::cerr << "Error: Rail Fence needs the whole text at once and cannot be part of a pipeline.\n";
+        }
+        else {
+            std::cerr << "Error: Unknown cipher '" << cipherName << "'. Available: none, caesar, xor, vigenere, chacha20.\n";
+        }
+        return false;
+    }
+    const Codec* codec = nullptr;
+    if (codecName != "auto") {
+        codec = CodecRegistry::find(codecName);
+        if (codec == nullptr) {
+            std::cerr << "Error: Unknown codec '" << codecName << "'. Available: " << CodecRegistry::names() << ", auto.\n";
+            return false;
+        }
+    }
+
+    Encryption::ChunkCipher chunkCipher;
+    std::string cipherHeader;
+    if (cipher != 0) {
+        EngineStatus status = Encryption::createEncryptor(cipherName, key, cipherHeader, chunkCipher);
+        if (status != EngineStatus::Ok) {
+            Encryption::reportError(cipherName, status);
+            return false;
+        }
+    }
+
+    Input input;
+    if (!input.open(inputName)) {
+        std::cerr << "Error: Could not open '" << inputName << "' for reading.\n";
+        return false;
+    }
+    Output output;
+    if (!output.open(outputName)) {
+        std::cerr << "Error: Could not create '" << outputName << "'.\n";
+        return false;
+    }
+
+    if (threads == 0) threads = 1;
+    ThreadPool pool(threads - 1);
+
+    // Input goes in batches of two blocks per thread. Each block is compressed and
+    // checksummed where it lies (in the mapping or the stdin buffer); its frame header
+    // and payload then go through the cipher as pieces of one stream, in place, and
+    // straight out.
+    const size_t batchSize = (size_t)threads * 2;
+    const size_t batchBytes = batchSize * BLOCK_SIZE;
+    std::vector<std::vector<char>> frameHeaders(batchSize);
+    std::vector<std::vector<char>> payloads(batchSize);
+    std::vector<Encryption::Piece> pieces;
+    char endMarker = 0;
+    uint64_t position = 0;
+    uint64_t rawTotal = 0;
+    uint64_t written = 0;
+    uint64_t blocks = 0;
+
+    for (bool first = true;; first = false) {
+        if (Cancellation::requested()) {
+            std::cerr << "Pack of " << label(inputName, "<stdin>") << " cancelled.\n";
+            return false;
+        }
+        size_t got;
+        const char* data = input.take(batchBytes, got);
+        if (input.failed()) {
+            std::cerr << "Error reading " << label(inputName, "<stdin>") << ".\n";
+            return false;
+        }
+
+        if (first) {
+            // Files are sampled across their whole length, like compress does; stdin
+            // can only be sampled from what has arrived so far.
+            if (codec == nullptr) {
+                codec = input.mapped() != nullptr ? CodecRegistry::chooseFor(input.mapped(), input.mappedSize())
+                                                  : CodecRegistry::chooseFor(data, got);
+            }
+            std::vector<char> header(MAGIC, MAGIC + sizeof(MAGIC));
+            header.push_back((char)VERSION);
+            header.push_back((char)codec->id());
+            header.push_back((char)cipher);
+            appendVarint(header, BLOCK_SIZE);
+            header.insert(header.end(), cipherHeader.begin(), cipherHeader.end());
+            output.write(header.data(), header.size());
+            written += header.size();
+        }
+
+        size_t count = (got + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        pool.parallelFor(count, [&](size_t i) {
+            const char* block = data + i * BLOCK_SIZE;
+            size_t n = std::min(BLOCK_SIZE, got - i * BLOCK_SIZE);
+            codec->compress(block, n, payloads[i]);
+            uint32_t checksum = Crc32c::update(0, block, n);
+            std::vector<char>& frameHeader = frameHeaders[i];
+            frameHeader.clear();
+            appendVarint(frameHeader, n);
+            appendVarint(frameHeader, payloads[i].size());
+            for (int b = 0; b < 4; ++b) frameHeader.push_back((char)(checksum >> (8 * b)));
+        });
+
+        bool last = got < batchBytes;
+        pieces.clear();
+        uint64_t batchOut = 0;
+        for (size_t i = 0; i < count; ++i) {
+            pieces.push_back({ frameHeaders[i].data(), frameHeaders[i].size() });
+            pieces.push_back({ payloads[i].data(), payloads[i].size() });
+            batchOut += frameHeaders[i].size() + payloads[i].size();
+        }
+        if (last) {
+            pieces.push_back({ &endMarker, 1 });
+            batchOut += 1;
+        }
+        if (position + batchOut > chunkCipher.maxStream) {
+            std::cerr << "Error: Input is too large for one key stream of " << cipherName << ".\n";
+            return false;
+        }
+        if (chunkCipher.apply) position = Encryption::applyPieces(pool, chunkCipher, pieces, position);
+
+        for (const Encryption::Piece& piece : pieces) output.write(piece.data, piece.n);
+        written += batchOut;
+        rawTotal += got;
+        blocks += count;
+        if (last) break;
+    }
+
+    if (!output.finish()) {
+        std::cerr << "Error writing " << label(outputName, "<stdout>") << ".\n";
+        return false;
+    }
+    messages << "Packed "<< label(inputName, "<stdin>") << " (" << rawTotal << " bytes, " << blocks << " blocks) to "
+              << label(outputName, "<stdout>") << " (" << written << " bytes; codec "
+              << codec->name() << ", cipher " << cipherName << ")\n";
+    return true;
+}
+
+// --- Unpack ---
+bool Pipeline::unpack(const std::string& inputName, const std::string& outputName, const std::string& key, unsigned threads,
+                      std::ostream& messages) {
+    Input input;
+    if (!input.open(inputName)) {
+        std::cerr << "Error: Could not open '" << inputName << "' for reading.\n";
+        return false;
+    }
+
+    char prefix[PREFIX_SIZE];
+    if (input.readInto(prefix, PREFIX_SIZE) != PREFIX_SIZE || std::memcmp(prefix, MAGIC, sizeof(MAGIC)) != 0) {
+        std::cerr << "Error: " << label(inputName, "<stdin>") << " is not a packed file.\n";
+        return false;
+    }
+    if ((unsigned char)prefix[4] != VERSION) {
+        std::cerr << "Error: Unsupported packed format version " << (int)(unsigned char)prefix[4] << ".\n";
+        return false;
+    }
+    const Codec* codec = CodecRegistry::find((unsigned char)prefix[5]);
+    if (codec == nullptr) {
+        std::cerr << "Error: Unknown compression codec " << (int)(unsigned char)prefix[5] << ".\n";
+        return false;
+    }
+    int cipher = (unsigned char)prefix[6];
+    if (cipher >= CIPHER_COUNT || CIPHERS[cipher] == nullptr) {
+        std::cerr << "Error: Unknown cipher " << cipher << " in packed file.\n";
+        return false;
+    }
+    std::string cipherName = CIPHERS[cipher];
+
+    // The block size varint has to come in a byte at a time: nothing says how long it is.
+    char varint[10];
+    size_t varintSize = 0;
+    do {
+        if (varintSize == sizeof(varint) || input.readInto(varint + varintSize, 1) != 1) {
+            std::cerr << "Error: Packed file header is truncated.\n";
+            return false;
+        }
+    } while ((unsigned char)varint[varintSize++] & 0x80);
+    const char* vp = varint;
+    uint64_t blockSize;
+    if (!parseVarint(vp, varint + varintSize, blockSize) || blockSize == 0 || blockSize > MAX_BLOCK_SIZE) {
+        std::cerr << "Error: Packed file header is damaged.\n";
+        return false;
+    }
+
+    Encryption::ChunkCipher chunkCipher;
+    if (cipher != 0) {
+        std::string header(Encryption::cipherHeaderSize(cipherName), '\0');
+        if (input.readInto(&header[0], header.size()) != header.size()) {
+            std::cerr << "Error: Packed file header is truncated.\n";
+            return false;
+        }
+        EngineStatus status = Encryption::createDecryptor(cipherName, key, header, chunkCipher);
+        if (status != EngineStatus::Ok) {
+            Encryption::reportError(cipherName, status);
+            return false;
+        }
+    }
+
+    Output output;
+    if (!output.open(outputName)) {
+        std::cerr << "Error: Could not create '" << outputName << "'.\n";
+        return false;
+    }
+
+    if (threads == 0) threads = 1;
+    ThreadPool pool(threads - 1);
+
+    // Each round cuts up to two frames per thread out of the decrypted buffer. Those are
+    // decompressed and checked in parallel into one output buffer, written with one
+    // call. When the buffer holds fewer whole frames than that, the unparsed rest moves
+    // to the front and the next two blocks' worth per thread is read and decrypted in
+    // place after it, so memory stays at a few blocks however well the data compressed.
+    const size_t batchSize = (size_t)threads * 2;
+    const size_t readSize = batchSize * BLOCK_SIZE;
+    const uint64_t maxFrame = 20 + 4 + codec->maxCompressedSize((size_t)blockSize); // two varints, checksum, payload
+    std::vector<char> buffer;
+    std::vector<char> raw;
+    std::vector<Frame> frames;
+    std::vector<Encryption::Piece> pieces;
+    std::vector<char> intact;
+    size_t start = 0;   // buffer[start, pending) is decrypted but not yet parsed
+    size_t pending = 0;
+    uint64_t position = 0;
+    uint64_t rawTotal = 0;
+    uint64_t blocks = 0;
+    bool ended = false;
+    bool atEnd = false;
+
+    while (true) {
+        if (Cancellation::requested()) {
+            std::cerr << "Unpack of " << label(inputName, "<stdin>") << " cancelled.\n";
+            return false;
+        }
+        const char* p = buffer.data() + start;
+        const char* end = buffer.data() + pending;
+        frames.clear();
+        size_t rawSize = 0;
+        while (frames.size() < batchSize) {
+            const char* q = p;
+            uint64_t frameRaw, payloadSize;
+            if (!parseVarint(q, end, frameRaw)) break;
+            if (frameRaw == 0) {
+                ended = true;
+                p = q;
+                break;
+            }
+            if (!parseVarint(q, end, payloadSize)) break;
+            if (frameRaw > blockSize || payloadSize > codec->maxCompressedSize((size_t)frameRaw)) {
+                std::cerr << "Error: Block " << blocks + frames.size() + 1 << " of " << label(inputName, "<stdin>")
+                          << " has a damaged frame header (or the key is wrong).\n";
+                return false;
+            }
+            if ((uint64_t)(end - q) < 4 + payloadSize) break;
+            frames.push_back({ q + 4, (size_t)payloadSize, (size_t)frameRaw, readLE32(q), rawSize });
+            rawSize += (size_t)frameRaw;
+            p = q + 4 + payloadSize;
+        }
+
+        if (!ended && frames.size() < batchSize && !atEnd) {
+            if ((uint64_t)(end - p) > maxFrame) {
+                std::cerr << "Error: " << label(inputName, "<stdin>") << " has a damaged frame header (or the key is wrong).\n";
+                return false;
+            }
+            pending -= start;
+            std::memmove(buffer.data(), buffer.data() + start, pending);
+            start = 0;
+            buffer.resize(pending + readSize);
+            size_t got = input.readInto(buffer.data() + pending, readSize);
+            if (input.failed()) {
+                std::cerr << "Error reading " << label(inputName, "<stdin>") << ".\n";
+                return false;
+            }
+            atEnd = got < readSize;
+            if (chunkCipher.apply) {
+                pieces.clear();
+                for (size_t offset = 0; offset < got; offset += BLOCK_SIZE) {
+                    pieces.push_back({ buffer.data() + pending + offset, std::min(BLOCK_SIZE, got - offset) });
+                }
+                position = Encryption::applyPieces(pool, chunkCipher, pieces, position);
+            }
+            pending += got;
+            continue;
+        }
+        if (frames.empty() && !ended) {
+            std::cerr << "Error: " << label(inputName, "<stdin>") << " is truncated (no end marker).\n";
+            return false;
+        }
+
+        raw.resize(rawSize);
+        intact.assign(frames.size(), 0);
+        pool.parallelFor(frames.size(), [&](size_t i) {
+            const Frame& frame = frames[i];
+            char* block = raw.data() + frame.rawOffset;
+            intact[i] = codec->decompress(frame.payload, frame.payloadSize, block, frame.rawSize) &&
+                        Crc32c::update(0, block, frame.rawSize) == frame.checksum;
+        });
+        for (size_t i = 0; i < frames.size(); ++i) {
+            if (!intact[i]) {
+                std::cerr << "Error: Block " << blocks + i + 1 << " of " << label(inputName, "<stdin>")
+                          << " does not match its checksum (damaged data or wrong key).\n";
+                return false;
+            }
+        }
+        output.write(raw.data(), raw.size());
+        rawTotal += rawSize;
+        blocks += frames.size();
+        start = (size_t)(p - buffer.data());
+        if (ended) break;
+    }
+
+    char extra;
+    if (start != pending || input.readInto(&extra, 1) != 0) {
+        std::cerr << "Error: " << label(inputName, "<stdin>") << " has data after its end marker.\n";
+        return false;
+    }
+    if (!output.finish()) {
+        std::cerr << "Error writing " << label(outputName, "<stdout>") << ".\n";
+        return false;
+    }
+    messages << "Unpacked "<< label(inputName, "<stdin>") << " to " << label(outputName, "<stdout>")
+              << " (" << rawTotal << " bytes, " << blocks << " blocks; codec " << codec->name() << ", cipher "
+              << cipherName << ")\n";
+    return true;
+}
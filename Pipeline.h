@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <ostream>
+#include <iostream>
+
+// Compression and a stream cipher fused into one pass over the data (the pack and
+// unpack commands). Each block is compressed, framed and encrypted while it is in
+// cache, so the input is read once and the output written once, with no temporary
+// file between the stages. Either side may be "-" for stdin/stdout, which lets the
+// commands sit in a shell pipeline; the container is written and read strictly front
+// to back for that reason. The line reporting a finished run goes to `messages`: when
+// the output is stdout, the caller passes std::cerr so it stays out of the data.
+class Pipeline {
+public:
+    // `codecName` is a CodecRegistry name, or "auto" to pick one from a sample of the
+    // input. `cipherName` is "none" or one of the stream ciphers of Encryption
+    // (caesar, xor, vigenere, chacha20); Rail Fence needs the whole text and is refused.
+    static bool pack(const std::string& input, const std::string& output, const std::string& codecName,
+                     const std::string& cipherName, const std::string& key, unsigned threads = 1,
+                     std::ostream& messages = std::cout);
+
+    // The codec and cipher are read from the container; only the key is needed.
+    static bool unpack(const std::string& input, const std::string& output, const std::string& key, unsigned threads = 1,
+                       std::ostream& messages = std::cout);
+};
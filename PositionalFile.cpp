@@ -0,0 +1,153 @@
+#include "PositionalFile.h"
+#include <algorithm>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+namespace {
+    // Largest transfer handed to one system call; ReadFile/WriteFile take a 32-bit
+    // count and POSIX allows short transfers anyway.
+    const size_t MAX_TRANSFER = (size_t)1 << 30;
+}
+
+PositionalFile::~PositionalFile() {
+    close();
+}
+
+#if defined(_WIN32)
+
+bool PositionalFile::open(const std::string& path, bool create) {
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                              create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    handle = file;
+    return true;
+}
+
+void PositionalFile::close() {
+    if (handle != nullptr) CloseHandle((HANDLE)handle);
+    handle = nullptr;
+}
+
+bool PositionalFile::isOpen() const {
+    return handle != nullptr;
+}
+
+bool PositionalFile::size(uint64_t& bytes) const {
+    LARGE_INTEGER value;
+    if (handle == nullptr || !GetFileSizeEx((HANDLE)handle, &value)) return false;
+    bytes = (uint64_t)value.QuadPart;
+    return true;
+}
+
+bool PositionalFile::readAt(uint64_t offset, void* data, size_t n) {
+    char* p = (char*)data;
+    while (n > 0) {
+        OVERLAPPED at = {};
+        at.Offset = (DWORD)offset;
+        at.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD done = 0;
+        if (!ReadFile((HANDLE)handle, p, (DWORD)std::min(n, MAX_TRANSFER), &done, &at) || done == 0) return false;
+        p += done;
+        offset += done;
+        n -= done;
+    }
+    return true;
+}
+
+bool PositionalFile::writeAt(uint64_t offset, const void* data, size_t n) {
+    const char* p = (const char*)data;
+    while (n > 0) {
+        OVERLAPPED at = {};
+        at.Offset = (DWORD)offset;
+        at.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD done = 0;
+        if (!WriteFile((HANDLE)handle, p, (DWORD)std::min(n, MAX_TRANSFER), &done, &at) || done == 0) return false;
+        p += done;
+        offset += done;
+        n -= done;
+    }
+    return true;
+}
+
+bool PositionalFile::resize(uint64_t bytes) {
+    LARGE_INTEGER position;
+    position.QuadPart = (LONGLONG)bytes;
+    return handle != nullptr && SetFilePointerEx((HANDLE)handle, position, nullptr, FILE_BEGIN) &&
+           SetEndOfFile((HANDLE)handle);
+}
+
+bool PositionalFile::sync() {
+    return handle != nullptr && FlushFileBuffers((HANDLE)handle);
+}
+
+#else
+
+bool PositionalFile::open(const std::string& path, bool create) {
+    close();
+    int flags = O_RDWR | (create ? O_CREAT | O_TRUNC : 0);
+    fd = ::open(path.c_str(), flags, 0644);
+    return fd >= 0;
+}
+
+void PositionalFile::close() {
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+}
+
+bool PositionalFile::isOpen() const {
+    return fd >= 0;
+}
+
+bool PositionalFile::size(uint64_t& bytes) const {
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) return false;
+    bytes = (uint64_t)info.st_size;
+    return true;
+}
+
+bool PositionalFile::readAt(uint64_t offset, void* data, size_t n) {
+    char* p = (char*)data;
+    while (n > 0) {
+        ssize_t done = pread(fd, p, std::min(n, MAX_TRANSFER), (off_t)offset);
+        if (done < 0 && errno == EINTR) continue;
+        if (done <= 0) return false;
+        p += done;
+        offset += (uint64_t)done;
+        n -= (size_t)done;
+    }
+    return true;
+}
+
+bool PositionalFile::writeAt(uint64_t offset, const void* data, size_t n) {
+    const char* p = (const char*)data;
+    while (n > 0) {
+        ssize_t done = pwrite(fd, p, std::min(n, MAX_TRANSFER), (off_t)offset);
+        if (done < 0 && errno == EINTR) continue;
+        if (done <= 0) return false;
+        p += done;
+        offset += (uint64_t)done;
+        n -= (size_t)done;
+    }
+    return true;
+}
+
+bool PositionalFile::resize(uint64_t bytes) {
+    return fd >= 0 && ftruncate(fd, (off_t)bytes) == 0;
+}
+
+bool PositionalFile::sync() {
+    return fd >= 0 && fsync(fd) == 0;
+}
+
+#endif
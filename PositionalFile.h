@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// Read-write access to a file by offset (pread/pwrite on POSIX, ReadFile/WriteFile
+// with an explicit offset on Windows) plus a flush that reaches the disk. Used where
+// the order in which writes become durable matters - in-place encryption and its
+// journal; code that only reads a file goes through MappedFile.
+class PositionalFile {
+public:
+    PositionalFile() = default;
+    ~PositionalFile();
+
+    PositionalFile(const PositionalFile&) = delete;
+    PositionalFile& operator=(const PositionalFile&) = delete;
+
+    // Opens an existing file for reading and writing; with `create`, creates it (or
+    // empties an existing one) first. Returns false if that is not possible.
+    bool open(const std::string& path, bool create = false);
+    void close();
+    bool isOpen() const;
+
+    // Current size of the file, or false on error.
+    bool size(uint64_t& bytes) const;
+
+    // Transfer exactly n bytes at `offset`. A read past the end of the file fails.
+    bool readAt(uint64_t offset, void* data, size_t n);
+    bool writeAt(uint64_t offset, const void* data, size_t n);
+
+    // Cuts the file to `bytes` (or extends it with zeros).
+    bool resize(uint64_t bytes);
+
+    // Returns once everything written so far is on the disk (fsync, FlushFileBuffers).
+    bool sync();
+
+private:
+#if defined(_WIN32)
+    void* handle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
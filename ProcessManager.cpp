@@ -1,42 +1,139 @@
 #include "ProcessManager.h"
+#include "Cancellation.h"
 #include <iostream>
 #include <thread> // Included in original, keeping for completeness though not used for simulation here
 #include <chrono> // Included in original, keeping for completeness
 #include <algorithm> 
 #include <vector> 
+#include <unordered_map>
+
+namespace {
+    const char* statusName(ProcessStatus status) {
+        switch (status) {
+        case ProcessStatus::Pending: return "Pending";
+        case ProcessStatus::Running: return "Running";
+        case ProcessStatus::Completed: return "Completed";
+        case ProcessStatus::Failed: return "Failed";
+        case ProcessStatus::Cancelled: return "Cancelled";
+        }
+        return "Unknown";
+    }
+
+    // Per-file entries of a batch listed by name in procstatus; the rest are counted.
+    const size_t MAX_LISTED_CHILDREN = 10;
+
+    bool isActive(const Process& proc) {
+        return proc.status == ProcessStatus::Pending || proc.status == ProcessStatus::Running;
+    }
+
+    bool isActiveJob(const Process& proc) {
+        return proc.cancel != nullptr && isActive(proc);
+    }
+
+    // "12.3 s", written without touching the stream's formatting flags.
+    std::string seconds(std::chrono::steady_clock::duration elapsed) {
+        long long tenths = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() / 100;
+        return std::to_string(tenths / 10) + "." + std::to_string(tenths % 10) + " s";
+    }
+}
 
 ProcessManager::ProcessManager() : nextId(1) {}
-int ProcessManager::addProcess(const std::string& taskName) {
+
+ProcessManager::~ProcessManager() {
+    size_t active = activeJobs();
+    if (active > 0) {
+        std::cout << "Waiting for " << active << (active == 1 ? " background job" : " background jobs") << " to finish...\n";
+        waitAll();
+    }
+    workers.reset();
+}
+
+int ProcessManager::addProcess(const std::string& taskName, std::ostream& messages) {
+    std::lock_guard<std::mutex> lock(mutex);
     int currentId = nextId++; 
-    processQueue.push_back({ currentId, taskName, ProcessStatus::Pending }); 
-    std::cout << "Process added: '" << taskName << "' [ID: " << currentId << "]\n";
+    processQueue.push_back({ currentId, taskName, ProcessStatus::Pending, nullptr, std::chrono::steady_clock::now(), {} });
+    messages << "Process added: '" << taskName << "' [ID: " << currentId << "]\n";
     return currentId;
 }
+
+int ProcessManager::addChild(int parentId, const std::string& taskName) {
+    std::lock_guard<std::mutex> lock(mutex);
+    int currentId = nextId++;
+    processQueue.push_back({ currentId, taskName, ProcessStatus::Pending, nullptr, std::chrono::steady_clock::now(), {}, parentId });
+    return currentId;
+}
+
+// Ids are handed out in increasing order and clearing keeps the order, so the queue
+// stays sorted by id; a long batch would otherwise make every lookup a linear scan.
+Process* ProcessManager::find(int id) {
+    auto proc = std::lower_bound(processQueue.begin(), processQueue.end(), id,
+                                 [](const Process& p, int value) { return p.id < value; });
+    return proc != processQueue.end() && proc->id == id ? &*proc : nullptr;
+}
+
+const Process* ProcessManager::find(int id) const {
+    return const_cast<ProcessManager*>(this)->find(id);
+}
+
 void ProcessManager::updateProcessStatus(int id, ProcessStatus status) {
-    for (auto& proc : processQueue) {
-        if (proc.id == id) {
-            proc.status = status;
-            return;
-        }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Process* proc = find(id)) {
+        proc->status = status;
     }
 }
+bool ProcessManager::hasFailed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return std::any_of(processQueue.begin(), processQueue.end(),
+                       [](const Process& proc) { return proc.status == ProcessStatus::Failed; });
+}
 void ProcessManager::showStatus() const {
+    std::lock_guard<std::mutex> lock(mutex);
     if (processQueue.empty()) {
         std::cout << "No processes in the queue.\n";
         return;
     }
 
+    // A batch's per-file entries are shown under it as counts, plus the ones that
+    // have not completed; a batch over thousands of files stays readable.
+    std::unordered_map<int, std::vector<const Process*>> children;
+    for (const auto& proc : processQueue) {
+        if (proc.parent != 0 && find(proc.parent) != nullptr) children[proc.parent].push_back(&proc);
+    }
+
+    auto now = std::chrono::steady_clock::now();
     std::cout << "\n--- Process Queue Status ---\n";
     for (const auto& proc : processQueue) {
-        std::string statusStr;
-        switch (proc.status) {
-        case ProcessStatus::Pending: statusStr = "Pending"; break;
-        case ProcessStatus::Running: statusStr = "Running"; break;
-        case ProcessStatus::Completed: statusStr = "Completed"; break;
-        case ProcessStatus::Failed: statusStr = "Failed"; break;
-        default: statusStr = "Unknown"; break;
+        if (proc.parent != 0 && children.count(proc.parent) != 0) continue;
+        std::cout << "  [ID: " << proc.id << "] '" << proc.name << "' - " << statusName(proc.status);
+        if (proc.cancel != nullptr) {
+            // Background jobs show how long they have been running, or took.
+            if (proc.status == ProcessStatus::Running) std::cout << " for " << seconds(now - proc.started);
+            else if (!isActive(proc) && proc.finished != std::chrono::steady_clock::time_point()) {
+                std::cout << " after " << seconds(proc.finished - proc.started);
+            }
+            std::cout << " (background)";
+        }
+        std::cout << "\n";
+
+        auto batch = children.find(proc.id);
+        if (batch == children.end()) continue;
+        size_t counts[5] = {};
+        size_t listed = 0;
+        for (const Process* child : batch->second) {
+            counts[(int)child->status]++;
+            if (child->status != ProcessStatus::Completed && listed < MAX_LISTED_CHILDREN) {
+                std::cout << "      [ID: " << child->id << "] '" << child->name << "' - " << statusName(child->status) << "\n";
+                ++listed;
+            }
+        }
+        std::cout << "      " << batch->second.size() << " files:";
+        const char* separator = " ";
+        for (int status = 0; status < 5; ++status) {
+            if (counts[status] == 0) continue;
+            std::cout << separator << counts[status] << " " << statusName((ProcessStatus)status);
+            separator = ", ";
         }
-        std::cout << "  [ID: " << proc.id << "] '" << proc.name << "' - " << statusStr << "\n";
+        std::cout << "\n";
     }
     std::cout << "----------------------------\n";
 }
@@ -45,6 +142,7 @@ void ProcessManager::clearCompleted() {
     std::cout << "Cleared all completed processes.\n";
 }
 void ProcessManager::clearByStatus(ProcessStatus status) {
+    std::lock_guard<std::mutex> lock(mutex);
     processQueue.erase(
         std::remove_if(processQueue.begin(), processQueue.end(),
             [status](const Process& p) { return p.status == status; }),
@@ -52,6 +150,124 @@ void ProcessManager::clearByStatus(ProcessStatus status) {
     );
 }
 void ProcessManager::clearAll() {
-    processQueue.clear();
-    std::cout << "Cleared all processes from the queue.\n";
+    std::lock_guard<std::mutex> lock(mutex);
+    processQueue.erase(std::remove_if(processQueue.begin(), processQueue.end(),
+                                      [](const Process& p) { return !isActiveJob(p); }),
+                       processQueue.end());
+    if (processQueue.empty()) std::cout << "Cleared all processes from the queue.\n";
+    else std::cout << "Cleared all processes from the queue except " << processQueue.size() << " unfinished background jobs.\n";
+}
+
+// --- Background jobs ---
+int ProcessManager::submit(const std::string& taskName, std::function<bool(int id)> work) {
+    int id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        id = nextId++;
+        processQueue.push_back({ id, taskName, ProcessStatus::Pending, std::make_shared<std::atomic<bool>>(false),
+                                 std::chrono::steady_clock::now(), {} });
+        // Workers are started on first use, so runs without jobs start no threads. Jobs
+        // beyond the number of hardware threads wait Pending for a free worker.
+        if (workers == nullptr) workers.reset(new ThreadPool(std::max(2u, ThreadPool::hardwareThreads())));
+    }
+    std::cout << "Job started in the background: '" << taskName << "' [ID: " << id << "]\n";
+    workers->submit([this, id, work = std::move(work)] { runJob(id, work); });
+    return id;
+}
+
+void ProcessManager::runJob(int id, const std::function<bool(int)>& work) {
+    std::shared_ptr<std::atomic<bool>> cancel;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Process* proc = find(id);
+        if (proc == nullptr || proc->status != ProcessStatus::Pending) return; // killed while queued
+        proc->status = ProcessStatus::Running;
+        proc->started = std::chrono::steady_clock::now();
+        cancel = proc->cancel;
+    }
+
+    bool success;
+    {
+        Cancellation::Scope scope(cancel.get());
+        success = work(id);
+    }
+
+    std::string name;
+    ProcessStatus status = success ? ProcessStatus::Completed : cancel->load() ? ProcessStatus::Cancelled : ProcessStatus::Failed;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (Process* proc = find(id)) {
+            proc->status = status;
+            proc->finished = std::chrono::steady_clock::now();
+            name = proc->name;
+        }
+    }
+    // Reported before waiters wake, so "wait" returns after the job's last line.
+    std::cout << "[ID: " << id << "] '" << name << "' - " << statusName(status) << "\n";
+    jobFinished.notify_all();
+}
+
+bool ProcessManager::wait(int id, ProcessStatus& status) {
+    std::unique_lock<std::mutex> lock(mutex);
+    const Process* proc = find(id);
+    if (proc == nullptr) return false;
+    jobFinished.wait(lock, [&] {
+        proc = find(id);
+        return proc == nullptr || !isActive(*proc);
+    });
+    if (proc == nullptr) return false;
+    status = proc->status;
+    return true;
+}
+
+size_t ProcessManager::waitAll() {
+    std::vector<int> ids;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& proc : processQueue) {
+            if (isActiveJob(proc)) ids.push_back(proc.id);
+        }
+    }
+    size_t unsuccessful = 0;
+    for (int id : ids) {
+        ProcessStatus status;
+        if (!wait(id, status) || status != ProcessStatus::Completed) ++unsuccessful;
+    }
+    return unsuccessful;
+}
+
+bool ProcessManager::cancel(int id) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Process* proc = find(id);
+        if (proc == nullptr || !isActiveJob(*proc)) return false;
+        proc->cancel->store(true);
+        if (proc->status != ProcessStatus::Pending) return true;
+        // Still queued: it ends here, and its worker finds it no longer Pending.
+        proc->status = ProcessStatus::Cancelled;
+        proc->finished = std::chrono::steady_clock::now();
+        std::cout << "[ID: " << id << "] '" << proc->name << "' - " << statusName(proc->status) << "\n";
+    }
+    jobFinished.notify_all();
+    return true;
+}
+
+void ProcessManager::showJobs() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto now = std::chrono::steady_clock::now();
+    bool any = false;
+    for (const auto& proc : processQueue) {
+        if (!isActiveJob(proc)) continue;
+        any = true;
+        std::cout << "  [ID: " << proc.id << "] " << statusName(proc.status);
+        if (proc.status == ProcessStatus::Running) std::cout << " for " << seconds(now - proc.started);
+        if (proc.cancel->load()) std::cout << ", stopping";
+        std::cout << "  " << proc.name << "\n";
+    }
+    if (!any) std::cout << "No background jobs running.\n";
+}
+
+size_t ProcessManager::activeJobs() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return (size_t)std::count_if(processQueue.begin(), processQueue.end(), isActiveJob);
 }
@@ -1,31 +1,80 @@
 #pragma once
 #include <string>
+#include <iostream>
 #include <vector>
 #include <algorithm> 
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include "ThreadPool.h"
 
 enum class ProcessStatus {
     Pending,   
     Running,   
     Completed, 
-    Failed     
+    Failed,
+    Cancelled  // a background job stopped by kill
 };
 
 struct Process {
     int id;           
     std::string name; 
     ProcessStatus status; 
+    std::shared_ptr<std::atomic<bool>> cancel; // set by kill; null for commands run in the foreground
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point finished;
+    int parent = 0; // the batch a per-file entry belongs to; 0 for top-level entries
 };
+
+// The process list, and the worker threads that run background jobs. Foreground
+// commands are only recorded here; a job submitted with submit() really runs on a
+// worker and moves through Pending, Running and Completed/Failed/Cancelled on its own.
+// All members may be called from any thread.
 class ProcessManager {
 private:
-    std::vector<Process> processQueue; 
+    std::vector<Process> processQueue; // sorted by id
     int nextId;
+    mutable std::mutex mutex;
+    std::condition_variable jobFinished;
+    std::unique_ptr<ThreadPool> workers; // created by the first submit; declared last so it is joined first
+
+    Process* find(int id);
+    const Process* find(int id) const;
+    void runJob(int id, const std::function<bool(int)>& work);
 
 public:
     ProcessManager();
-    int addProcess(const std::string& taskName);
+    ~ProcessManager(); // waits for the jobs still running
+    int addProcess(const std::string& taskName, std::ostream& messages = std::cout);
+    int addChild(int parentId, const std::string& taskName); // silent: batches add one per file
     void updateProcessStatus(int id, ProcessStatus status);
     void showStatus() const;
+    bool hasFailed() const; // any process with status Failed
     void clearCompleted();
     void clearByStatus(ProcessStatus status);
-    void clearAll();
+    void clearAll(); // jobs that have not finished stay
+
+    // --- Background jobs ---
+    // Queues work(id) for a worker thread under a new process entry and returns its id.
+    // The job ends Completed or Failed by what work returns, or Cancelled if it was
+    // killed first.
+    int submit(const std::string& taskName, std::function<bool(int id)> work);
+
+    // Blocks until process `id` has finished and sets `status` to how it ended. False if
+    // there is no such process.
+    bool wait(int id, ProcessStatus& status);
+
+    // Blocks until every job has finished. Returns the number that did not complete.
+    size_t waitAll();
+
+    // Asks job `id` to stop. A job still queued never starts; a running one stops at the
+    // next point its work checks Cancellation. False if `id` is not an unfinished job.
+    bool cancel(int id);
+
+    // Lists the jobs that are queued or running.
+    void showJobs() const;
+    size_t activeJobs() const;
 };
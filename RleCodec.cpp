@@ -0,0 +1,70 @@
+#include "RleCodec.h"
+#include "RunScan.h"
+#include "Varint.h"
+#include <cstring>
+#include <cstdint>
+
+// Runs of four or more bytes become run tokens; everything in between goes out as
+// literal tokens that point straight back into the input. RunScan jumps from one run
+// boundary to the next a whole vector at a time, so long runs and long literal
+// stretches are both crossed without a per-byte loop.
+void RleCodec::compress(const char* block, size_t n, std::vector<char>& out) const {
+    const unsigned char* data = (const unsigned char*)block;
+    out.clear();
+    out.reserve(n + n / 64 + 16);
+
+    size_t literalStart = 0;
+    while (true) {
+        size_t runStart = RunScan::findRepeat(data, literalStart, n);
+        if (runStart == n) break;
+        size_t runEnd = RunScan::findRunEnd(data, runStart + 4, n, data[runStart]);
+
+        if (literalStart < runStart) {
+            appendVarint(out, (uint64_t)(runStart - literalStart) << 1);
+            out.insert(out.end(), block + literalStart, block + runStart);
+        }
+        appendVarint(out, ((uint64_t)(runEnd - runStart) << 1) | 1);
+        out.push_back(block[runStart]);
+        literalStart = runEnd;
+    }
+    if (literalStart < n) {
+        appendVarint(out, (uint64_t)(n - literalStart) << 1);
+        out.insert(out.end(), block + literalStart, block + n);
+    }
+}
+
+// A run token saves at least two bytes, which pays for the header of the literal
+// token in front of it unless that literal is over 8 KiB long; only the last literal
+// token is not followed by a run. The bound is looser than that, and cheap to state.
+size_t RleCodec::maxCompressedSize(size_t n) const {
+    return n + n / 64 + 16;
+}
+
+// A run token of a few bytes can stand for a run of any length.
+size_t RleCodec::maxDecompressedSize(size_t n) const {
+    return n == 0 ? 0 : SIZE_MAX;
+}
+
+bool RleCodec::decompress(const char* in, size_t n, char* out, size_t rawSize) const {
+    const char* p = in;
+    const char* end = in + n;
+    size_t produced = 0;
+    while (p < end) {
+        uint64_t header;
+        if (!parseVarint(p, end, header)) return false;
+        uint64_t length = header >> 1;
+        if (length == 0 || length > rawSize - produced) return false;
+
+        if (header & 1) {
+            if (p == end) return false;
+            std::memset(out + produced, *p++, (size_t)length);
+        }
+        else {
+            if ((uint64_t)(end - p) < length) return false;
+            std::memcpy(out + produced, p, (size_t)length);
+            p += length;
+        }
+        produced += (size_t)length;
+    }
+    return produced == rawSize;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "Codec.h"
+
+// Run-length encoding. The token stream is a sequence of LEB128 varints holding
+// (length << 1) | kind: a literal token (kind 0) is followed by `length` raw bytes, a
+// run token (kind 1) by the single byte that repeats `length` times. Runs shorter
+// than four bytes are cheaper to leave inside a literal token.
+class RleCodec : public Codec {
+public:
+    static const unsigned char ID = 1;
+
+    unsigned char id() const override { return ID; }
+    const char* name() const override { return "rle"; }
+    void compress(const char* data, size_t n, std::vector<char>& out) const override;
+    bool decompress(const char* in, size_t n, char* out, size_t rawSize) const override;
+    size_t maxCompressedSize(size_t n) const override;
+    size_t maxDecompressedSize(size_t n) const override;
+};
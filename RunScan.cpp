@@ -0,0 +1,172 @@
+#include "RunScan.h"
+#include "CpuFeatures.h"
+
+#if defined(FMS_X86)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+    typedef size_t (*FindRepeatFn)(const unsigned char*, size_t, size_t);
+    typedef size_t (*FindRunEndFn)(const unsigned char*, size_t, size_t, unsigned char);
+
+    struct Kernels {
+        FindRepeatFn findRepeat;
+        FindRunEndFn findRunEnd;
+        const char* name;
+    };
+
+    // --- Scalar ---
+
+    size_t findRepeatScalar(const unsigned char* data, size_t pos, size_t n) {
+        for (; pos + 3 < n; ++pos) {
+            if (data[pos] == data[pos + 1] && data[pos + 1] == data[pos + 2] && data[pos + 2] == data[pos + 3]) {
+                return pos;
+            }
+        }
+        return n;
+    }
+
+    size_t findRunEndScalar(const unsigned char* data, size_t pos, size_t n, unsigned char value) {
+        while (pos < n && data[pos] == value) pos++;
+        return pos;
+    }
+
+#if defined(FMS_X86)
+    inline unsigned countTrailingZeros32(unsigned value) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, value);
+        return (unsigned)index;
+#else
+        return (unsigned)__builtin_ctz(value);
+#endif
+    }
+
+    inline unsigned countTrailingZeros64(unsigned long long value) {
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return (unsigned)index;
+#elif defined(_MSC_VER)
+        unsigned low = (unsigned)value;
+        return low != 0 ? countTrailingZeros32(low) : 32 + countTrailingZeros32((unsigned)(value >> 32));
+#else
+        return (unsigned)__builtin_ctzll(value);
+#endif
+    }
+
+    // The repeat search compares the stream against itself shifted by one, two and
+    // three bytes; a set bit in the combined mask marks the start of four equal bytes.
+
+    // --- SSE2: 16 bytes per step ---
+
+    FMS_TARGET_SSE2 size_t findRepeatSse2(const unsigned char* data, size_t pos, size_t n) {
+        while (pos + 16 + 3 <= n) {
+            __m128i a = _mm_loadu_si128((const __m128i*)(data + pos));
+            __m128i b = _mm_loadu_si128((const __m128i*)(data + pos + 1));
+            __m128i c = _mm_loadu_si128((const __m128i*)(data + pos + 2));
+            __m128i d = _mm_loadu_si128((const __m128i*)(data + pos + 3));
+            __m128i eq = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(a, b), _mm_cmpeq_epi8(b, c)), _mm_cmpeq_epi8(c, d));
+            unsigned mask = (unsigned)_mm_movemask_epi8(eq);
+            if (mask != 0) return pos + countTrailingZeros32(mask);
+            pos += 16;
+        }
+        return findRepeatScalar(data, pos, n);
+    }
+
+    FMS_TARGET_SSE2 size_t findRunEndSse2(const unsigned char* data, size_t pos, size_t n, unsigned char value) {
+        __m128i pattern = _mm_set1_epi8((char)value);
+        while (pos + 16 <= n) {
+            __m128i block = _mm_loadu_si128((const __m128i*)(data + pos));
+            unsigned differ = ~(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern)) & 0xFFFFu;
+            if (differ != 0) return pos + countTrailingZeros32(differ);
+            pos += 16;
+        }
+        return findRunEndScalar(data, pos, n, value);
+    }
+
+    // --- AVX2: 32 bytes per step ---
+
+    FMS_TARGET_AVX2 size_t findRepeatAvx2(const unsigned char* data, size_t pos, size_t n) {
+        while (pos + 32 + 3 <= n) {
+            __m256i a = _mm256_loadu_si256((const __m256i*)(data + pos));
+            __m256i b = _mm256_loadu_si256((const __m256i*)(data + pos + 1));
+            __m256i c = _mm256_loadu_si256((const __m256i*)(data + pos + 2));
+            __m256i d = _mm256_loadu_si256((const __m256i*)(data + pos + 3));
+            __m256i eq = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(a, b), _mm256_cmpeq_epi8(b, c)), _mm256_cmpeq_epi8(c, d));
+            unsigned mask = (unsigned)_mm256_movemask_epi8(eq);
+            if (mask != 0) return pos + countTrailingZeros32(mask);
+            pos += 32;
+        }
+        return findRepeatSse2(data, pos, n);
+    }
+
+    FMS_TARGET_AVX2 size_t findRunEndAvx2(const unsigned char* data, size_t pos, size_t n, unsigned char value) {
+        __m256i pattern = _mm256_set1_epi8((char)value);
+        while (pos + 32 <= n) {
+            __m256i block = _mm256_loadu_si256((const __m256i*)(data + pos));
+            unsigned differ = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, pattern));
+            if (differ != 0) return pos + countTrailingZeros32(differ);
+            pos += 32;
+        }
+        return findRunEndSse2(data, pos, n, value);
+    }
+
+    // --- AVX-512BW: 64 bytes per step ---
+
+    FMS_TARGET_AVX512BW size_t findRepeatAvx512(const unsigned char* data, size_t pos, size_t n) {
+        while (pos + 64 + 3 <= n) {
+            __m512i a = _mm512_loadu_si512((const void*)(data + pos));
+            __m512i b = _mm512_loadu_si512((const void*)(data + pos + 1));
+            __m512i c = _mm512_loadu_si512((const void*)(data + pos + 2));
+            __m512i d = _mm512_loadu_si512((const void*)(data + pos + 3));
+            unsigned long long mask = (unsigned long long)(_mm512_cmpeq_epi8_mask(a, b) & _mm512_cmpeq_epi8_mask(b, c) &
+                                                           _mm512_cmpeq_epi8_mask(c, d));
+            if (mask != 0) return pos + countTrailingZeros64(mask);
+            pos += 64;
+        }
+        return findRepeatSse2(data, pos, n);
+    }
+
+    FMS_TARGET_AVX512BW size_t findRunEndAvx512(const unsigned char* data, size_t pos, size_t n, unsigned char value) {
+        __m512i pattern = _mm512_set1_epi8((char)value);
+        while (pos + 64 <= n) {
+            __m512i block = _mm512_loadu_si512((const void*)(data + pos));
+            unsigned long long differ = (unsigned long long)_mm512_cmpneq_epi8_mask(block, pattern);
+            if (differ != 0) return pos + countTrailingZeros64(differ);
+            pos += 64;
+        }
+        return findRunEndSse2(data, pos, n, value);
+    }
+#endif
+
+    Kernels select() {
+#if defined(FMS_X86)
+        const CpuFeatures& cpu = CpuFeatures::get();
+        if (cpu.avx512bw) return { findRepeatAvx512, findRunEndAvx512, "avx512bw" };
+        if (cpu.avx2) return { findRepeatAvx2, findRunEndAvx2, "avx2" };
+        if (cpu.sse2) return { findRepeatSse2, findRunEndSse2, "sse2" };
+#endif
+        return { findRepeatScalar, findRunEndScalar, "scalar" };
+    }
+
+    const Kernels& kernels() {
+        static const Kernels active = select();
+        return active;
+    }
+}
+
+size_t RunScan::findRepeat(const unsigned char* data, size_t pos, size_t n) {
+    return kernels().findRepeat(data, pos, n);
+}
+
+size_t RunScan::findRunEnd(const unsigned char* data, size_t pos, size_t n, unsigned char value) {
+    return kernels().findRunEnd(data, pos, n, value);
+}
+
+const char* RunScan::activeVariant() {
+    return kernels().name;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <cstddef>
+
+// Run-boundary search used by the RLE encoder. Each function has a scalar version
+// and SSE2/AVX2/AVX-512BW versions; the widest one the CPU supports is picked the
+// first time it is called. All versions return identical results.
+class RunScan {
+public:
+    // Smallest i >= pos with data[i] == data[i+1] == data[i+2] == data[i+3], or n if
+    // there is no such run of four before the end of the buffer.
+    static size_t findRepeat(const unsigned char* data, size_t pos, size_t n);
+
+    // Index of the first byte at or after pos that differs from `value`, or n.
+    static size_t findRunEnd(const unsigned char* data, size_t pos, size_t n, unsigned char value);
+
+    // Name of the variant in use ("avx512bw", "avx2", "sse2" or "scalar").
+    static const char* activeVariant();
+};
@@ -0,0 +1,55 @@
+#include "SerializedOutput.h"
+#include <iostream>
+
+namespace {
+    // Output without a newline is still passed on once this much has built up, so long
+    // binary writes (read --offset to stdout) do not collect in memory.
+    const size_t MAX_PENDING = 64 * 1024;
+}
+
+void SerializedOutput::install() {
+    // Never destroyed: the streams are flushed at exit after every static object is gone.
+    std::cout.rdbuf(new SerializedOutput(std::cout.rdbuf()));
+    std::cerr.rdbuf(new SerializedOutput(std::cerr.rdbuf()));
+    // Lines are kept whole by the buffer now; flushing std::cerr after every insertion
+    // would cut them in pieces again.
+    std::cerr.unsetf(std::ios::unitbuf);
+}
+
+SerializedOutput::SerializedOutput(std::streambuf* target) : target(target) {}
+
+SerializedOutput::int_type SerializedOutput::overflow(int_type c) {
+    if (traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+    char ch = traits_type::to_char_type(c);
+    xsputn(&ch, 1);
+    return c;
+}
+
+std::streamsize SerializedOutput::xsputn(const char* s, std::streamsize n) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto mine = pending.emplace(std::this_thread::get_id(), std::string()).first;
+    std::string& text = mine->second;
+    text.append(s, (size_t)n);
+    if (text.size() >= MAX_PENDING) emit(text, true);
+    else if (n > 0 && std::char_traits<char>::find(s, (size_t)n, '\n') != nullptr) emit(text, false);
+    // Most lines end in '\n' rather than a flush, and pool threads come and go with each
+    // batch: an entry with nothing left is dropped so the map does not keep every thread.
+    if (text.empty()) pending.erase(mine);
+    return n;
+}
+
+int SerializedOutput::sync() {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto mine = pending.find(std::this_thread::get_id());
+    if (mine != pending.end()) {
+        emit(mine->second, true);
+        pending.erase(mine);
+    }
+    return target->pubsync();
+}
+
+void SerializedOutput::emit(std::string& text, bool everything) {
+    size_t end = everything ? text.size() : text.rfind('\n') + 1;
+    target->sputn(text.data(), (std::streamsize)end);
+    text.erase(0, end);
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <streambuf>
+#include <string>
+#include <mutex>
+#include <unordered_map>
+#include <thread>
+
+// Keeps lines written to std::cout and std::cerr from several threads (background
+// jobs, batch commands) whole: each thread's output is held until it ends a line, or
+// the stream is flushed, and then written to the console in one piece.
+class SerializedOutput : public std::streambuf {
+public:
+    // Puts std::cout and std::cerr behind a SerializedOutput each, for the rest of the
+    // program. Call once from main before any other thread starts.
+    static void install();
+
+    explicit SerializedOutput(std::streambuf* target);
+
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
+    int sync() override;
+
+private:
+    // Writes out the complete lines of `pending` (all of it with `everything`).
+    void emit(std::string& pending, bool everything);
+
+    std::streambuf* target;
+    std::mutex mutex;
+    std::unordered_map<std::thread::id, std::string> pending; // per thread: text not yet written
+};
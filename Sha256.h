@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+// SHA-256 (FIPS 180-4), and PBKDF2-HMAC-SHA256 (RFC 8018) on top of it for turning a
+// password into cipher keys.
+class Sha256 {
+public:
+    static constexpr size_t DIGEST_SIZE = 32;
+    static constexpr size_t BLOCK_SIZE = 64;
+
+    Sha256();
+    void update(const void* data, size_t n);
+    void finish(unsigned char digest[DIGEST_SIZE]);
+
+    // Fills out[0, outSize) with PBKDF2-HMAC-SHA256(password, salt, iterations).
+    static void pbkdf2(const std::string& password, const unsigned char* salt, size_t saltSize,
+                       uint32_t iterations, unsigned char* out, size_t outSize);
+
+    // PBKDF2 known-answer checks (RFC 7914). Run once; the result is cached.
+    static bool selfTest();
+
+private:
+    void compress(const unsigned char block[BLOCK_SIZE]);
+
+    uint32_t state[8];
+    unsigned char buffer[BLOCK_SIZE];
+    size_t buffered;
+    uint64_t length;
+};
@@ -0,0 +1,312 @@
+#include "StatCache.h"
+#include <filesystem>
+#include <chrono>
+#include <cstdio>
+#include <system_error>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+    // Past this many paths the cache starts over rather than growing without bound.
+    const size_t MAX_ENTRIES = 1 << 20;
+
+#if defined(__linux__)
+    // Everything that changes what a lookup returns: entries appearing, disappearing or
+    // being renamed, contents (size), attributes (mtime), and the directory itself going.
+    const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_ATTRIB |
+                                IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+    // Follows a symbolic link like stat() does, and tells through `link` whether `path`
+    // was one: only the link's own directory is watched, not its target's.
+    StatCache::Info statPath(const std::string& path, bool* link = nullptr) {
+        StatCache::Info info;
+        struct stat st;
+        if (::lstat(path.c_str(), &st) != 0) return info;
+        if (S_ISLNK(st.st_mode)) {
+            if (link) *link = true;
+            if (::stat(path.c_str(), &st) != 0) return info;
+        }
+        info.exists = true;
+        info.directory = S_ISDIR(st.st_mode);
+        info.regular = S_ISREG(st.st_mode);
+        info.size = info.regular ? (uint64_t)st.st_size : 0;
+        info.mtime = st.st_mtim.tv_sec;
+        return info;
+    }
+#else
+    StatCache::Info statPath(const std::string& path, bool* link = nullptr) {
+        (void)link;
+        StatCache::Info info;
+        std::error_code ec;
+        fs::file_status status = fs::status(path, ec);
+        if (ec || !fs::exists(status)) return info;
+        info.exists = true;
+        info.directory = fs::is_directory(status);
+        info.regular = fs::is_regular_file(status);
+        if (info.regular) {
+            uint64_t size = fs::file_size(path, ec);
+            info.size = ec ? 0 : size;
+        }
+        // file_time_type has no fixed epoch in C++17: go through the current time.
+        auto written = fs::last_write_time(path, ec);
+        if (!ec) {
+            auto age = fs::file_time_type::clock::now() - written;
+            info.mtime = std::chrono::duration_cast<std::chrono::seconds>(
+                             (std::chrono::system_clock::now() - age).time_since_epoch()).count();
+        }
+        return info;
+    }
+#endif
+
+    std::string parentOf(const std::string& path) {
+        size_t slash = path.find_last_of('/');
+        if (slash == std::string::npos) return path;
+        return slash == 0 ? "/" : path.substr(0, slash);
+    }
+}
+
+StatCache& StatCache::get() {
+    static StatCache cache;
+    return cache;
+}
+
+StatCache::StatCache() {
+#if defined(__linux__)
+    std::error_code ec;
+    workingDirectory = fs::current_path(ec).string();
+    notifyFd = ec ? -1 : inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    active = notifyFd >= 0;
+#endif
+}
+
+StatCache::~StatCache() {
+#if defined(__linux__)
+    if (notifyFd >= 0) ::close(notifyFd);
+#endif
+}
+
+void StatCache::disable() {
+    std::lock_guard<std::mutex> lock(mutex);
+    active = false;
+    userDisabled = true;
+    entries.clear();
+    watches.clear();
+    watched.clear();
+#if defined(__linux__)
+    if (notifyFd >= 0) ::close(notifyFd);
+    notifyFd = -1;
+#endif
+}
+
+// Absolute and lexically normal, without a trailing slash. The session never changes
+// its working directory, so the one read at startup stands for every relative path.
+std::string StatCache::normalize(const std::string& path) const {
+    // Most paths are plain relative names and only need the prefix.
+    bool plain = path[0] != '/' && path != "." && path.compare(0, 2, "./") != 0 &&
+                 path.find("/./") == std::string::npos && path.find("//") == std::string::npos &&
+                 (path.size() < 2 || path.compare(path.size() - 2, 2, "/.") != 0);
+    if (plain) {
+        std::string key;
+        key.reserve(workingDirectory.size() + 1 + path.size());
+        key += workingDirectory;
+        if (key.back() != '/') key += '/';
+        key += path;
+        while (key.size() > 1 && key.back() == '/') key.pop_back();
+        return key;
+    }
+    fs::path full(path);
+    if (full.is_relative()) full = fs::path(workingDirectory) / full;
+    std::string key = full.lexically_normal().string();
+    while (key.size() > 1 && key.back() == '/') key.pop_back();
+    return key;
+}
+
+StatCache::Info StatCache::lookup(const std::string& path) {
+    // ".." after a symbolic link leads somewhere else than the lexical form says, so
+    // such paths are not cached.
+    if (path.empty() || !enabled() || path.find("..") != std::string::npos) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return path.empty() ? Info() : statPath(path);
+    }
+    std::string key = normalize(path);
+
+    // The slot is claimed (and the directory watched) before the stat, so an event that
+    // lands while it runs removes the claim and the possibly stale result is not kept.
+    uint64_t ticket = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        drainEvents();
+        auto it = entries.find(key);
+        if (it != entries.end() && it->second.ticket == 0) {
+            hits.fetch_add(1, std::memory_order_relaxed);
+            return it->second.info;
+        }
+        if (active && watch(parentOf(key))) {
+            if (entries.size() >= MAX_ENTRIES) {
+                invalidations.fetch_add(entries.size(), std::memory_order_relaxed);
+                entries.clear();
+            }
+            ticket = ++nextTicket;
+            entries[key].ticket = ticket;
+        }
+    }
+    misses.fetch_add(1, std::memory_order_relaxed);
+    bool link = false;
+    Info info = statPath(key, &link);
+    if (ticket != 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        drainEvents();
+        auto it = entries.find(key);
+        if (it != entries.end() && it->second.ticket == ticket) {
+            // A symbolic link's target may change in a directory nobody watches: the
+            // claim is given up and the next lookup asks the file system again.
+            if (link) {
+                entries.erase(it);
+            }
+            else {
+                it->second.info = info;
+                it->second.ticket = 0;
+            }
+        }
+    }
+    return info;
+}
+
+// Watches `directory` and, first, every directory above it: renaming or removing any of
+// them changes what the paths below refer to. Returns false if one cannot be watched.
+bool StatCache::watch(const std::string& directory) {
+#if defined(__linux__)
+    if (watches.count(directory) != 0) return true;
+    std::string parent = parentOf(directory);
+    if (parent != directory && !watch(parent)) return false;
+    int wd = inotify_add_watch(notifyFd, directory.c_str(), WATCH_MASK);
+    if (wd < 0) return false;
+    watches.emplace(directory, wd);
+    watched[wd].push_back(directory);
+    return true;
+#else
+    (void)directory;
+    return false;
+#endif
+}
+
+void StatCache::erase(const std::string& path) {
+    auto it = entries.find(path);
+    if (it == entries.end()) return;
+    if (it->second.ticket == 0) invalidations.fetch_add(1, std::memory_order_relaxed);
+    entries.erase(it);
+}
+
+// Forgets `path` and everything below it, including the watches on directories there
+// (the inodes they follow may now sit under another name).
+void StatCache::dropTree(const std::string& path) {
+    std::string prefix = path == "/" ? path : path + "/";
+    auto below = [&](const std::string& key) {
+        return key == path || key.compare(0, prefix.size(), prefix) == 0;
+    };
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (!below(it->first)) {
+            ++it;
+            continue;
+        }
+        if (it->second.ticket == 0) invalidations.fetch_add(1, std::memory_order_relaxed);
+        it = entries.erase(it);
+    }
+    for (auto it = watches.begin(); it != watches.end();) {
+        if (!below(it->first)) {
+            ++it;
+            continue;
+        }
+        auto found = watched.find(it->second);
+        if (found != watched.end()) {
+            auto& directories = found->second;
+            for (size_t i = 0; i < directories.size(); ++i) {
+                if (directories[i] == it->first) {
+                    directories.erase(directories.begin() + i);
+                    break;
+                }
+            }
+            if (directories.empty()) {
+#if defined(__linux__)
+                inotify_rm_watch(notifyFd, found->first);
+#endif
+                watched.erase(found);
+            }
+        }
+        it = watches.erase(it);
+    }
+}
+
+void StatCache::drainEvents() {
+#if defined(__linux__)
+    if (notifyFd < 0) return;
+    alignas(inotify_event) char buffer[64 * 1024];
+    for (;;) {
+        ssize_t n = ::read(notifyFd, buffer, sizeof buffer);
+        if (n <= 0) return;
+        for (char* p = buffer; p < buffer + n;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                // Events were lost: nothing cached can be trusted.
+                invalidations.fetch_add(entries.size(), std::memory_order_relaxed);
+                entries.clear();
+                continue;
+            }
+            auto found = watched.find(event->wd);
+            if (found == watched.end()) continue;
+            if (event->mask & IN_IGNORED) {
+                // The watch is gone (its directory was deleted or its file system unmounted).
+                std::vector<std::string> directories = found->second;
+                for (const std::string& directory : directories) dropTree(directory);
+                watched.erase(event->wd);
+                continue;
+            }
+            std::vector<std::string> directories = found->second;
+            for (const std::string& directory : directories) {
+                if (event->len == 0) {
+                    if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) dropTree(directory);
+                    else erase(directory);
+                    continue;
+                }
+                std::string path = directory == "/" ? "/" : directory + "/";
+                path += event->name;
+                // An entry coming or going also changes the directory's own mtime.
+                erase(directory);
+                erase(path);
+                bool replaced = (event->mask & (IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)) != 0;
+                if ((replaced && (event->mask & IN_ISDIR)) || watches.count(path) != 0) dropTree(path);
+            }
+        }
+    }
+#endif
+}
+
+void StatCache::report(std::ostream& out) {
+    size_t paths, directories;
+    bool turnedOff;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        drainEvents();
+        paths = entries.size();
+        directories = watches.size();
+        turnedOff = userDisabled;
+    }
+    uint64_t hit = hits.load(), miss = misses.load();
+    char rate[32];
+    std::snprintf(rate, sizeof rate, "%.1f%%", hit + miss == 0 ? 0.0 : 100.0 * (double)hit / (double)(hit + miss));
+
+    out << "\nStat Cache  : ";
+    if (enabled()) out << "on, " << paths << " paths, " << directories << " directories watched\n";
+    else if (turnedOff) out << "off (--no-stat-cache)\n";
+    else out << "off (no inotify on this system)\n";
+    out << "Hits/Misses : " << hit << " / " << miss << " (" << rate << " hits)\n";
+    out << "Invalidated : " << invalidations.load() << " paths changed on disk\n";
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <ostream>
+#include <cstdint>
+
+// What the commands ask the file system before they act (does it exist, is it a
+// directory, how big, how old), remembered per path so that checking the same file
+// in the handler, again in the helper it calls and again in MemoryManager costs one
+// stat instead of three - which matters on NFS and FUSE mounts, where each is a round
+// trip. Paths are keyed by their absolute, lexically normal form.
+//
+// On Linux the cache stays coherent through inotify: the directory holding a cached
+// path, and every directory above it, is watched, and each lookup first reads the
+// pending events and drops whatever they touch - changes made by this process, by
+// other programs, renamed or removed parent directories alike. Where a directory
+// cannot be watched its entries are not cached, and neither are symbolic links, whose
+// targets may change in directories that are not watched. Other systems have no such watch
+// here, so the cache stays off there and every lookup goes to the file system, as
+// it does everywhere after disable() (fms --no-stat-cache).
+class StatCache {
+public:
+    struct Info {
+        bool exists = false;
+        bool directory = false;
+        bool regular = false;
+        uint64_t size = 0;   // bytes, for regular files
+        int64_t mtime = 0;   // seconds since 1970
+    };
+
+    static StatCache& get();
+
+    Info lookup(const std::string& path);
+    bool exists(const std::string& path) { return lookup(path).exists; }
+    bool isDirectory(const std::string& path) { return lookup(path).directory; }
+
+    // Turns the cache off for the rest of the run and forgets what it held.
+    void disable();
+    bool enabled() const { return active.load(std::memory_order_relaxed); }
+
+    // Writes the entry, watch and hit/miss counts (for meminfo).
+    void report(std::ostream& out);
+
+    StatCache(const StatCache&) = delete;
+    StatCache& operator=(const StatCache&) = delete;
+
+private:
+    StatCache();
+    ~StatCache();
+
+    // A cached path; while `ticket` is non-zero its stat is still running and `info`
+    // is not filled in yet.
+    struct Entry {
+        Info info;
+        uint64_t ticket = 0;
+    };
+
+    std::string normalize(const std::string& path) const;
+    bool watch(const std::string& directory);
+    void drainEvents();
+    void erase(const std::string& path);
+    void dropTree(const std::string& path);
+
+    std::atomic<bool> active{ false };
+    bool userDisabled = false;
+    std::string workingDirectory;
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<std::string, int> watches;                 // directory -> watch descriptor
+    std::unordered_map<int, std::vector<std::string>> watched;    // watch descriptor -> directories
+    uint64_t nextTicket = 0;
+
+    std::atomic<uint64_t> hits{ 0 }, misses{ 0 }, invalidations{ 0 };
+#if defined(__linux__)
+    int notifyFd = -1;
+#endif
+};
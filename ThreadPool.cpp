@@ -0,0 +1,84 @@
+#include "ThreadPool.h"
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threads) : stopping(false) {
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.emplace_back([this] { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    available.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push(std::move(task));
+    }
+    available.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body) {
+    if (count == 0) return;
+
+    // Every participant pulls the next index from a shared counter, so a slow index
+    // never holds up the others.
+    struct Shared {
+        std::atomic<size_t> next{ 0 };
+        size_t finishedHelpers = 0;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto shared = std::make_shared<Shared>();
+    auto drain = [shared, count, &body] {
+        size_t index;
+        while ((index = shared->next.fetch_add(1)) < count) {
+            body(index);
+        }
+    };
+
+    size_t helpers = std::min<size_t>(workers.size(), count - 1);
+    for (size_t i = 0; i < helpers; ++i) {
+        submit([shared, drain] {
+            drain();
+            std::lock_guard<std::mutex> lock(shared->mutex);
+            shared->finishedHelpers++;
+            shared->done.notify_one();
+        });
+    }
+
+    drain();
+
+    // `body` lives on this stack frame, so wait until no helper can still touch it.
+    std::unique_lock<std::mutex> lock(shared->mutex);
+    shared->done.wait(lock, [&] { return shared->finishedHelpers == helpers; });
+}
+
+unsigned ThreadPool::hardwareThreads() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+void ThreadPool::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (stopping && tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstddef>
+
+// Fixed set of worker threads fed from one task queue.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> task);
+
+    // Runs body(0) .. body(count - 1) across the workers and the calling thread, and
+    // returns once every index has finished.
+    void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    unsigned size() const { return (unsigned)workers.size(); }
+
+    // Number of hardware threads, never less than 1.
+    static unsigned hardwareThreads();
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping;
+};
@@ -0,0 +1,26 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+
+// LEB128 varints: 7 bits per byte, low bits first, high bit set on every byte but the
+// last. Used by the compressed container and the codecs' token streams.
+
+inline void appendVarint(std::vector<char>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back((char)((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back((char)value);
+}
+
+// Reads one varint from [p, end) and advances p past it. Fails on truncated input or
+// on more than ten bytes (not a valid 64-bit value).
+inline bool parseVarint(const char*& p, const char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        unsigned char byte = (unsigned char)*p++;
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
@@ -0,0 +1,108 @@
+#include "WorkStealingPool.h"
+
+namespace {
+    // The pool and queue of the task running on this thread, if any.
+    thread_local const WorkStealingPool* currentPool = nullptr;
+    thread_local size_t currentQueue = 0;
+}
+
+WorkStealingPool::WorkStealingPool(unsigned threads) {
+    if (threads == 0) threads = 1;
+    for (unsigned i = 0; i < threads; ++i) queues.emplace_back(new Queue);
+    for (unsigned i = 1; i < threads; ++i) {
+        workers.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void WorkStealingPool::submit(std::function<void()> task) {
+    size_t target = currentPool == this ? currentQueue : nextQueue.fetch_add(1) % queues.size();
+    unfinished.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queues[target]->mutex);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+    {
+        // Counted under sleepMutex so a thread about to sleep cannot miss it.
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queued.fetch_add(1);
+    }
+    wake.notify_one();
+}
+
+bool WorkStealingPool::take(size_t self, std::function<void()>& task) {
+    {
+        Queue& own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    for (size_t i = 1; i < queues.size(); ++i) {
+        Queue& victim = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run(std::function<void()>& task) {
+    task();
+    task = nullptr;
+    if (unfinished.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wake.notify_all(); // the thread in wait() may be asleep
+    }
+}
+
+void WorkStealingPool::workerLoop(size_t self) {
+    currentPool = this;
+    currentQueue = self;
+    std::function<void()> task;
+    while (true) {
+        if (take(self, task)) {
+            run(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+        if (stopping && queued.load() <= 0) return;
+    }
+}
+
+void WorkStealingPool::wait() {
+    const WorkStealingPool* savedPool = currentPool;
+    size_t savedQueue = currentQueue;
+    currentPool = this;
+    currentQueue = 0;
+    std::function<void()> task;
+    while (true) {
+        if (take(0, task)) {
+            run(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        if (unfinished.load() == 0) break;
+        wake.wait(lock, [this] { return unfinished.load() == 0 || queued.load() > 0; });
+    }
+    currentPool = savedPool;
+    currentQueue = savedQueue;
+}
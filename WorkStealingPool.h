@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+
+// Thread pool with one task queue per thread, for work made of many tasks of very
+// different cost (a batch of files, a directory tree). A thread runs its own queue in
+// order; one that runs dry steals from the back of another's, so a few long tasks do
+// not leave the other threads idle behind them. Tasks may submit more tasks.
+//
+// ThreadPool stays the choice for the block loops of one file, where every task costs
+// about the same.
+class WorkStealingPool {
+public:
+    // `threads` counts the thread that calls wait(), so threads - 1 workers start.
+    explicit WorkStealingPool(unsigned threads);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // Queues a task. From inside one of this pool's tasks it goes on that thread's own
+    // queue; from outside, the queues are filled in turn.
+    void submit(std::function<void()> task);
+
+    // Runs tasks on the calling thread as well, and returns once every task submitted
+    // so far - and every task those submitted - has finished.
+    void wait();
+
+    unsigned size() const { return (unsigned)queues.size(); }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    bool take(size_t self, std::function<void()>& task);
+    void run(std::function<void()>& task);
+    void workerLoop(size_t self);
+
+    std::vector<std::unique_ptr<Queue>> queues; // queues[0] belongs to the thread in wait()
+    std::vector<std::thread> workers;
+    std::atomic<long> queued{ 0 };      // tasks sitting in the queues
+    std::atomic<size_t> unfinished{ 0 }; // submitted and not yet finished
+    std::atomic<size_t> nextQueue{ 0 };  // round robin for submissions from outside
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
@@ -1,17 +1,91 @@
 #include "FileManager.h"
+#include "BatchRunner.h"
+#include "SerializedOutput.h"
+#include "StatCache.h"
 #include <iostream>
 #include <string>
+#include <cstring>
 
-int main() {
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    bool stdinIsTerminal() {
+#if defined(_WIN32)
+        return _isatty(_fileno(stdin)) != 0;
+#else
+        return isatty(STDIN_FILENO) != 0;
+#endif
+    }
+
+    // Reads the batch options: --script <file> (or --script=<file>), --stop-on-error and
+    // --continue-on-error. Returns false if argv holds anything else.
+    bool parseBatchOptions(int argc, char* argv[], std::string& script, BatchRunner::ErrorPolicy& policy) {
+        for (int i = 1; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--stop-on-error") == 0) policy = BatchRunner::ErrorPolicy::Stop;
+            else if (std::strcmp(argv[i], "--continue-on-error") == 0) policy = BatchRunner::ErrorPolicy::Continue;
+            else if (std::strcmp(argv[i], "--script") == 0 && i + 1 < argc) script = argv[++i];
+            else if (std::strncmp(argv[i], "--script=", 9) == 0 && argv[i][9] != '\0') script = argv[i] + 9;
+            else return false;
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // Background jobs and batches print from several threads at once.
+    SerializedOutput::install();
     FileManager manager;
     std::string input;
 
+    // "fms --no-stat-cache ..." sends every existence and size check to the file system,
+    // for file systems whose changes inotify does not see (most network ones, when the
+    // change comes from another machine).
+    if (argc > 1 && std::strcmp(argv[1], "--no-stat-cache") == 0) {
+        StatCache::get().disable();
+        argv[1] = argv[0];
+        --argc;
+        ++argv;
+    }
+
+    // "fms --script <file>" runs a file of commands, one per line ("-" is stdin), and
+    // so does piping commands into "fms" with no arguments. A summary of the failed
+    // commands goes to stderr at the end; the exit status is 1 if any failed.
+    std::string script = stdinIsTerminal() ? "" : "-";
+    BatchRunner::ErrorPolicy policy = BatchRunner::ErrorPolicy::Continue;
+    bool batch = argc > 1 && std::strncmp(argv[1], "--", 2) == 0 && std::strcmp(argv[1], "--help") != 0;
+    if (batch && !parseBatchOptions(argc, argv, script, policy)) {
+        std::cerr << "Usage: fms [--no-stat-cache] [--script <file|->] [--stop-on-error | --continue-on-error]\n"
+                  << "       fms [--no-stat-cache] <command> [args...]\n";
+        return 2;
+    }
+    if (batch || (argc == 1 && !script.empty())) {
+        if (script.empty()) {
+            std::cerr << "Error: No script to run; name one with --script or pipe commands in.\n";
+            return 2;
+        }
+        return BatchRunner(manager, policy).runScript(script);
+    }
+
+    // "fms <command> [args...]" runs that one command and exits, so the tool can sit in
+    // scripts and shell pipelines; the exit status is 1 if the command failed.
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) {
+            if (i > 1) input += ' ';
+            input += argv[i];
+        }
+        return manager.handleCommand(input) ? 0 : 1;
+    }
+
     std::cout << "Simple File Manager CLI\n";
     std::cout << "Type 'help' to see available commands. Type 'exit' to quit.\n\n";
 
-    while (true) {
+    while (!manager.exitRequested()) {
         std::cout << "> ";
-        std::getline(std::cin, input);
+        if (!std::getline(std::cin, input)) break;
         if (!input.empty()) {
             manager.handleCommand(input);
         }
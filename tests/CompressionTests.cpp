@@ -0,0 +1,74 @@
+// Damaged compressed files must be reported, never crash the session or allocate what
+// their headers claim. Built apart from the project (see README.md).
+#include "Compression.h"
+#include "Varint.h"
+#include <cstdio>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+    int failures = 0;
+
+    void check(bool ok, const char* what) {
+        std::printf("%s  %s\n", ok ? "ok    " : "FAILED", what);
+        if (!ok) failures++;
+    }
+
+    // A framed file (see Compression.cpp) with one block whose header and table say
+    // what the test wants, whatever the payload really holds.
+    std::vector<char> framedFile(unsigned char codec, uint64_t blockSize, uint64_t rawSize, const std::vector<char>& payload) {
+        std::vector<char> file = { (char)0x89, 'F', 'M', 'Z', 2, (char)codec };
+        appendVarint(file, blockSize);
+        uint64_t tableOffset = file.size() + payload.size();
+        file.insert(file.end(), payload.begin(), payload.end());
+        appendVarint(file, 1);
+        appendVarint(file, rawSize);
+        appendVarint(file, payload.size());
+        for (int i = 0; i < 8; ++i) file.push_back((char)(tableOffset >> (8 * i)));
+        file.insert(file.end(), { 'F', 'M', 'Z', 'T' });
+        return file;
+    }
+
+    // One RLE run token: `length` copies of `byte`.
+    std::vector<char> rleRun(uint64_t length, char byte) {
+        std::vector<char> payload;
+        appendVarint(payload, (length << 1) | 1);
+        payload.push_back(byte);
+        return payload;
+    }
+
+    bool rejected(const std::vector<char>& file, const std::string& path) {
+        uint64_t size = 0;
+        if (Compression::decompressedSize(file.data(), file.size(), size) != EngineStatus::Corrupted) return false;
+
+        std::ofstream(path, std::ios::binary).write(file.data(), (std::streamsize)file.size());
+        std::ostringstream range;
+        bool read = Compression::readRange(path, 0, 2, range);
+        fs::remove(path);
+        return !read && range.str().empty();
+    }
+}
+
+int main() {
+    const uint64_t huge = (uint64_t)1 << 45;
+    std::string path = (fs::temp_directory_path() / "fms_test_compressed.bin").string();
+
+    check(rejected(framedFile(1, huge, huge, rleRun(huge, 'a')), path), "block size over the cap is corrupt");
+    check(rejected(framedFile(2, 1 << 20, 1 << 20, std::vector<char>(100, 0)), path),
+          "raw size beyond what the codec can decode from the payload is corrupt");
+    check(rejected(framedFile(1, 0, 0, {}), path), "block size of zero is corrupt");
+
+    std::vector<char> good = framedFile(1, 1 << 20, 1000, rleRun(1000, 'z'));
+    std::ofstream(path, std::ios::binary).write(good.data(), (std::streamsize)good.size());
+    std::ostringstream range;
+    check(Compression::readRange(path, 998, 10, range) && range.str() == "zz", "a sound file still reads");
+    fs::remove(path);
+
+    return failures == 0 ? 0 : 1;
+}